@@ -0,0 +1,278 @@
+#pragma once
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "network.hpp"
+#include "layers/convolutional_layer.hpp"
+#include "layers/fully_connected_layer.hpp"
+#include "layers/softmax_layer.hpp"
+#include "layers/batch_norm_layer.hpp"
+#include "utils/batch_norm_folding.hpp"
+#include "utils/thread_pool.hpp"
+#include "models/model_io.hpp"
+
+/**
+ * EnsembleNetwork: несколько сетей одной топологии (например, модели фолдов) как одна модель.
+ * Веса членов складываются так, что каждый слой выполняется одним ядром на весь ансамбль:
+ * - пока вход общий (до первого слоя с параметрами), слои без параметров считаются один раз,
+ *   а первая свёртка/FC получает ядра/столбцы всех членов подряд (одна свёртка N*out каналов,
+ *   один FC in -> N*out);
+ * - дальше каналы и столбцы членов идут блоками подряд: свёртка становится групповой
+ *   (groups умножается на N), FC - блочным (один parallel_for по строкам и членам),
+ *   слои без параметров (пулинг, активации, Flatten) работают по всем блокам сразу.
+ * Вход - как у членов: батч [B x 28*28] (свёртки с set_image_size) или один образец; на батче
+ * весь ансамбль - один проход сложенных ядер вместо N проходов отдельных сетей.
+ * Логиты членов усредняются, последний Softmax применяется к среднему.
+ * BatchNorm предварительно вливается (fold_batch_norm); невлитый BN и прочие слои
+ * с параметрами не поддерживаются.
+ */
+template<typename T>
+class EnsembleNetwork {
+private:
+    enum class StageKind { Layer, GroupedFC, Tile };
+
+    struct Stage {
+        StageKind kind;
+        std::unique_ptr<Layer<T>> layer;
+        // GroupedFC: веса членов друг под другом [N*in x out], смещения [N x out]
+        Matrix<T> weights;
+        Matrix<T> biases;
+        size_t in=0;
+        size_t out=0;
+    };
+
+    size_t members_;
+    std::vector<Stage> stages_;
+    std::unique_ptr<Layer<T>> softmax_;
+
+    static void check_same(bool same,size_t i,const std::string& what){
+        if(!same) throw std::runtime_error("EnsembleNetwork: слой "+std::to_string(i)+" - разные "+what);
+    }
+
+    void add_stage(StageKind kind,std::unique_ptr<Layer<T>> layer){
+        Stage s;
+        s.kind=kind;
+        s.layer=std::move(layer);
+        if(s.layer) s.layer->set_training(false);
+        stages_.push_back(std::move(s));
+    }
+
+    void stack_conv(std::vector<std::unique_ptr<Network<T>>>& nets,size_t i,bool shared){
+        size_t n=nets.size();
+        auto& first=dynamic_cast<ConvolutionalLayer<T>&>(nets[0]->layer(i));
+        std::vector<ConvolutionalLayer<T>*> convs;
+        for(auto &net: nets){
+            auto* conv=dynamic_cast<ConvolutionalLayer<T>*>(&net->layer(i));
+            check_same(conv&&conv->in_channels()==first.in_channels()&&conv->out_channels()==first.out_channels()&&
+                       conv->kernel_size()==first.kernel_size()&&conv->stride()==first.stride()&&
+                       conv->padding()==first.padding()&&conv->groups()==first.groups()&&
+                       conv->image_height()==first.image_height()&&conv->image_width()==first.image_width(),i,"свёртки");
+            convs.push_back(conv);
+        }
+        int in=first.in_channels(),out=first.out_channels(),groups=first.groups();
+        // Общий вход и groups==1: все выходные каналы читают одни и те же входные.
+        // Общий вход при groups>1 размножается, чтобы группы членов не смешались
+        if(shared&&groups>1) add_stage(StageKind::Tile,nullptr);
+        bool tiled=!shared||groups>1;
+        std::unique_ptr<ConvolutionalLayer<T>> stacked(new ConvolutionalLayer<T>(
+            tiled?in*(int)n:in,out*(int)n,first.kernel_size(),first.stride(),first.padding(),tiled?groups*(int)n:1));
+        stacked->set_image_size(first.image_height(),first.image_width());
+        // Ядро (out_c, in_c) лежит в out_c*group_in+in_c: ядра членов подряд - это ядра сложенной свёртки
+        std::vector<ParameterView<T>> views=stacked->parameters();
+        size_t per_member=convs[0]->kernels().size();
+        for(size_t m=0;m<n;++m){
+            for(size_t k=0;k<per_member;++k){
+                const Matrix<T>& src=convs[m]->kernels()[k];
+                std::copy(src.data(),src.data()+src.size(),views[m*per_member+k].data);
+            }
+            std::copy(convs[m]->biases().begin(),convs[m]->biases().end(),views.back().data+m*out);
+        }
+        add_stage(StageKind::Layer,std::move(stacked));
+    }
+
+    void stack_fc(std::vector<std::unique_ptr<Network<T>>>& nets,size_t i,bool shared){
+        size_t n=nets.size();
+        auto& first=dynamic_cast<FullyConnectedLayer<T>&>(nets[0]->layer(i));
+        size_t in=first.input_size(),out=first.output_size();
+        std::vector<FullyConnectedLayer<T>*> fcs;
+        for(auto &net: nets){
+            auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net->layer(i));
+            check_same(fc&&fc->input_size()==in&&fc->output_size()==out,i,"размеры FC");
+            fcs.push_back(fc);
+        }
+        if(shared){
+            // Общий вход: один FC in -> N*out, столбцы члена m - [m*out, (m+1)*out)
+            Matrix<T> w(in,n*out,0),b(1,n*out,0);
+            for(size_t m=0;m<n;++m){
+                for(size_t k=0;k<in;++k){
+                    const T* src=fcs[m]->weights().data()+k*out;
+                    std::copy(src,src+out,w.data()+k*n*out+m*out);
+                }
+                std::copy(fcs[m]->biases().data(),fcs[m]->biases().data()+out,b.data()+m*out);
+            }
+            std::unique_ptr<FullyConnectedLayer<T>> stacked(new FullyConnectedLayer<T>((int)in,(int)(n*out)));
+            stacked->set_parameters(w,b);
+            add_stage(StageKind::Layer,std::move(stacked));
+            return;
+        }
+        Stage s;
+        s.kind=StageKind::GroupedFC;
+        s.in=in;
+        s.out=out;
+        s.weights=Matrix<T>(n*in,out,0);
+        s.biases=Matrix<T>(n,out,0);
+        for(size_t m=0;m<n;++m){
+            std::copy(fcs[m]->weights().data(),fcs[m]->weights().data()+in*out,s.weights.data()+m*in*out);
+            std::copy(fcs[m]->biases().data(),fcs[m]->biases().data()+out,s.biases.data()+m*out);
+        }
+        stages_.push_back(std::move(s));
+    }
+
+    // Блочный FC: y[:, m*out..] = x[:, m*in..]*W_m + b_m для всех членов одним parallel_for
+    Matrix<T> grouped_fc(const Stage& s,const Matrix<T>& x) const {
+        size_t n=members_;
+        size_t in=s.in,out=s.out;
+        if(x.cols()!=n*in) throw std::runtime_error("EnsembleNetwork: FC - неверное число столбцов входа");
+        size_t rows=x.rows();
+        Matrix<T> y(rows,n*out,0);
+        const T* weights=s.weights.data();
+        const T* biases=s.biases.data();
+        parallel_for(0,rows*n,ThreadPool::grain_size(in*out),[&](size_t lo,size_t hi){
+            for(size_t t=lo;t<hi;++t){
+                size_t i=t/n,m=t%n;
+                T* dst=y.data()+(i*n+m)*out;
+                const T* src=x.data()+(i*n+m)*in;
+                std::copy(biases+m*out,biases+(m+1)*out,dst);
+                // Строка выхода копится axpy по непрерывным строкам W_m, как в FullyConnectedLayer
+                const T* w=weights+m*in*out;
+                for(size_t k=0;k<in;++k){
+                    T xk=src[k];
+                    const T* wk=w+k*out;
+                    for(size_t j=0;j<out;++j) dst[j]+=xk*wk[j];
+                }
+            }
+        });
+        return y;
+    }
+
+public:
+    // Сети переходят во владение ансамбля; после сборки их веса живут в сложенных слоях
+    explicit EnsembleNetwork(std::vector<std::unique_ptr<Network<T>>> nets) : members_(nets.size()) {
+        if(nets.empty()) throw std::runtime_error("EnsembleNetwork: пустой ансамбль");
+        for(auto &net: nets){
+            fold_batch_norm(*net);
+            if(net->size()!=nets[0]->size()) throw std::runtime_error("EnsembleNetwork: у сетей разное число слоёв");
+        }
+        size_t count=nets[0]->size();
+        bool shared=true;
+        bool stacked_any=false;
+        // Слои без параметров забираются у первой сети после обхода, чтобы не сдвигать индексы
+        std::vector<std::pair<size_t,size_t>> borrowed; // (стадия, слой)
+        size_t softmax_index=count;
+        for(size_t i=0;i<count;++i){
+            std::string name=nets[0]->layer(i).name();
+            for(auto &net: nets) check_same(net->layer(i).name()==name,i,"типы слоёв ("+name+")");
+
+            if(dynamic_cast<SoftmaxLayer<T>*>(&nets[0]->layer(i))){
+                if(i+1!=count) throw std::runtime_error("EnsembleNetwork: Softmax поддерживается только последним слоем");
+                softmax_index=i;
+            } else if(dynamic_cast<ConvolutionalLayer<T>*>(&nets[0]->layer(i))){
+                stack_conv(nets,i,shared);
+                shared=false;
+                stacked_any=true;
+            } else if(dynamic_cast<FullyConnectedLayer<T>*>(&nets[0]->layer(i))){
+                stack_fc(nets,i,shared);
+                shared=false;
+                stacked_any=true;
+            } else if(!nets[0]->layer(i).has_parameters()){
+                // Пулинг, активации, Flatten: поканально/поэлементно, блоки членов не смешиваются
+                borrowed.push_back({stages_.size(),i});
+                add_stage(StageKind::Layer,nullptr);
+            } else {
+                throw std::runtime_error("EnsembleNetwork: слой "+name+" с параметрами не поддерживается");
+            }
+        }
+        if(!stacked_any) throw std::runtime_error("EnsembleNetwork: в сетях нет слоёв с параметрами");
+        if(softmax_index<count){
+            softmax_=nets[0]->remove_layer(softmax_index);
+            softmax_->set_training(false);
+        }
+        for(size_t k=borrowed.size();k-->0;){
+            stages_[borrowed[k].first].layer=nets[0]->remove_layer(borrowed[k].second);
+            stages_[borrowed[k].first].layer->set_training(false);
+        }
+    }
+
+    // Ансамбль из сохранённых моделей (save_model) одной архитектуры; вход - батч [B x 28*28] (MnistInput::Batch)
+    static std::unique_ptr<EnsembleNetwork<T>> load(const std::vector<std::string>& paths,std::string* arch=nullptr,
+                                                    size_t* num_classes=nullptr){
+        std::vector<std::unique_ptr<Network<T>>> nets;
+        std::string first_arch;
+        size_t first_classes=0;
+        for(auto &path: paths){
+            std::string a;
+            size_t c=0;
+            nets.push_back(load_model<T>(path,&a,&c,MnistInput::Batch));
+            if(nets.size()==1){
+                first_arch=a;
+                first_classes=c;
+            } else if(a!=first_arch||c!=first_classes){
+                throw std::runtime_error("EnsembleNetwork: "+path+" - другая архитектура ("+a+")");
+            }
+        }
+        if(arch) *arch=first_arch;
+        if(num_classes) *num_classes=first_classes;
+        return std::unique_ptr<EnsembleNetwork<T>>(new EnsembleNetwork<T>(std::move(nets)));
+    }
+
+    size_t members() const { return members_; }
+
+    std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input){
+        std::vector<Matrix<T>> x=input;
+        for(auto &s: stages_){
+            if(s.kind==StageKind::Tile){
+                std::vector<Matrix<T>> tiled;
+                tiled.reserve(x.size()*members_);
+                for(size_t m=0;m<members_;++m) tiled.insert(tiled.end(),x.begin(),x.end());
+                x=std::move(tiled);
+            } else if(s.kind==StageKind::GroupedFC){
+                if(x.size()!=1) throw std::runtime_error("EnsembleNetwork: FC ожидает один канал");
+                x={grouped_fc(s,x[0])};
+            } else {
+                x=s.layer->forward(x);
+            }
+        }
+
+        // Среднее логитов: блоки каналов или, при одном канале, блоки столбцов
+        Matrix<T> mean;
+        T scale=(T)1/(T)members_;
+        if(x.size()==1){
+            const Matrix<T>& logits=x[0];
+            if(logits.cols()%members_!=0) throw std::runtime_error("EnsembleNetwork: выход не делится на членов");
+            size_t width=logits.cols()/members_;
+            mean=Matrix<T>(logits.rows(),width,0);
+            for(size_t i=0;i<logits.rows();++i){
+                T* dst=mean.data()+i*width;
+                const T* row=logits.data()+i*logits.cols();
+                for(size_t m=0;m<members_;++m){
+                    for(size_t j=0;j<width;++j) dst[j]+=row[m*width+j];
+                }
+                for(size_t j=0;j<width;++j) dst[j]*=scale;
+            }
+        } else {
+            if(x.size()%members_!=0) throw std::runtime_error("EnsembleNetwork: выход не делится на членов");
+            size_t channels=x.size()/members_;
+            std::vector<Matrix<T>> means;
+            for(size_t c=0;c<channels;++c){
+                Matrix<T> sum=x[c];
+                for(size_t m=1;m<members_;++m) sum+=x[m*channels+c];
+                sum*=scale;
+                means.push_back(std::move(sum));
+            }
+            return softmax_?softmax_->forward(means):means;
+        }
+        if(softmax_) return softmax_->forward({mean});
+        return {mean};
+    }
+};
@@ -0,0 +1,374 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "layers/layer.hpp"
+#include "utils/thread_pool.hpp"
+
+// Ось склейки в Concat: списки каналов подряд или столбцы (признаки) каждого канала
+enum class ConcatAxis {
+    Channels,
+    Features
+};
+
+/**
+ * GraphNetwork: сеть-граф (DAG) из слоёв и узлов слияния Add/Concat.
+ * Узлы называются по именам, вход графа - узел "input", выход - set_output (по умолчанию
+ * последний добавленный узел). Узлы раскладываются по уровням (уровень = 1 + максимум
+ * уровней входов); узлы одного уровня независимы и в forward и backward выполняются
+ * параллельно через ThreadPool. Градиенты узла от нескольких потребителей суммируются.
+ *
+ * Сам граф - Layer<T>: его можно обучать напрямую или вставить в Network как один слой
+ * (residual-блок, ветвление), слои внутри используются без изменений.
+ */
+template<typename T>
+class GraphNetwork : public Layer<T> {
+private:
+    enum class NodeKind { Input, Layer, Add, Concat };
+
+    struct Node {
+        std::string name;
+        NodeKind kind;
+        std::unique_ptr<Layer<T>> layer;
+        ConcatAxis axis=ConcatAxis::Channels;
+        std::vector<size_t> inputs;
+        size_t consumers=0;
+        // Для Concat: сколько каналов / столбцов дал каждый вход в последнем forward
+        std::vector<size_t> split;
+    };
+
+    std::vector<Node> nodes_;
+    std::map<std::string,size_t> index_;
+    size_t output_=0;
+    bool output_set_=false;
+
+    std::vector<std::vector<size_t>> levels_;
+    bool compiled_=false;
+
+    // Выходы узлов в forward и градиенты по ним в backward
+    std::vector<std::vector<Matrix<T>>> outputs_;
+    std::vector<std::vector<Matrix<T>>> grads_;
+
+    size_t add_node(const std::string& name,NodeKind kind,const std::vector<std::string>& inputs){
+        if(index_.count(name)) throw std::runtime_error("GraphNetwork: узел "+name+" уже есть");
+        Node node;
+        node.name=name;
+        node.kind=kind;
+        for(auto &in: inputs){
+            auto it=index_.find(in);
+            if(it==index_.end()) throw std::runtime_error("GraphNetwork: нет узла "+in+" (вход "+name+")");
+            node.inputs.push_back(it->second);
+        }
+        // Входы добавляются раньше узла, поэтому граф ациклический по построению
+        index_[name]=nodes_.size();
+        nodes_.push_back(std::move(node));
+        compiled_=false;
+        return nodes_.size()-1;
+    }
+
+    void compile(){
+        if(compiled_) return;
+        // Узлы, от которых выход не зависит, не выполняются
+        std::vector<bool> needed(nodes_.size(),false);
+        needed[output_]=true;
+        for(size_t i=nodes_.size();i-->0;){
+            if(!needed[i]) continue;
+            for(size_t in: nodes_[i].inputs) needed[in]=true;
+        }
+        std::vector<size_t> level(nodes_.size(),0);
+        for(auto &n: nodes_) n.consumers=0;
+        size_t depth=0;
+        for(size_t i=0;i<nodes_.size();++i){
+            if(!needed[i]) continue;
+            for(size_t in: nodes_[i].inputs){
+                level[i]=std::max(level[i],level[in]+1);
+                ++nodes_[in].consumers;
+            }
+            depth=std::max(depth,level[i]);
+        }
+        levels_.assign(depth+1,{});
+        for(size_t i=0;i<nodes_.size();++i) if(needed[i]) levels_[level[i]].push_back(i);
+        compiled_=true;
+    }
+
+    static void check_same_shape(const std::vector<Matrix<T>>& a,const std::vector<Matrix<T>>& b,const std::string& name){
+        if(a.size()!=b.size()) throw std::runtime_error("GraphNetwork: Add "+name+" - разное число каналов");
+        for(size_t c=0;c<a.size();++c){
+            if(a[c].rows()!=b[c].rows()||a[c].cols()!=b[c].cols())
+                throw std::runtime_error("GraphNetwork: Add "+name+" - разные размеры");
+        }
+    }
+
+    std::vector<Matrix<T>> run_forward(Node& node){
+        switch(node.kind){
+        case NodeKind::Layer:
+            return node.layer->forward(outputs_[node.inputs[0]]);
+        case NodeKind::Add: {
+            std::vector<Matrix<T>> out=outputs_[node.inputs[0]];
+            for(size_t k=1;k<node.inputs.size();++k){
+                const std::vector<Matrix<T>>& in=outputs_[node.inputs[k]];
+                check_same_shape(out,in,node.name);
+                for(size_t c=0;c<out.size();++c){
+                    T* o=out[c].data();
+                    const T* x=in[c].data();
+                    for(size_t i=0;i<out[c].size();++i) o[i]+=x[i];
+                }
+            }
+            return out;
+        }
+        case NodeKind::Concat:
+            return concat(node);
+        default:
+            throw std::runtime_error("GraphNetwork: вход графа не выполняется");
+        }
+    }
+
+    std::vector<Matrix<T>> concat(Node& node){
+        node.split.clear();
+        std::vector<Matrix<T>> out;
+        if(node.axis==ConcatAxis::Channels){
+            for(size_t in: node.inputs){
+                const std::vector<Matrix<T>>& x=outputs_[in];
+                node.split.push_back(x.size());
+                out.insert(out.end(),x.begin(),x.end());
+            }
+            return out;
+        }
+        const std::vector<Matrix<T>>& first=outputs_[node.inputs[0]];
+        size_t total_cols=0;
+        for(size_t in: node.inputs){
+            const std::vector<Matrix<T>>& x=outputs_[in];
+            if(x.size()!=first.size()) throw std::runtime_error("GraphNetwork: Concat "+node.name+" - разное число каналов");
+            for(size_t c=0;c<x.size();++c){
+                if(x[c].rows()!=first[c].rows()) throw std::runtime_error("GraphNetwork: Concat "+node.name+" - разное число строк");
+            }
+            node.split.push_back(x.empty()?0:x[0].cols());
+            total_cols+=node.split.back();
+        }
+        for(size_t c=0;c<first.size();++c){
+            size_t rows=first[c].rows();
+            Matrix<T> m(rows,total_cols,0);
+            size_t offset=0;
+            for(size_t k=0;k<node.inputs.size();++k){
+                const Matrix<T>& x=outputs_[node.inputs[k]][c];
+                if(x.cols()!=node.split[k]) throw std::runtime_error("GraphNetwork: Concat "+node.name+" - каналы разной ширины");
+                for(size_t r=0;r<rows;++r){
+                    std::copy(x.data()+r*x.cols(),x.data()+(r+1)*x.cols(),m.data()+r*total_cols+offset);
+                }
+                offset+=x.cols();
+            }
+            out.push_back(std::move(m));
+        }
+        return out;
+    }
+
+    // Градиенты по входам узла, в порядке node.inputs
+    std::vector<std::vector<Matrix<T>>> run_backward(Node& node,const std::vector<Matrix<T>>& grad,T learning_rate,T lambda){
+        switch(node.kind){
+        case NodeKind::Layer:
+            return {node.layer->backward(grad,learning_rate,lambda)};
+        case NodeKind::Add:
+            return std::vector<std::vector<Matrix<T>>>(node.inputs.size(),grad);
+        case NodeKind::Concat: {
+            std::vector<std::vector<Matrix<T>>> result(node.inputs.size());
+            if(node.axis==ConcatAxis::Channels){
+                size_t offset=0;
+                for(size_t k=0;k<node.inputs.size();++k){
+                    result[k].assign(grad.begin()+offset,grad.begin()+offset+node.split[k]);
+                    offset+=node.split[k];
+                }
+                return result;
+            }
+            for(size_t c=0;c<grad.size();++c){
+                size_t rows=grad[c].rows(),cols=grad[c].cols();
+                size_t offset=0;
+                for(size_t k=0;k<node.inputs.size();++k){
+                    Matrix<T> m(rows,node.split[k],0);
+                    for(size_t r=0;r<rows;++r){
+                        const T* src=grad[c].data()+r*cols+offset;
+                        std::copy(src,src+node.split[k],m.data()+r*node.split[k]);
+                    }
+                    result[k].push_back(std::move(m));
+                    offset+=node.split[k];
+                }
+            }
+            return result;
+        }
+        default:
+            return {};
+        }
+    }
+
+    static void accumulate(std::vector<Matrix<T>>& dst,std::vector<Matrix<T>>&& src){
+        if(dst.empty()){
+            dst=std::move(src);
+            return;
+        }
+        for(size_t c=0;c<dst.size();++c){
+            T* d=dst[c].data();
+            const T* s=src[c].data();
+            for(size_t i=0;i<dst[c].size();++i) d[i]+=s[i];
+        }
+    }
+
+public:
+    GraphNetwork(){
+        add_node("input",NodeKind::Input,{});
+    }
+
+    std::string name() const override { return "Graph"; }
+
+    // Слой с одним входом
+    void add_layer(const std::string& name,std::unique_ptr<Layer<T>> layer,const std::string& input){
+        size_t id=add_node(name,NodeKind::Layer,{input});
+        nodes_[id].layer=std::move(layer);
+        nodes_[id].layer->set_training(this->training_);
+        nodes_[id].layer->set_accumulate_gradients(this->accumulate_gradients_);
+        nodes_[id].layer->set_cache_precision(this->cache_precision_);
+        if(!output_set_) output_=id;
+    }
+
+    // Поэлементная сумма входов одинаковой формы (skip connection)
+    void add_add(const std::string& name,const std::vector<std::string>& inputs){
+        if(inputs.size()<2) throw std::runtime_error("GraphNetwork: Add требует минимум два входа");
+        size_t id=add_node(name,NodeKind::Add,inputs);
+        if(!output_set_) output_=id;
+    }
+
+    void add_concat(const std::string& name,const std::vector<std::string>& inputs,ConcatAxis axis=ConcatAxis::Channels){
+        if(inputs.empty()) throw std::runtime_error("GraphNetwork: Concat без входов");
+        size_t id=add_node(name,NodeKind::Concat,inputs);
+        nodes_[id].axis=axis;
+        if(!output_set_) output_=id;
+    }
+
+    void set_output(const std::string& name){
+        auto it=index_.find(name);
+        if(it==index_.end()) throw std::runtime_error("GraphNetwork: нет узла "+name);
+        output_=it->second;
+        output_set_=true;
+        compiled_=false;
+    }
+
+    Layer<T>& layer(const std::string& name){
+        auto it=index_.find(name);
+        if(it==index_.end()||!nodes_[it->second].layer) throw std::runtime_error("GraphNetwork: нет слоя "+name);
+        return *nodes_[it->second].layer;
+    }
+
+    // Узлы по уровням (индексы в порядке добавления); узлы одного уровня выполняются параллельно
+    const std::vector<std::vector<size_t>>& levels(){
+        compile();
+        return levels_;
+    }
+
+    std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
+        compile();
+        outputs_.assign(nodes_.size(),{});
+        outputs_[0]=input;
+        std::vector<size_t> remaining(nodes_.size());
+        for(size_t i=0;i<nodes_.size();++i) remaining[i]=nodes_[i].consumers;
+        for(size_t l=1;l<levels_.size();++l){
+            const std::vector<size_t>& level=levels_[l];
+            parallel_for(0,level.size(),1,[&](size_t lo,size_t hi){
+                for(size_t k=lo;k<hi;++k) outputs_[level[k]]=run_forward(nodes_[level[k]]);
+            });
+            // Выходы, которые больше никому не нужны, освобождаются сразу
+            for(size_t id: level){
+                for(size_t in: nodes_[id].inputs){
+                    if(--remaining[in]==0&&in!=output_) outputs_[in].clear();
+                }
+            }
+        }
+        std::vector<Matrix<T>> result=std::move(outputs_[output_]);
+        outputs_.clear();
+        return result;
+    }
+
+    std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss,T learning_rate,T lambda=0.0) override {
+        compile();
+        grads_.assign(nodes_.size(),{});
+        grads_[output_]=dLoss;
+        for(size_t l=levels_.size();l-->1;){
+            const std::vector<size_t>& level=levels_[l];
+            std::vector<std::vector<std::vector<Matrix<T>>>> input_grads(level.size());
+            parallel_for(0,level.size(),1,[&](size_t lo,size_t hi){
+                for(size_t k=lo;k<hi;++k){
+                    Node& node=nodes_[level[k]];
+                    std::vector<Matrix<T>> grad=std::move(grads_[level[k]]);
+                    // Выход узла не дошёл до лосса (ветвь не используется) - только сбросить кэш
+                    if(grad.empty()){
+                        if(node.layer) node.layer->release_cache();
+                        continue;
+                    }
+                    input_grads[k]=run_backward(node,grad,learning_rate,lambda);
+                }
+            });
+            // Суммирование - после уровня: у узлов уровня могут быть общие входы
+            for(size_t k=0;k<level.size();++k){
+                const Node& node=nodes_[level[k]];
+                for(size_t j=0;j<input_grads[k].size();++j) accumulate(grads_[node.inputs[j]],std::move(input_grads[k][j]));
+            }
+        }
+        std::vector<Matrix<T>> result=std::move(grads_[0]);
+        grads_.clear();
+        return result;
+    }
+
+    void set_training(bool training) override {
+        this->training_=training;
+        for(auto &n: nodes_) if(n.layer) n.layer->set_training(training);
+    }
+
+    void set_accumulate_gradients(bool accumulate) override {
+        this->accumulate_gradients_=accumulate;
+        for(auto &n: nodes_) if(n.layer) n.layer->set_accumulate_gradients(accumulate);
+    }
+
+    void set_cache_precision(Precision p) override {
+        this->cache_precision_=p;
+        for(auto &n: nodes_) if(n.layer) n.layer->set_cache_precision(p);
+    }
+
+    void apply_gradients(T learning_rate,T lambda=0.0) override {
+        for(auto &n: nodes_) if(n.layer) n.layer->apply_gradients(learning_rate,lambda);
+    }
+
+    std::vector<ParameterView<T>> gradients() override {
+        std::vector<ParameterView<T>> views;
+        for(auto &n: nodes_){
+            if(!n.layer) continue;
+            auto v=n.layer->gradients();
+            views.insert(views.end(),v.begin(),v.end());
+        }
+        return views;
+    }
+
+    std::vector<ParameterView<T>> parameters() override {
+        std::vector<ParameterView<T>> views;
+        for(auto &n: nodes_){
+            if(!n.layer) continue;
+            auto v=n.layer->parameters();
+            views.insert(views.end(),v.begin(),v.end());
+        }
+        return views;
+    }
+
+    bool has_parameters() const override {
+        for(auto &n: nodes_) if(n.layer&&n.layer->has_parameters()) return true;
+        return false;
+    }
+
+    void release_cache() override {
+        for(auto &n: nodes_) if(n.layer) n.layer->release_cache();
+    }
+
+    size_t cache_bytes() const override {
+        size_t total=0;
+        for(auto &n: nodes_) if(n.layer) total+=n.layer->cache_bytes();
+        return total;
+    }
+};
@@ -0,0 +1,311 @@
+#pragma once
+#include "layer.hpp"
+#include "../utils/activation_cache.hpp"
+#include "../utils/thread_pool.hpp"
+#include <cmath>
+#include <stdexcept>
+
+// По какой оси считаются статистики
+enum class NormAxis {
+    Channels, // после свёртки: num_features каналов, среднее по всем элементам канала
+    Features  // после FullyConnected: один канал [N x num_features], среднее по строкам (батчу)
+};
+
+/**
+ * BatchNormLayer: y = gamma*(x-mean)/sqrt(var+eps)+beta.
+ * На обучении mean/var берутся по батчу и копятся в running-статистики (momentum);
+ * повторный forward того же батча (is_recomputing) статистики не трогает.
+ * в режиме inference (set_training(false)) используются running-статистики.
+ * Для сервинга слой вливается в предыдущую свёртку/FC через fold_batch_norm().
+ */
+template<typename T>
+class BatchNormLayer : public Layer<T> {
+private:
+    size_t num_features_;
+    NormAxis axis_;
+    T momentum_;
+    T eps_;
+
+    std::vector<T> gamma_;
+    std::vector<T> beta_;
+    std::vector<T> running_mean_;
+    std::vector<T> running_var_;
+
+    // Для backward: нормированный вход x_hat и 1/sqrt(var+eps) батча
+    ActivationCache<T> normalized_cache_;
+    std::vector<T> inv_std_;
+
+    // Накопленные градиенты при accumulate_gradients_
+    std::vector<T> acc_gamma_;
+    std::vector<T> acc_beta_;
+
+public:
+    BatchNormLayer(size_t num_features,NormAxis axis=NormAxis::Channels,T momentum=0.1,T eps=1e-5)
+        : num_features_(num_features), axis_(axis), momentum_(momentum), eps_(eps),
+          gamma_(num_features,1), beta_(num_features,0),
+          running_mean_(num_features,0), running_var_(num_features,1), inv_std_(num_features,1) {}
+
+    std::string name() const override { return "BatchNorm"; }
+    size_t num_features() const { return num_features_; }
+    NormAxis axis() const { return axis_; }
+    T eps() const { return eps_; }
+    const std::vector<T>& gamma() const { return gamma_; }
+    const std::vector<T>& beta() const { return beta_; }
+    const std::vector<T>& running_mean() const { return running_mean_; }
+    const std::vector<T>& running_var() const { return running_var_; }
+
+    std::vector<ParameterView<T>> parameters() override {
+        return {{gamma_.data(),gamma_.size()},{beta_.data(),beta_.size()},
+                {running_mean_.data(),running_mean_.size()},{running_var_.data(),running_var_.size()}};
+    }
+    bool has_parameters() const override { return true; }
+
+    void release_cache() override { normalized_cache_.clear(); }
+    size_t cache_bytes() const override { return normalized_cache_.bytes(); }
+
+    // Инференс-преобразование в виде y = scale*x + shift для каждого признака
+    void inference_affine(std::vector<T>& scale,std::vector<T>& shift) const {
+        scale.resize(num_features_);
+        shift.resize(num_features_);
+        for(size_t f=0;f<num_features_;++f){
+            scale[f]=gamma_[f]/std::sqrt(running_var_[f]+eps_);
+            shift[f]=beta_[f]-running_mean_[f]*scale[f];
+        }
+    }
+
+    std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
+        check_input(input,"forward");
+        if(!this->training_){
+            std::vector<T> scale,shift;
+            inference_affine(scale,shift);
+            return affine(input,scale,shift);
+        }
+
+        std::vector<T> mean(num_features_,0),var(num_features_,0);
+        size_t count=batch_statistics(input,mean,var);
+        for(size_t f=0;f<num_features_;++f){
+            inv_std_[f]=(T)1/std::sqrt(var[f]+eps_);
+            if(this->recomputing_) continue;
+            T unbiased=count>1?var[f]*(T)count/(T)(count-1):var[f];
+            running_mean_[f]=((T)1-momentum_)*running_mean_[f]+momentum_*mean[f];
+            running_var_[f]=((T)1-momentum_)*running_var_[f]+momentum_*unbiased;
+        }
+
+        std::vector<Matrix<T>> normalized,output;
+        normalize(input,mean,normalized,output);
+        normalized_cache_.store(std::move(normalized),this->cache_precision_);
+        return output;
+    }
+
+    std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss,T learning_rate,T /*lambda*/=0.0) override {
+        check_input(dLoss,"backward");
+        if(!this->training_){
+            // Статистики фиксированы: слой линейный, параметры не обновляются
+            std::vector<T> scale,shift;
+            inference_affine(scale,shift);
+            std::vector<T> zero(num_features_,0);
+            return affine(dLoss,scale,zero);
+        }
+        if(normalized_cache_.empty()) throw std::runtime_error("BatchNormLayer backward: нет закэшированного forward");
+        std::vector<Matrix<T>> x_hat=normalized_cache_.take();
+
+        // dgamma = sum(dy*x_hat), dbeta = sum(dy);
+        // dx = gamma*inv_std/m * (m*dy - dbeta - x_hat*dgamma)
+        std::vector<T> dgamma(num_features_,0),dbeta(num_features_,0);
+        std::vector<Matrix<T>> dInput;
+        if(axis_==NormAxis::Channels){
+            dInput.resize(num_features_);
+            size_t m=dLoss[0].size();
+            parallel_for(0,num_features_,ThreadPool::grain_size(m*6),[&](size_t lo,size_t hi){
+                for(size_t c=lo;c<hi;++c){
+                    const T* dy=dLoss[c].data();
+                    const T* xh=x_hat[c].data();
+                    T sg=0,sb=0;
+                    for(size_t i=0;i<m;++i){
+                        sg+=dy[i]*xh[i];
+                        sb+=dy[i];
+                    }
+                    dgamma[c]=sg;
+                    dbeta[c]=sb;
+                    T k=gamma_[c]*inv_std_[c]/(T)m;
+                    Matrix<T> dx(dLoss[c].rows(),dLoss[c].cols(),0);
+                    T* out=dx.data();
+                    for(size_t i=0;i<m;++i) out[i]=k*((T)m*dy[i]-sb-xh[i]*sg);
+                    dInput[c]=std::move(dx);
+                }
+            });
+        } else {
+            const Matrix<T>& dL=dLoss[0];
+            size_t rows=dL.rows(),cols=num_features_;
+            Matrix<T> dx(rows,cols,0);
+            const T* dy=dL.data();
+            const T* xh=x_hat[0].data();
+            T* out=dx.data();
+            // Столбцы независимы; внутренний цикл идёт по строке подряд
+            parallel_for(0,cols,ThreadPool::grain_size(rows*6),[&](size_t lo,size_t hi){
+                for(size_t i=0;i<rows;++i){
+                    for(size_t j=lo;j<hi;++j){
+                        dgamma[j]+=dy[i*cols+j]*xh[i*cols+j];
+                        dbeta[j]+=dy[i*cols+j];
+                    }
+                }
+                for(size_t i=0;i<rows;++i){
+                    for(size_t j=lo;j<hi;++j){
+                        T k=gamma_[j]*inv_std_[j]/(T)rows;
+                        out[i*cols+j]=k*((T)rows*dy[i*cols+j]-dbeta[j]-xh[i*cols+j]*dgamma[j]);
+                    }
+                }
+            });
+            dInput.push_back(std::move(dx));
+        }
+
+        if(this->accumulate_gradients_){
+            if(acc_gamma_.empty()){
+                acc_gamma_.assign(num_features_,0);
+                acc_beta_.assign(num_features_,0);
+            }
+            for(size_t f=0;f<num_features_;++f){
+                acc_gamma_[f]+=dgamma[f];
+                acc_beta_[f]+=dbeta[f];
+            }
+        } else {
+            for(size_t f=0;f<num_features_;++f){
+                gamma_[f]-=learning_rate*dgamma[f];
+                beta_[f]-=learning_rate*dbeta[f];
+            }
+        }
+        return dInput;
+    }
+
+    std::vector<ParameterView<T>> gradients() override {
+        if(acc_gamma_.empty()) return {};
+        return {{acc_gamma_.data(),acc_gamma_.size()},{acc_beta_.data(),acc_beta_.size()}};
+    }
+
+    void apply_gradients(T learning_rate,T /*lambda*/=0.0) override {
+        if(acc_gamma_.empty()) return;
+        for(size_t f=0;f<num_features_;++f){
+            gamma_[f]-=learning_rate*acc_gamma_[f];
+            beta_[f]-=learning_rate*acc_beta_[f];
+        }
+        acc_gamma_.clear();
+        acc_beta_.clear();
+    }
+
+private:
+    void check_input(const std::vector<Matrix<T>>& input,const char* where) const {
+        bool ok=axis_==NormAxis::Channels?input.size()==num_features_
+                                         :input.size()==1&&input[0].cols()==num_features_;
+        if(!ok) throw std::runtime_error(std::string("BatchNormLayer ")+where+": неверная размерность входа");
+    }
+
+    // Среднее и смещённая дисперсия по оси нормировки; возвращает число элементов на признак
+    size_t batch_statistics(const std::vector<Matrix<T>>& input,std::vector<T>& mean,std::vector<T>& var) const {
+        if(axis_==NormAxis::Channels){
+            size_t m=input[0].size();
+            parallel_for(0,num_features_,ThreadPool::grain_size(m*3),[&](size_t lo,size_t hi){
+                for(size_t c=lo;c<hi;++c){
+                    const T* x=input[c].data();
+                    T sum=0;
+                    for(size_t i=0;i<m;++i) sum+=x[i];
+                    T mu=sum/(T)m;
+                    T sq=0;
+                    for(size_t i=0;i<m;++i) sq+=(x[i]-mu)*(x[i]-mu);
+                    mean[c]=mu;
+                    var[c]=sq/(T)m;
+                }
+            });
+            return m;
+        }
+        const Matrix<T>& in=input[0];
+        size_t rows=in.rows(),cols=num_features_;
+        const T* x=in.data();
+        parallel_for(0,cols,ThreadPool::grain_size(rows*3),[&](size_t lo,size_t hi){
+            for(size_t i=0;i<rows;++i){
+                for(size_t j=lo;j<hi;++j) mean[j]+=x[i*cols+j];
+            }
+            for(size_t j=lo;j<hi;++j) mean[j]/=(T)rows;
+            for(size_t i=0;i<rows;++i){
+                for(size_t j=lo;j<hi;++j){
+                    T d=x[i*cols+j]-mean[j];
+                    var[j]+=d*d;
+                }
+            }
+            for(size_t j=lo;j<hi;++j) var[j]/=(T)rows;
+        });
+        return rows;
+    }
+
+    // x_hat = (x-mean)*inv_std и y = gamma*x_hat+beta за один проход по входу
+    void normalize(const std::vector<Matrix<T>>& input,const std::vector<T>& mean,
+                   std::vector<Matrix<T>>& normalized,std::vector<Matrix<T>>& output) const {
+        normalized.resize(input.size());
+        output.resize(input.size());
+        if(axis_==NormAxis::Channels){
+            size_t m=input[0].size();
+            parallel_for(0,num_features_,ThreadPool::grain_size(m*4),[&](size_t lo,size_t hi){
+                for(size_t c=lo;c<hi;++c){
+                    Matrix<T> xh_m(input[c].rows(),input[c].cols(),0),y_m(input[c].rows(),input[c].cols(),0);
+                    const T* x=input[c].data();
+                    T* xh=xh_m.data();
+                    T* y=y_m.data();
+                    T mu=mean[c],inv=inv_std_[c],g=gamma_[c],b=beta_[c];
+                    for(size_t i=0;i<m;++i){
+                        xh[i]=(x[i]-mu)*inv;
+                        y[i]=g*xh[i]+b;
+                    }
+                    normalized[c]=std::move(xh_m);
+                    output[c]=std::move(y_m);
+                }
+            });
+            return;
+        }
+        const Matrix<T>& in=input[0];
+        size_t rows=in.rows(),cols=num_features_;
+        Matrix<T> xh_m(rows,cols,0),y_m(rows,cols,0);
+        const T* x=in.data();
+        T* xh=xh_m.data();
+        T* y=y_m.data();
+        parallel_for(0,rows,ThreadPool::grain_size(cols*4),[&](size_t lo,size_t hi){
+            for(size_t i=lo;i<hi;++i){
+                for(size_t j=0;j<cols;++j){
+                    xh[i*cols+j]=(x[i*cols+j]-mean[j])*inv_std_[j];
+                    y[i*cols+j]=gamma_[j]*xh[i*cols+j]+beta_[j];
+                }
+            }
+        });
+        normalized[0]=std::move(xh_m);
+        output[0]=std::move(y_m);
+    }
+
+    // out = scale[f]*x + shift[f] по оси нормировки
+    std::vector<Matrix<T>> affine(const std::vector<Matrix<T>>& input,const std::vector<T>& scale,const std::vector<T>& shift) const {
+        std::vector<Matrix<T>> output(input.size());
+        if(axis_==NormAxis::Channels){
+            size_t m=input[0].size();
+            parallel_for(0,num_features_,ThreadPool::grain_size(m*2),[&](size_t lo,size_t hi){
+                for(size_t c=lo;c<hi;++c){
+                    Matrix<T> out(input[c].rows(),input[c].cols(),0);
+                    const T* x=input[c].data();
+                    T* y=out.data();
+                    T a=scale[c],b=shift[c];
+                    for(size_t i=0;i<m;++i) y[i]=a*x[i]+b;
+                    output[c]=std::move(out);
+                }
+            });
+            return output;
+        }
+        const Matrix<T>& in=input[0];
+        size_t rows=in.rows(),cols=num_features_;
+        Matrix<T> out(rows,cols,0);
+        const T* x=in.data();
+        T* y=out.data();
+        parallel_for(0,rows,ThreadPool::grain_size(cols*2),[&](size_t lo,size_t hi){
+            for(size_t i=lo;i<hi;++i){
+                for(size_t j=0;j<cols;++j) y[i*cols+j]=scale[j]*x[i*cols+j]+shift[j];
+            }
+        });
+        output[0]=std::move(out);
+        return output;
+    }
+};
@@ -1,9 +1,21 @@
 #pragma once
 #include "layer.hpp"
+#include "../utils/activation_cache.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/autotuner.hpp"
+#include "../utils/image_batch.hpp"
 #include <cmath>
 #include <random>
 #include <stdexcept>
-
+#include <algorithm>
+
+/**
+ * Свёртка над списком каналов. При groups>1 каналы делятся на groups равных групп,
+ * и выходной канал группы g читает только входные каналы той же группы
+ * (groups==in_channels - depthwise-свёртка).
+ * После set_image_size(H,W) слой принимает и батч: канал [N x H*W], строка - изображение
+ * (image_batch); изображения батча проходят по одному, градиенты по ним суммируются.
+ */
 template<typename T>
 class ConvolutionalLayer : public Layer<T> {
 private:
@@ -12,127 +24,339 @@ private:
     int kernel_size_;
     int stride_;
     int padding_;
+    int groups_;
+    int group_in_;  // входных каналов на группу
+    int group_out_; // выходных каналов на группу
 
-    std::vector<Matrix<T>> kernels_; // размер out_channels_ * in_channels_
+    std::vector<Matrix<T>> kernels_; // размер out_channels_ * group_in_, ядро (out_c, in_c) - out_c*group_in_ + in_c%group_in_
     std::vector<T> biases_;
 
-    std::vector<std::vector<Matrix<T>>> input_cache_;
+    std::vector<ActivationCache<T>> input_cache_;
+    std::vector<size_t> forward_images_; // сколько записей input_cache_ добавил каждый forward
+
+    // Размер изображения во входном батче (0 - на входе только одно изображение)
+    int image_height_=0;
+    int image_width_=0;
+
+    // Winograd F(2x2,3x3): ядра в пространстве преобразования (4x4), пересчитываются после обновления весов.
+    // Только по set_winograd(true): результат отличается от прямой свёртки в пределах округления
+    bool winograd_enabled_=false;
+    bool winograd_dirty_=true;
+    std::vector<Matrix<T>> winograd_kernels_;
+    std::vector<Matrix<T>> winograd_flipped_; // то же для ядер, повёрнутых на 180° (градиент по входу)
+
+    // Вариант forward для входа tuned_height_ x tuned_width_: алгоритм (loop_order: 0 - прямая свёртка,
+    // 1 - Winograd) задаёт set_winograd, Autotuner подбирает только число задач; тот же алгоритм - для градиента по входу
+    KernelConfig forward_config_;
+    int tuned_height_=-1;
+    int tuned_width_=-1;
+
+    // Накопленные градиенты при accumulate_gradients_
+    std::vector<Matrix<T>> acc_kernels_;
+    std::vector<T> acc_biases_;
 
 public:
-    ConvolutionalLayer(int in_channels,int out_channels,int kernel_size,int stride=1,int padding=0)
+    ConvolutionalLayer(int in_channels,int out_channels,int kernel_size,int stride=1,int padding=0,int groups=1)
         : in_channels_(in_channels), out_channels_(out_channels), kernel_size_(kernel_size),
-          stride_(stride), padding_(padding) {
+          stride_(stride), padding_(padding), groups_(groups) {
+        if(groups<1||in_channels%groups!=0||out_channels%groups!=0)
+            throw std::runtime_error("ConvolutionalLayer: число каналов должно делиться на groups");
+        group_in_=in_channels/groups;
+        group_out_=out_channels/groups;
         initialize_kernels();
     }
 
-    std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
-        if((int)input.size()!=in_channels_){
-            throw std::runtime_error("ConvolutionalLayer: неверное число входных каналов.");
-        }
-        input_cache_.push_back(input);
-
-        int input_height=(int)input[0].rows();
-        int input_width=(int)input[0].cols();
-
-        int output_height=(input_height - kernel_size_ + 2*padding_)/stride_+1;
-        int output_width=(input_width - kernel_size_ + 2*padding_)/stride_+1;
+    std::string name() const override { return "Conv"; }
+    int in_channels() const { return in_channels_; }
+    int out_channels() const { return out_channels_; }
+    int kernel_size() const { return kernel_size_; }
+    int stride() const { return stride_; }
+    int padding() const { return padding_; }
+    int groups() const { return groups_; }
+    // Размер изображения батча (set_image_size); 0 - только один образец
+    int image_height() const { return image_height_; }
+    int image_width() const { return image_width_; }
+    const std::vector<Matrix<T>>& kernels() const { return kernels_; }
+    const std::vector<T>& biases() const { return biases_; }
+
+    std::vector<ParameterView<T>> parameters() override {
+        std::vector<ParameterView<T>> views;
+        for(auto &k: kernels_) views.push_back({k.data(),k.size()});
+        views.push_back({biases_.data(),biases_.size()});
+        winograd_dirty_=true;
+        return views;
+    }
+    bool has_parameters() const override { return true; }
 
-        std::vector<Matrix<T>> output_channels;
-        output_channels.reserve(out_channels_);
+    // y' = scale*y + shift по выходным каналам (вливание BatchNorm для inference)
+    void fold_output_affine(const std::vector<T>& scale,const std::vector<T>& shift){
+        if((int)scale.size()!=out_channels_||(int)shift.size()!=out_channels_)
+            throw std::runtime_error("ConvolutionalLayer: неверный размер scale/shift");
         for(int out_c=0;out_c<out_channels_;++out_c){
-            Matrix<T> out_ch(output_height,output_width,0);
-            for(int in_c=0;in_c<in_channels_;++in_c){
-                Matrix<T> convolved=convolve(input[in_c],kernels_[out_c*in_channels_+in_c],stride_,padding_);
-                // сложение convolved в out_ch
-                for(int i=0;i<output_height;++i){
-                    for(int j=0;j<output_width;++j){
-                        out_ch(i,j)+=convolved(i,j);
-                    }
-                }
+            for(int in_c=0;in_c<group_in_;++in_c){
+                Matrix<T>& k=kernels_[out_c*group_in_+in_c];
+                T* w=k.data();
+                for(size_t i=0;i<k.size();++i) w[i]*=scale[out_c];
             }
-            // Добавляем смещение
-            for(int i=0;i<output_height;++i){
-                for(int j=0;j<output_width;++j){
-                    out_ch(i,j)+=biases_[out_c];
-                }
-            }
-            output_channels.push_back(out_ch);
+            biases_[out_c]=biases_[out_c]*scale[out_c]+shift[out_c];
         }
+        winograd_dirty_=true;
+    }
 
-        return output_channels;
+    void release_cache() override {
+        if(forward_images_.empty()) return;
+        input_cache_.resize(input_cache_.size()-forward_images_.back());
+        forward_images_.pop_back();
+    }
+
+    size_t cache_bytes() const override {
+        size_t total=0;
+        for(auto &c: input_cache_) total+=c.bytes();
+        return total;
+    }
+
+    /**
+     * Winograd F(2x2,3x3) для ядер 3x3 со stride 1: меньше умножений на широких каналах (см. cnn_conv_check),
+     * но суммирование другое, и результат отличается от прямой свёртки в пределах округления.
+     * Поэтому он не кандидат Autotuner, а явный выбор; по умолчанию - прямая свёртка.
+     */
+    void set_winograd(bool enabled){
+        winograd_enabled_=enabled;
+        tuned_height_=tuned_width_=-1;
+    }
+
+    void set_image_size(int height,int width){
+        image_height_=height;
+        image_width_=width;
+    }
+
+    bool uses_winograd() const {
+        return winograd_enabled_&&kernel_size_==3&&stride_==1&&padding_<=2;
+    }
+
+    std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
+        if((int)input.size()!=in_channels_){
+            throw std::runtime_error("ConvolutionalLayer: неверное число входных каналов.");
+        }
+        if(!is_batch(input[0],image_height_,image_width_)){
+            if(this->training_) forward_images_.push_back(1);
+            return forward_image(input);
+        }
+        size_t n=input[0].rows();
+        int output_height=output_size(image_height_),output_width=output_size(image_width_);
+        std::vector<Matrix<T>> output(out_channels_,Matrix<T>(n,(size_t)output_height*output_width,0));
+        for(size_t i=0;i<n;++i) image_batch::store(output,i,forward_image(image_batch::sample(input,i,image_height_,image_width_)));
+        if(this->training_) forward_images_.push_back(n);
+        return output;
     }
 
     std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss, T learning_rate, T lambda=0.0) override {
         if((int)dLoss.size()!=out_channels_){
             throw std::runtime_error("ConvolutionalLayer backward: неверное число выходных каналов.");
         }
+        if(forward_images_.empty()) throw std::runtime_error("ConvolutionalLayer backward: нет закэшированного forward");
+        int output_height=output_size(image_height_),output_width=output_size(image_width_);
+        if(!is_batch(dLoss[0],output_height,output_width)){
+            forward_images_.pop_back();
+            return backward_image(dLoss,learning_rate,lambda);
+        }
+        size_t n=dLoss[0].rows();
+        if(forward_images_.back()!=n) throw std::runtime_error("ConvolutionalLayer backward: батч не совпадает с forward");
+        forward_images_.pop_back();
+        // Градиенты изображений суммируются, шаг - один на батч
+        bool accumulate=this->accumulate_gradients_;
+        this->accumulate_gradients_=true;
+        std::vector<Matrix<T>> grad_input(in_channels_,Matrix<T>(n,(size_t)image_height_*image_width_,0));
+        try{
+            // Кэши входов лежат стеком - изображения идут в обратном порядке
+            for(size_t i=n;i-->0;)
+                image_batch::store(grad_input,i,backward_image(image_batch::sample(dLoss,i,output_height,output_width),learning_rate,lambda));
+        }catch(...){
+            this->accumulate_gradients_=accumulate;
+            throw;
+        }
+        this->accumulate_gradients_=accumulate;
+        if(!accumulate) apply_gradients(learning_rate,lambda);
+        return grad_input;
+    }
+
+    std::vector<ParameterView<T>> gradients() override {
+        std::vector<ParameterView<T>> views;
+        if(acc_kernels_.empty()) return views;
+        for(auto &k: acc_kernels_) views.push_back({k.data(),k.size()});
+        views.push_back({acc_biases_.data(),acc_biases_.size()});
+        return views;
+    }
+
+    void apply_gradients(T learning_rate,T lambda=0.0) override {
+        if(acc_kernels_.empty()) return;
+        update_parameters(acc_kernels_,acc_biases_,learning_rate,lambda);
+        acc_kernels_.clear();
+        acc_biases_.clear();
+    }
+
+private:
+    // Одно изображение: каналы H x W
+    std::vector<Matrix<T>> forward_image(const std::vector<Matrix<T>>& input){
+        if(this->training_){
+            input_cache_.emplace_back();
+            input_cache_.back().store(input,this->cache_precision_);
+        }
+
+        int input_height=(int)input[0].rows();
+        int input_width=(int)input[0].cols();
+
+        if(tuned_height_!=input_height||tuned_width_!=input_width){
+            // Кандидаты одного алгоритма: выходные каналы делятся между задачами, суммы те же
+            int order=uses_winograd()?1:0;
+            std::vector<KernelConfig> candidates{{order,0,0}};
+            if(ThreadPool::instance().size()>1) candidates.push_back({order,0,1});
+            std::string key="Conv."+std::string(order==1?"winograd":"forward")+":"+std::to_string(in_channels_)+">"+
+                            std::to_string(out_channels_)+":k"+std::to_string(kernel_size_)+":s"+std::to_string(stride_)+
+                            ":p"+std::to_string(padding_)+":g"+std::to_string(groups_)+":"+std::to_string(input_height)+"x"+
+                            std::to_string(input_width)+":t"+std::to_string(ThreadPool::instance().size());
+            bool settled=true;
+            forward_config_=Autotuner::tune(key,candidates,[&](const KernelConfig& c){ compute_forward(input,c); },&settled);
+            // Старые записи кэша могли выбирать алгоритм - он определяется только set_winograd
+            forward_config_.loop_order=order;
+            if(settled){
+                tuned_height_=input_height;
+                tuned_width_=input_width;
+            }
+        }
+        return compute_forward(input,forward_config_);
+    }
 
-        const std::vector<Matrix<T>>& input=input_cache_.back();
+    std::vector<Matrix<T>> backward_image(const std::vector<Matrix<T>>& dLoss,T learning_rate,T lambda){
+        std::vector<Matrix<T>> input=input_cache_.back().take();
         input_cache_.pop_back();
 
         int input_height=(int)input[0].rows();
         int input_width=(int)input[0].cols();
 
         std::vector<Matrix<T>> grad_input(in_channels_, Matrix<T>(input_height,input_width,0));
-        std::vector<Matrix<T>> grad_kernels(out_channels_*in_channels_, Matrix<T>(kernel_size_,kernel_size_,0));
+        std::vector<Matrix<T>> grad_kernels(out_channels_*group_in_, Matrix<T>(kernel_size_,kernel_size_,0));
         std::vector<T> grad_biases(out_channels_,0);
 
-        for(int out_c=0;out_c<out_channels_;++out_c){
-            for(int in_c=0;in_c<in_channels_;++in_c){
-                Matrix<T> gk=compute_grad_kernel(input[in_c],dLoss[out_c],stride_,padding_);
-                for(int rr=0;rr<kernel_size_;++rr){
-                    for(int cc=0;cc<kernel_size_;++cc){
-                        grad_kernels[out_c*in_channels_+in_c](rr,cc)=gk(rr,cc);
-                    }
-                }
-
-                Matrix<T> gi=compute_grad_input(dLoss[out_c],kernels_[out_c*in_channels_+in_c],stride_,padding_);
-                for(int rr=0;rr<input_height;++rr){
-                    for(int cc=0;cc<input_width;++cc){
-                        grad_input[in_c](rr,cc)+=gi(rr,cc);
+        // Градиент по входу при stride 1 - это корреляция dLoss (с паддингом K-1-p) с ядром,
+        // повёрнутым на 180°, поэтому для Winograd используются повёрнутые преобразованные ядра
+        bool winograd=uses_winograd()&&forward_config_.loop_order==1;
+        size_t pair_cost=dLoss[0].size()*kernel_size_*kernel_size_;
+        // Градиенты по ядрам и по входу независимы (оба читают текущие ядра) - считаются одновременно
+        parallel_invoke([&](){
+            // grad по ядрам и смещениям: каждый out_c пишет только в свои ячейки
+            parallel_for(0,out_channels_,ThreadPool::grain_size(pair_cost*group_in_),[&](size_t lo,size_t hi){
+                for(int out_c=(int)lo;out_c<(int)hi;++out_c){
+                    int first_in=(out_c/group_out_)*group_in_;
+                    for(int in_c=0;in_c<group_in_;++in_c){
+                        grad_kernels[out_c*group_in_+in_c]=compute_grad_kernel(input[first_in+in_c],dLoss[out_c],stride_,padding_);
                     }
+                    // grad по смещениям
+                    grad_biases[out_c]=sum(dLoss[out_c]);
                 }
+            });
+        },[&](){
+            if(winograd){
+                int group_in=group_in_;
+                grad_input=winograd_correlate(dLoss,in_channels_,
+                    [group_in](int dst,int src){ return src*group_in+dst%group_in; },
+                    2-padding_,input_height,input_width,true,forward_config_);
+                return;
             }
-            // grad по смещениям
-            for(int i=0;i<(int)dLoss[out_c].rows();++i){
-                for(int j=0;j<(int)dLoss[out_c].cols();++j){
-                    grad_biases[out_c]+=dLoss[out_c](i,j);
+            // grad по входу накапливается по out_c, поэтому делим по in_c
+            parallel_for(0,in_channels_,ThreadPool::grain_size(pair_cost*group_out_),[&](size_t lo,size_t hi){
+                for(int in_c=(int)lo;in_c<(int)hi;++in_c){
+                    int first_out=(in_c/group_in_)*group_out_;
+                    for(int out_c=first_out;out_c<first_out+group_out_;++out_c){
+                        grad_input[in_c]+=compute_grad_input(dLoss[out_c],kernels_[out_c*group_in_+in_c%group_in_],stride_,padding_,
+                                                             input_height,input_width);
+                    }
                 }
+            });
+        });
+
+        if(this->accumulate_gradients_){
+            if(acc_kernels_.empty()){
+                acc_kernels_=std::move(grad_kernels);
+                acc_biases_=std::move(grad_biases);
+            } else {
+                for(size_t i=0;i<acc_kernels_.size();++i) acc_kernels_[i]+=grad_kernels[i];
+                for(int out_c=0;out_c<out_channels_;++out_c) acc_biases_[out_c]+=grad_biases[out_c];
             }
+        } else {
+            update_parameters(grad_kernels,grad_biases,learning_rate,lambda);
         }
 
-        // Обновление параметров
-        for(int i=0;i<out_channels_*in_channels_;++i){
-            if(lambda>0){
-                for(int rr=0;rr<kernel_size_;++rr){
-                    for(int cc=0;cc<kernel_size_;++cc){
-                        grad_kernels[i](rr,cc)+=lambda*kernels_[i](rr,cc);
-                    }
-                }
+        return grad_input;
+    }
+
+    int output_size(int input_size) const {
+        return (input_size-kernel_size_+2*padding_)/stride_+1;
+    }
+
+    // Канал батча: [N x H*W] при заданном размере изображения, а не само изображение H x W
+    bool is_batch(const Matrix<T>& channel,int height,int width) const {
+        return image_height_>0&&channel.cols()==(size_t)height*width&&
+               !(channel.rows()==(size_t)height&&channel.cols()==(size_t)width);
+    }
+
+    std::vector<Matrix<T>> compute_forward(const std::vector<Matrix<T>>& input,const KernelConfig& config){
+        int input_height=(int)input[0].rows();
+        int input_width=(int)input[0].cols();
+
+        int output_height=(input_height - kernel_size_ + 2*padding_)/stride_+1;
+        int output_width=(input_width - kernel_size_ + 2*padding_)/stride_+1;
+
+        if(config.loop_order==1&&uses_winograd()){
+            int group_in=group_in_;
+            std::vector<Matrix<T>> output_channels=winograd_correlate(input,out_channels_,
+                [group_in](int dst,int src){ return dst*group_in+src%group_in; },
+                padding_,output_height,output_width,false,config);
+            for(int out_c=0;out_c<out_channels_;++out_c){
+                T* out=output_channels[out_c].data();
+                for(size_t i=0;i<output_channels[out_c].size();++i) out[i]+=biases_[out_c];
             }
+            return output_channels;
+        }
 
-            for(int rr=0;rr<kernel_size_;++rr){
-                for(int cc=0;cc<kernel_size_;++cc){
-                    kernels_[i](rr,cc)-=learning_rate*grad_kernels[i](rr,cc);
+        // Выходные каналы независимы - делим работу по out_c
+        std::vector<Matrix<T>> output_channels(out_channels_);
+        size_t channel_cost=(size_t)group_in_*output_height*output_width*kernel_size_*kernel_size_;
+        parallel_for(0,out_channels_,config.grain(out_channels_,channel_cost),[&](size_t lo,size_t hi){
+            for(int out_c=(int)lo;out_c<(int)hi;++out_c){
+                Matrix<T> out_ch(output_height,output_width,0);
+                int first_in=(out_c/group_out_)*group_in_;
+                for(int in_c=0;in_c<group_in_;++in_c){
+                    out_ch+=convolve(input[first_in+in_c],kernels_[out_c*group_in_+in_c],stride_,padding_);
                 }
+                // Добавляем смещение
+                out_ch+=biases_[out_c];
+                output_channels[out_c]=std::move(out_ch);
             }
+        });
+
+        return output_channels;
+    }
+
+    void update_parameters(std::vector<Matrix<T>>& grad_kernels,std::vector<T>& grad_biases,T learning_rate,T lambda){
+        for(size_t i=0;i<kernels_.size();++i){
+            if(lambda>0) grad_kernels[i]+=lambda*kernels_[i];
+            kernels_[i]-=learning_rate*grad_kernels[i];
         }
 
         for(int out_c=0;out_c<out_channels_;++out_c){
             if(lambda>0) grad_biases[out_c]+=lambda*biases_[out_c];
             biases_[out_c]-=learning_rate*grad_biases[out_c];
         }
-
-        return grad_input;
+        winograd_dirty_=true;
     }
 
-private:
     void initialize_kernels(){
         std::mt19937 gen(std::random_device{}());
-        T stddev=std::sqrt((T)2.0/(T)(in_channels_*kernel_size_*kernel_size_));
+        T stddev=std::sqrt((T)2.0/(T)(group_in_*kernel_size_*kernel_size_));
         std::normal_distribution<T> dist(0,stddev);
 
-        for(int i=0;i<out_channels_*in_channels_;++i){
+        for(int i=0;i<out_channels_*group_in_;++i){
             Matrix<T> k(kernel_size_,kernel_size_,0);
             for(int m=0;m<kernel_size_;++m){
                 for(int n=0;n<kernel_size_;++n){
@@ -200,12 +424,9 @@ private:
         return grad_k;
     }
 
-    Matrix<T> compute_grad_input(const Matrix<T>& dLoss,const Matrix<T>& kernel,int stride,int padding){
-        Matrix<T> flipped=flip_matrix(kernel);
-
-        int grad_input_height=(dLoss.rows()-1)*stride - 2*padding + kernel_size_;
-        int grad_input_width=(dLoss.cols()-1)*stride - 2*padding + kernel_size_;
-
+    // Размер входа передаётся явно: при stride>1 он не восстанавливается однозначно по dLoss
+    Matrix<T> compute_grad_input(const Matrix<T>& dLoss,const Matrix<T>& kernel,int stride,int padding,
+                                 int grad_input_height,int grad_input_width){
         Matrix<T> grad_in(grad_input_height,grad_input_width,0);
         for(int i=0;i<(int)dLoss.rows();++i){
             for(int j=0;j<(int)dLoss.cols();++j){
@@ -214,7 +435,7 @@ private:
                         int x=i*stride+m-padding;
                         int y=j*stride+n-padding;
                         if(x>=0&&x<grad_input_height&&y>=0&&y<grad_input_width){
-                            grad_in(x,y)+=dLoss(i,j)*flipped(m,n);
+                            grad_in(x,y)+=dLoss(i,j)*kernel(m,n);
                         }
                     }
                 }
@@ -224,7 +445,134 @@ private:
         return grad_in;
     }
 
-    Matrix<T> flip_matrix(const Matrix<T>& mat){
+    // U = G g G^T для ядра 3x3
+    static void winograd_transform(const Matrix<T>& g,Matrix<T>& transformed){
+        T tmp[4][3];
+        for(int c=0;c<3;++c){
+            tmp[0][c]=g(0,c);
+            tmp[1][c]=(g(0,c)+g(1,c)+g(2,c))/(T)2;
+            tmp[2][c]=(g(0,c)-g(1,c)+g(2,c))/(T)2;
+            tmp[3][c]=g(2,c);
+        }
+        T* u=transformed.data();
+        for(int r=0;r<4;++r){
+            u[r*4+0]=tmp[r][0];
+            u[r*4+1]=(tmp[r][0]+tmp[r][1]+tmp[r][2])/(T)2;
+            u[r*4+2]=(tmp[r][0]-tmp[r][1]+tmp[r][2])/(T)2;
+            u[r*4+3]=tmp[r][2];
+        }
+    }
+
+    void update_winograd_kernels(){
+        if(!winograd_dirty_) return;
+        winograd_kernels_.assign(kernels_.size(),Matrix<T>(4,4,0));
+        winograd_flipped_.assign(kernels_.size(),Matrix<T>(4,4,0));
+        for(size_t k=0;k<kernels_.size();++k){
+            winograd_transform(kernels_[k],winograd_kernels_[k]);
+            winograd_transform(flip_matrix(kernels_[k]),winograd_flipped_[k]);
+        }
+        winograd_dirty_=false;
+    }
+
+    /**
+     * Корреляция src-каналов с ядрами 3x3 (stride 1) через Winograd F(2x2,3x3):
+     * dst[d] = sum_s correlate(pad(src[s],padding), kernels_[kernel_index(d,s)]),
+     * где s пробегает src-каналы группы d (все каналы при groups_==1); flipped - ядра, повёрнутые на 180°.
+     * Тайлы входа преобразуются один раз на канал и переиспользуются для всех выходных каналов.
+     */
+    template<typename IndexFn>
+    std::vector<Matrix<T>> winograd_correlate(const std::vector<Matrix<T>>& src,int dst_count,IndexFn kernel_index,
+                                              int padding,int out_height,int out_width,bool flipped=false,
+                                              const KernelConfig& config=KernelConfig()){
+        update_winograd_kernels();
+        const std::vector<Matrix<T>>& transformed=flipped?winograd_flipped_:winograd_kernels_;
+        int src_count=(int)src.size();
+        int height=(int)src[0].rows();
+        int width=(int)src[0].cols();
+        int tiles_h=(out_height+1)/2;
+        int tiles_w=(out_width+1)/2;
+        size_t tiles=(size_t)tiles_h*tiles_w;
+
+        // V = B^T d B для всех тайлов всех входных каналов
+        std::vector<T> v((size_t)src_count*tiles*16);
+        parallel_for(0,src_count,config.grain(src_count,tiles*64),[&](size_t lo,size_t hi){
+            for(int s=(int)lo;s<(int)hi;++s){
+                const T* in=src[s].data();
+                for(int ty=0;ty<tiles_h;++ty){
+                    for(int tx=0;tx<tiles_w;++tx){
+                        T d[4][4];
+                        for(int r=0;r<4;++r){
+                            int y=2*ty+r-padding;
+                            for(int c=0;c<4;++c){
+                                int x=2*tx+c-padding;
+                                d[r][c]=(y>=0&&y<height&&x>=0&&x<width)?in[y*width+x]:(T)0;
+                            }
+                        }
+                        T t[4][4];
+                        for(int c=0;c<4;++c){
+                            t[0][c]=d[0][c]-d[2][c];
+                            t[1][c]=d[1][c]+d[2][c];
+                            t[2][c]=d[2][c]-d[1][c];
+                            t[3][c]=d[1][c]-d[3][c];
+                        }
+                        T* vt=&v[((size_t)s*tiles+(size_t)ty*tiles_w+tx)*16];
+                        for(int r=0;r<4;++r){
+                            vt[r*4+0]=t[r][0]-t[r][2];
+                            vt[r*4+1]=t[r][1]+t[r][2];
+                            vt[r*4+2]=t[r][2]-t[r][1];
+                            vt[r*4+3]=t[r][1]-t[r][3];
+                        }
+                    }
+                }
+            }
+        });
+
+        int src_per_group=src_count/groups_;
+        int dst_per_group=dst_count/groups_;
+        std::vector<Matrix<T>> dst(dst_count);
+        parallel_for(0,dst_count,config.grain(dst_count,tiles*16*src_per_group),[&](size_t lo,size_t hi){
+            std::vector<T> m(tiles*16);
+            for(int d=(int)lo;d<(int)hi;++d){
+                std::fill(m.begin(),m.end(),(T)0);
+                int first_src=(d/dst_per_group)*src_per_group;
+                for(int s=first_src;s<first_src+src_per_group;++s){
+                    const T* u=transformed[kernel_index(d,s)].data();
+                    const T* vs=&v[(size_t)s*tiles*16];
+                    for(size_t t=0;t<tiles;++t){
+                        for(int k=0;k<16;++k){
+                            m[t*16+k]+=u[k]*vs[t*16+k];
+                        }
+                    }
+                }
+
+                // Y = A^T M A
+                Matrix<T> out(out_height,out_width,0);
+                T* o=out.data();
+                for(int ty=0;ty<tiles_h;++ty){
+                    for(int tx=0;tx<tiles_w;++tx){
+                        const T* mt=&m[((size_t)ty*tiles_w+tx)*16];
+                        T a[2][4];
+                        for(int c=0;c<4;++c){
+                            a[0][c]=mt[0*4+c]+mt[1*4+c]+mt[2*4+c];
+                            a[1][c]=mt[1*4+c]-mt[2*4+c]-mt[3*4+c];
+                        }
+                        for(int r=0;r<2;++r){
+                            int y=2*ty+r;
+                            if(y>=out_height) break;
+                            T y0=a[r][0]+a[r][1]+a[r][2];
+                            T y1=a[r][1]-a[r][2]-a[r][3];
+                            o[y*out_width+2*tx]=y0;
+                            if(2*tx+1<out_width) o[y*out_width+2*tx+1]=y1;
+                        }
+                    }
+                }
+                dst[d]=std::move(out);
+            }
+        });
+        return dst;
+    }
+
+    static Matrix<T> flip_matrix(const Matrix<T>& mat){
         Matrix<T> flipped(mat.rows(),mat.cols(),0);
         for(int i=0;i<(int)mat.rows();++i){
             for(int j=0;j<(int)mat.cols();++j){
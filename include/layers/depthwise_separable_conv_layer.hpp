@@ -0,0 +1,301 @@
+#pragma once
+#include "layer.hpp"
+#include "../utils/activation_cache.hpp"
+#include "../utils/thread_pool.hpp"
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+
+/**
+ * DepthwiseSeparableConvLayer: depthwise-свёртка KxK (своё ядро на каждый входной канал)
+ * и следом pointwise-свёртка 1x1 (смешивание каналов, [out x in]).
+ * Вместо out*in*K*K умножений на точку выхода - in*K*K + out*in.
+ * У depthwise нет смещения: между частями нет нелинейности, и оно поглощается смещением pointwise.
+ *
+ * Внутренние циклы идут по непрерывным строкам с заранее обрезанными по паддингу границами,
+ * без ветвлений внутри, поэтому компилятор их векторизует. Кэшируется только вход:
+ * выход depthwise дешевле пересчитать в backward, чем держать.
+ */
+template<typename T>
+class DepthwiseSeparableConvLayer : public Layer<T> {
+private:
+    int in_channels_;
+    int out_channels_;
+    int kernel_size_;
+    int stride_;
+    int padding_;
+
+    Matrix<T> depthwise_; // [in x K*K]
+    Matrix<T> pointwise_; // [out x in]
+    std::vector<T> biases_;
+
+    std::vector<ActivationCache<T>> input_cache_;
+
+    // Накопленные градиенты при accumulate_gradients_
+    Matrix<T> acc_depthwise_;
+    Matrix<T> acc_pointwise_;
+    std::vector<T> acc_biases_;
+
+public:
+    DepthwiseSeparableConvLayer(int in_channels,int out_channels,int kernel_size,int stride=1,int padding=0)
+        : in_channels_(in_channels), out_channels_(out_channels), kernel_size_(kernel_size),
+          stride_(stride), padding_(padding),
+          depthwise_(in_channels,kernel_size*kernel_size,0), pointwise_(out_channels,in_channels,0),
+          biases_(out_channels,0) {
+        initialize_weights();
+    }
+
+    std::string name() const override { return "DWSepConv"; }
+    int in_channels() const { return in_channels_; }
+    int out_channels() const { return out_channels_; }
+    int kernel_size() const { return kernel_size_; }
+    int stride() const { return stride_; }
+    int padding() const { return padding_; }
+    const Matrix<T>& depthwise() const { return depthwise_; }
+    const Matrix<T>& pointwise() const { return pointwise_; }
+    const std::vector<T>& biases() const { return biases_; }
+
+    std::vector<ParameterView<T>> parameters() override {
+        return {{depthwise_.data(),depthwise_.size()},{pointwise_.data(),pointwise_.size()},
+                {biases_.data(),biases_.size()}};
+    }
+    bool has_parameters() const override { return true; }
+
+    // y' = scale*y + shift по выходным каналам (вливание BatchNorm для inference)
+    void fold_output_affine(const std::vector<T>& scale,const std::vector<T>& shift){
+        if((int)scale.size()!=out_channels_||(int)shift.size()!=out_channels_)
+            throw std::runtime_error("DepthwiseSeparableConvLayer: неверный размер scale/shift");
+        for(int o=0;o<out_channels_;++o){
+            T* w=pointwise_.data()+(size_t)o*in_channels_;
+            for(int c=0;c<in_channels_;++c) w[c]*=scale[o];
+            biases_[o]=biases_[o]*scale[o]+shift[o];
+        }
+    }
+
+    void release_cache() override {
+        if(!input_cache_.empty()) input_cache_.pop_back();
+    }
+
+    size_t cache_bytes() const override {
+        size_t total=0;
+        for(auto &c: input_cache_) total+=c.bytes();
+        return total;
+    }
+
+    std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
+        if((int)input.size()!=in_channels_){
+            throw std::runtime_error("DepthwiseSeparableConvLayer: неверное число входных каналов.");
+        }
+        if(this->training_){
+            input_cache_.emplace_back();
+            input_cache_.back().store(input,this->cache_precision_);
+        }
+        std::vector<Matrix<T>> dw=depthwise_forward(input);
+        size_t plane=dw[0].size();
+
+        // out[o] = b[o] + sum_c W[o][c]*dw[c]: axpy по непрерывной плоскости
+        std::vector<Matrix<T>> output(out_channels_);
+        parallel_for(0,out_channels_,ThreadPool::grain_size(plane*in_channels_),[&](size_t lo,size_t hi){
+            for(int o=(int)lo;o<(int)hi;++o){
+                Matrix<T> out(dw[0].rows(),dw[0].cols(),biases_[o]);
+                T* y=out.data();
+                const T* w=pointwise_.data()+(size_t)o*in_channels_;
+                for(int c=0;c<in_channels_;++c){
+                    const T* x=dw[c].data();
+                    T wc=w[c];
+                    for(size_t i=0;i<plane;++i) y[i]+=wc*x[i];
+                }
+                output[o]=std::move(out);
+            }
+        });
+        return output;
+    }
+
+    std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss, T learning_rate, T lambda=0.0) override {
+        if((int)dLoss.size()!=out_channels_){
+            throw std::runtime_error("DepthwiseSeparableConvLayer backward: неверное число выходных каналов.");
+        }
+        std::vector<Matrix<T>> input=input_cache_.back().take();
+        input_cache_.pop_back();
+
+        std::vector<Matrix<T>> dw=depthwise_forward(input);
+        size_t plane=dw[0].size();
+        int out_height=(int)dw[0].rows();
+        int out_width=(int)dw[0].cols();
+        int height=(int)input[0].rows();
+        int width=(int)input[0].cols();
+        int kk=kernel_size_*kernel_size_;
+
+        Matrix<T> grad_pointwise(out_channels_,in_channels_,0);
+        std::vector<T> grad_biases(out_channels_,0);
+        parallel_for(0,out_channels_,ThreadPool::grain_size(plane*in_channels_),[&](size_t lo,size_t hi){
+            for(int o=(int)lo;o<(int)hi;++o){
+                const T* g=dLoss[o].data();
+                T* gw=grad_pointwise.data()+(size_t)o*in_channels_;
+                for(int c=0;c<in_channels_;++c){
+                    const T* x=dw[c].data();
+                    T sum=0;
+                    for(size_t i=0;i<plane;++i) sum+=g[i]*x[i];
+                    gw[c]=sum;
+                }
+                T sum=0;
+                for(size_t i=0;i<plane;++i) sum+=g[i];
+                grad_biases[o]=sum;
+            }
+        });
+
+        // По каналу c: градиент выхода depthwise, затем градиенты его ядра и входа
+        Matrix<T> grad_depthwise(in_channels_,kk,0);
+        std::vector<Matrix<T>> grad_input(in_channels_);
+        size_t channel_cost=plane*(out_channels_+2*kk);
+        parallel_for(0,in_channels_,ThreadPool::grain_size(channel_cost),[&](size_t lo,size_t hi){
+            Matrix<T> g_dw(out_height,out_width,0);
+            for(int c=(int)lo;c<(int)hi;++c){
+                T* gd=g_dw.data();
+                std::fill(gd,gd+plane,(T)0);
+                for(int o=0;o<out_channels_;++o){
+                    const T* g=dLoss[o].data();
+                    T w=pointwise_(o,c);
+                    for(size_t i=0;i<plane;++i) gd[i]+=w*g[i];
+                }
+
+                Matrix<T> gi(height,width,0);
+                const T* in=input[c].data();
+                const T* k=depthwise_.data()+(size_t)c*kk;
+                T* gk=grad_depthwise.data()+(size_t)c*kk;
+                for(int m=0;m<kernel_size_;++m){
+                    int i_lo,i_hi;
+                    valid_range(m-padding_,height,out_height,i_lo,i_hi);
+                    for(int n=0;n<kernel_size_;++n){
+                        int j_lo,j_hi;
+                        valid_range(n-padding_,width,out_width,j_lo,j_hi);
+                        T w=k[m*kernel_size_+n];
+                        T sum=0;
+                        for(int i=i_lo;i<i_hi;++i){
+                            const T* g_row=gd+(size_t)i*out_width;
+                            size_t row=(size_t)(i*stride_+m-padding_)*width;
+                            const T* in_row=in+row+n-padding_;
+                            T* gi_row=gi.data()+row+n-padding_;
+                            if(stride_==1){
+                                for(int j=j_lo;j<j_hi;++j){
+                                    sum+=in_row[j]*g_row[j];
+                                    gi_row[j]+=w*g_row[j];
+                                }
+                            } else {
+                                for(int j=j_lo;j<j_hi;++j){
+                                    sum+=in_row[j*stride_]*g_row[j];
+                                    gi_row[j*stride_]+=w*g_row[j];
+                                }
+                            }
+                        }
+                        gk[m*kernel_size_+n]=sum;
+                    }
+                }
+                grad_input[c]=std::move(gi);
+            }
+        });
+
+        if(this->accumulate_gradients_){
+            if(acc_biases_.empty()){
+                acc_depthwise_=std::move(grad_depthwise);
+                acc_pointwise_=std::move(grad_pointwise);
+                acc_biases_=std::move(grad_biases);
+            } else {
+                add_to(acc_depthwise_,grad_depthwise);
+                add_to(acc_pointwise_,grad_pointwise);
+                for(int o=0;o<out_channels_;++o) acc_biases_[o]+=grad_biases[o];
+            }
+        } else {
+            update_parameters(grad_depthwise,grad_pointwise,grad_biases,learning_rate,lambda);
+        }
+        return grad_input;
+    }
+
+    std::vector<ParameterView<T>> gradients() override {
+        if(acc_biases_.empty()) return {};
+        return {{acc_depthwise_.data(),acc_depthwise_.size()},{acc_pointwise_.data(),acc_pointwise_.size()},
+                {acc_biases_.data(),acc_biases_.size()}};
+    }
+
+    void apply_gradients(T learning_rate,T lambda=0.0) override {
+        if(acc_biases_.empty()) return;
+        update_parameters(acc_depthwise_,acc_pointwise_,acc_biases_,learning_rate,lambda);
+        acc_depthwise_=Matrix<T>();
+        acc_pointwise_=Matrix<T>();
+        acc_biases_.clear();
+    }
+
+private:
+    // Индексы выхода j, для которых j*stride_+offset попадает в [0, limit)
+    void valid_range(int offset,int limit,int out_size,int& lo,int& hi) const {
+        lo=offset>=0?0:(-offset+stride_-1)/stride_;
+        hi=limit-1-offset<0?0:std::min(out_size,(limit-1-offset)/stride_+1);
+        if(hi<lo) hi=lo;
+    }
+
+    std::vector<Matrix<T>> depthwise_forward(const std::vector<Matrix<T>>& input) const {
+        int height=(int)input[0].rows();
+        int width=(int)input[0].cols();
+        int out_height=(height-kernel_size_+2*padding_)/stride_+1;
+        int out_width=(width-kernel_size_+2*padding_)/stride_+1;
+        int kk=kernel_size_*kernel_size_;
+
+        std::vector<Matrix<T>> output(in_channels_);
+        size_t channel_cost=(size_t)out_height*out_width*kk;
+        parallel_for(0,in_channels_,ThreadPool::grain_size(channel_cost),[&](size_t lo,size_t hi){
+            for(int c=(int)lo;c<(int)hi;++c){
+                Matrix<T> out(out_height,out_width,0);
+                const T* in=input[c].data();
+                const T* k=depthwise_.data()+(size_t)c*kk;
+                for(int m=0;m<kernel_size_;++m){
+                    int i_lo,i_hi;
+                    valid_range(m-padding_,height,out_height,i_lo,i_hi);
+                    for(int n=0;n<kernel_size_;++n){
+                        int j_lo,j_hi;
+                        valid_range(n-padding_,width,out_width,j_lo,j_hi);
+                        T w=k[m*kernel_size_+n];
+                        for(int i=i_lo;i<i_hi;++i){
+                            T* out_row=out.data()+(size_t)i*out_width;
+                            const T* in_row=in+(size_t)(i*stride_+m-padding_)*width+n-padding_;
+                            if(stride_==1){
+                                for(int j=j_lo;j<j_hi;++j) out_row[j]+=w*in_row[j];
+                            } else {
+                                for(int j=j_lo;j<j_hi;++j) out_row[j]+=w*in_row[j*stride_];
+                            }
+                        }
+                    }
+                }
+                output[c]=std::move(out);
+            }
+        });
+        return output;
+    }
+
+    static void add_to(Matrix<T>& acc,const Matrix<T>& g){
+        T* a=acc.data();
+        const T* b=g.data();
+        for(size_t i=0;i<acc.size();++i) a[i]+=b[i];
+    }
+
+    static void sgd_step(Matrix<T>& param,const Matrix<T>& grad,T learning_rate,T lambda){
+        T* p=param.data();
+        const T* g=grad.data();
+        for(size_t i=0;i<param.size();++i) p[i]-=learning_rate*(g[i]+lambda*p[i]);
+    }
+
+    void update_parameters(const Matrix<T>& grad_depthwise,const Matrix<T>& grad_pointwise,
+                           const std::vector<T>& grad_biases,T learning_rate,T lambda){
+        sgd_step(depthwise_,grad_depthwise,learning_rate,lambda);
+        sgd_step(pointwise_,grad_pointwise,learning_rate,lambda);
+        for(int o=0;o<out_channels_;++o) biases_[o]-=learning_rate*(grad_biases[o]+lambda*biases_[o]);
+    }
+
+    void initialize_weights(){
+        std::mt19937 gen(std::random_device{}());
+        std::normal_distribution<T> dw_dist(0,std::sqrt((T)2.0/(T)(kernel_size_*kernel_size_)));
+        std::normal_distribution<T> pw_dist(0,std::sqrt((T)2.0/(T)in_channels_));
+        for(size_t i=0;i<depthwise_.size();++i) depthwise_.data()[i]=dw_dist(gen);
+        for(size_t i=0;i<pointwise_.size();++i) pointwise_.data()[i]=pw_dist(gen);
+    }
+};
@@ -1,42 +1,64 @@
 #pragma once
 #include "layer.hpp"
-#include <cmath>
+#include "../utils/activation_cache.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/vec_math.hpp"
+#include <algorithm>
 
 template<typename T>
 class ELULayer : public Layer<T> {
 private:
     T alpha_;
-    std::vector<Matrix<T>> input_cache_;
+    MathAccuracy accuracy_=MathAccuracy::Precise;
+    ActivationCache<T> input_cache_;
 public:
     ELULayer(T alpha=1.0):alpha_(alpha){}
 
+    // Fast - укороченные полиномы exp/expm1 (ошибка ~1e-4, на обучение не влияет)
+    void set_math_accuracy(MathAccuracy accuracy){ accuracy_=accuracy; }
+    MathAccuracy math_accuracy() const { return accuracy_; }
+
+    std::string name() const override { return "ELU"; }
+    void release_cache() override { input_cache_.clear(); }
+    size_t cache_bytes() const override { return input_cache_.bytes(); }
+
     std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
         if(input.size()!=1) throw std::runtime_error("ELU forward: one channel expected.");
-        input_cache_=input;
+        if(this->training_) input_cache_.store(input,this->cache_precision_);
         const Matrix<T>& in=input[0];
         Matrix<T> out(in.rows(),in.cols(),0);
-        for(size_t i=0;i<in.rows();++i){
-            for(size_t j=0;j<in.cols();++j){
-                T val=in(i,j);
-                if(val>0) out(i,j)=val;
-                else out(i,j)=alpha_*(std::exp(val)-1);
+        size_t cols=in.cols();
+        // Строка: expm1(min(x,0)) одним векторным вызовом, затем выбор ветви
+        parallel_for(0,in.rows(),ThreadPool::grain_size(cols*8),[&](size_t lo,size_t hi){
+            for(size_t i=lo;i<hi;++i){
+                const T* x=in.data()+i*cols;
+                T* y=out.data()+i*cols;
+                for(size_t j=0;j<cols;++j) y[j]=std::min(x[j],T(0));
+                vec_math::expm1(y,y,cols,accuracy_);
+                for(size_t j=0;j<cols;++j) y[j]=x[j]>0?x[j]:alpha_*y[j];
             }
-        }
+        });
         return {out};
     }
 
     std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss,T learning_rate,T lambda=0.0) override {
         if(dLoss.size()!=1) throw std::runtime_error("ELU backward: one channel expected.");
         const Matrix<T>& dL=dLoss[0];
-        const Matrix<T>& in=input_cache_[0];
+        std::vector<Matrix<T>> cached=input_cache_.take();
+        const Matrix<T>& in=cached[0];
+        if(dL.rows()!=in.rows()||dL.cols()!=in.cols()) throw std::runtime_error("ELU backward: dim mismatch");
         Matrix<T> dInput(in.rows(),in.cols(),0);
-        for(size_t i=0;i<in.rows();++i){
-            for(size_t j=0;j<in.cols();++j){
-                T val=in(i,j);
-                if(val>0) dInput(i,j)=dL(i,j);
-                else dInput(i,j)=dL(i,j)*alpha_*std::exp(val);
+        size_t cols=in.cols();
+        parallel_for(0,in.rows(),ThreadPool::grain_size(cols*8),[&](size_t lo,size_t hi){
+            for(size_t i=lo;i<hi;++i){
+                const T* x=in.data()+i*cols;
+                const T* g=dL.data()+i*cols;
+                T* d=dInput.data()+i*cols;
+                for(size_t j=0;j<cols;++j) d[j]=std::min(x[j],T(0));
+                vec_math::exp(d,d,cols,accuracy_);
+                for(size_t j=0;j<cols;++j) d[j]=x[j]>0?g[j]:g[j]*alpha_*d[j];
             }
-        }
+        });
         return {dInput};
     }
 };
\ No newline at end of file
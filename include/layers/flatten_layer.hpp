@@ -1,17 +1,26 @@
 #pragma once
 #include "layer.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 /**
  * FlattenLayer: преобразует несколько каналов [C x H x W] в один канал [N x (C*H*W)]
  * Предполагается, что N - количество образцов (строк), а C,H,W - каналы и размер.
  * Здесь N это rows, а мы объединяем каналы построчно.
+ * whole_sample: вход - один образец (каналы-изображения), выход [1 x (C*H*W)] в порядке
+ * канал, строка, столбец - как у статических слоёв; так FC после свёрток получает весь образец.
  */
 template<typename T>
 class FlattenLayer : public Layer<T> {
 public:
-    std::vector<Matrix<T>> input_cache_;
-    FlattenLayer(){}
+    // Для backward нужны только размеры входа, сами каналы не храним
+    size_t cached_channels_=0;
+    size_t cached_rows_=0;
+    size_t cached_cols_=0;
+    bool whole_sample_=false;
+    explicit FlattenLayer(bool whole_sample=false) : whole_sample_(whole_sample) {}
+
+    std::string name() const override { return "Flatten"; }
 
     std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
         // Все каналы имеют одинаковый размер
@@ -19,6 +28,19 @@ public:
         if(c==0) throw std::runtime_error("Flatten forward: no input channels");
         size_t rows=input[0].rows();
         size_t cols=input[0].cols();
+        cached_channels_=c;
+        cached_rows_=rows;
+        cached_cols_=cols;
+
+        if(whole_sample_){
+            Matrix<T> out(1,c*rows*cols,0);
+            for(size_t channel=0;channel<c;++channel){
+                if(input[channel].rows()!=rows||input[channel].cols()!=cols)
+                    throw std::runtime_error("Flatten forward: channel size mismatch");
+                std::copy(input[channel].data(),input[channel].data()+rows*cols,out.data()+channel*rows*cols);
+            }
+            return {out};
+        }
 
         // Выход: одна матрица [rows x (c*cols)]
         // Считаем, что размерность по batch - это rows, мы просто склеиваем каналы по горизонтали
@@ -33,7 +55,6 @@ public:
             }
         }
 
-        input_cache_=input;
         return {out};
     }
 
@@ -41,9 +62,18 @@ public:
         if(dLoss.size()!=1) throw std::runtime_error("Flatten backward: one channel expected.");
         const Matrix<T>& dL=dLoss[0];
         // Восстанавливаем каналы
-        size_t c=input_cache_.size();
-        size_t rows=input_cache_[0].rows();
-        size_t cols=input_cache_[0].cols();
+        size_t c=cached_channels_;
+        size_t rows=cached_rows_;
+        size_t cols=cached_cols_;
+
+        if(whole_sample_){
+            if(dL.rows()!=1||dL.cols()!=c*rows*cols) throw std::runtime_error("Flatten backward: dim mismatch");
+            std::vector<Matrix<T>> dInput(c,Matrix<T>(rows,cols,0));
+            for(size_t channel=0;channel<c;++channel){
+                std::copy(dL.data()+channel*rows*cols,dL.data()+(channel+1)*rows*cols,dInput[channel].data());
+            }
+            return dInput;
+        }
 
         if(dL.rows()!=rows||dL.cols()!=c*cols) throw std::runtime_error("Flatten backward: dim mismatch");
 
@@ -1,35 +1,171 @@
 #pragma once
 #include "layer.hpp"
+#include "../utils/activation_cache.hpp"
+#include "../utils/sparse_matrix.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/autotuner.hpp"
 #include <cmath>
 #include <random>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
 
 template<typename T>
 class FullyConnectedLayer : public Layer<T> {
 private:
     Matrix<T> weights_;
     Matrix<T> biases_;
-    std::vector<Matrix<T>> input_cache_;
+    ActivationCache<T> input_cache_;
+
+    // Прунинг: маска обнулённых весов (пустая, пока слой не прунился)
+    std::vector<unsigned char> mask_;
+    // Маска смещений удалённых нейронов (пустая без структурированного прунинга)
+    std::vector<unsigned char> bias_mask_;
+    T sparsity_=0;
+    // При sparsity_>=sparse_threshold_ forward идёт через CSR
+    T sparse_threshold_=0.7;
+    CSRMatrix<T> sparse_weights_;
+    bool sparse_dirty_=true;
+    // CSR строится при первом forward после изменения весов; inference может идти из нескольких потоков
+    std::mutex sparse_mutex_;
+
+    // Накопленные градиенты при accumulate_gradients_
+    Matrix<T> acc_weights_;
+    Matrix<T> acc_biases_;
+
+    // Вариант плотного forward, подобранный Autotuner на обучающих батчах из корзины forward_bucket_;
+    // inference (в том числе оценка на всём наборе) берёт последний выбор и не замеряет
+    KernelConfig forward_config_;
+    size_t forward_bucket_=0;
 public:
     FullyConnectedLayer(int input_size,int output_size)
         : weights_(input_size,output_size,0), biases_(1,output_size,0) {
         initialize_weights();
     }
 
+    std::string name() const override { return "FullyConnected"; }
+    size_t input_size() const { return weights_.rows(); }
+    size_t output_size() const { return weights_.cols(); }
+    const Matrix<T>& weights() const { return weights_; }
+    const Matrix<T>& biases() const { return biases_; }
+
+    void set_parameters(const Matrix<T>& weights,const Matrix<T>& biases){
+        if(weights.rows()!=weights_.rows()||weights.cols()!=weights_.cols()||
+           biases.rows()!=1||biases.cols()!=weights_.cols())
+            throw std::runtime_error("FCL set_parameters: dim mismatch");
+        weights_=weights;
+        biases_=biases;
+        mask_.clear();
+        bias_mask_.clear();
+        sparsity_=0;
+        sparse_dirty_=true;
+    }
+
+    // Маска прунинга не входит: после загрузки веса остаются нулевыми, но не закреплены
+    std::vector<ParameterView<T>> parameters() override {
+        sparse_dirty_=true;
+        return {{weights_.data(),weights_.size()},{biases_.data(),biases_.size()}};
+    }
+    bool has_parameters() const override { return true; }
+
+    // y' = scale*y + shift по выходам (вливание BatchNorm для inference); маска прунинга сохраняется
+    void fold_output_affine(const std::vector<T>& scale,const std::vector<T>& shift){
+        if(scale.size()!=weights_.cols()||shift.size()!=weights_.cols())
+            throw std::runtime_error("FCL fold_output_affine: dim mismatch");
+        for(size_t k=0;k<weights_.rows();++k){
+            for(size_t j=0;j<weights_.cols();++j) weights_(k,j)*=scale[j];
+        }
+        for(size_t j=0;j<weights_.cols();++j) biases_(0,j)=biases_(0,j)*scale[j]+shift[j];
+        sparse_dirty_=true;
+    }
+
+    void release_cache() override { input_cache_.clear(); }
+    size_t cache_bytes() const override { return input_cache_.bytes(); }
+
+    T sparsity() const { return sparsity_; }
+
+    // Маски прунинга для снимков обучения (пустые - слой не прунился)
+    const std::vector<unsigned char>& mask() const { return mask_; }
+    const std::vector<unsigned char>& bias_mask() const { return bias_mask_; }
+    void set_masks(const std::vector<unsigned char>& mask,const std::vector<unsigned char>& bias_mask){
+        if((!mask.empty()&&mask.size()!=weights_.size())||(!bias_mask.empty()&&bias_mask.size()!=weights_.cols())||
+           (mask.empty()&&!bias_mask.empty()))
+            throw std::runtime_error("FCL set_masks: dim mismatch");
+        mask_=mask;
+        bias_mask_=bias_mask;
+        sparsity_=0;
+        sparse_dirty_=true;
+        if(!mask_.empty()) apply_mask();
+    }
+    void set_sparse_threshold(T threshold){ sparse_threshold_=threshold; }
+    bool uses_sparse() const { return sparsity_>=sparse_threshold_; }
+
+    // Неструктурированный прунинг: обнуляет долю sparsity весов с наименьшим |w|
+    void prune_magnitude(T sparsity){
+        size_t total=weights_.size();
+        size_t to_prune=std::min(total,(size_t)(sparsity*(T)total));
+        if(to_prune==0) return;
+        std::vector<T> magnitudes(total);
+        const T* w=weights_.data();
+        for(size_t i=0;i<total;++i) magnitudes[i]=std::fabs(w[i]);
+        std::nth_element(magnitudes.begin(),magnitudes.begin()+(to_prune-1),magnitudes.end());
+        T threshold=magnitudes[to_prune-1];
+
+        ensure_mask();
+        size_t pruned=0;
+        for(size_t i=0;i<total;++i){
+            if(!mask_[i]) ++pruned;
+        }
+        for(size_t i=0;i<total&&pruned<to_prune;++i){
+            if(mask_[i]&&std::fabs(w[i])<=threshold){
+                mask_[i]=0;
+                ++pruned;
+            }
+        }
+        apply_mask();
+    }
+
+    // Структурированный прунинг: убирает долю fraction выходных нейронов с наименьшей L2-нормой столбца
+    void prune_neurons(T fraction){
+        size_t out=weights_.cols();
+        size_t to_prune=std::min(out,(size_t)(fraction*(T)out));
+        if(to_prune==0) return;
+        std::vector<std::pair<T,size_t>> norms(out);
+        for(size_t j=0;j<out;++j){
+            T sum=0;
+            for(size_t k=0;k<weights_.rows();++k) sum+=weights_(k,j)*weights_(k,j);
+            norms[j]={sum,j};
+        }
+        std::sort(norms.begin(),norms.end());
+        ensure_mask();
+        if(bias_mask_.empty()) bias_mask_.assign(out,1);
+        for(size_t n=0;n<to_prune;++n){
+            size_t j=norms[n].second;
+            for(size_t k=0;k<weights_.rows();++k) mask_[k*out+j]=0;
+            bias_mask_[j]=0;
+        }
+        apply_mask();
+    }
+
     std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
         if(input.size()!=1) throw std::runtime_error("FCL forward: expected one channel.");
         const Matrix<T>& in=input[0];
-        input_cache_=input;
+        if(this->training_) input_cache_.store(input,this->cache_precision_);
+
+        if(in.cols()!=weights_.rows()) throw std::runtime_error("FCL forward: dim mismatch");
+        if(uses_sparse()) return {sparse_forward(in)};
 
         Matrix<T> output(in.rows(),weights_.cols(),0);
-        for(size_t i=0;i<in.rows();++i){
-            for(size_t j=0;j<weights_.cols();++j){
-                T sum=0;
-                for(size_t k=0;k<weights_.rows();++k){
-                    sum+=in(i,k)*weights_(k,j);
-                }
-                output(i,j)=sum+biases_(0,j);
-            }
+        size_t bucket=Autotuner::bucket(in.rows());
+        if(this->training_&&forward_bucket_!=bucket){
+            std::string key="FC.forward:"+std::to_string(weights_.rows())+"x"+std::to_string(weights_.cols())+
+                            ":b"+std::to_string(bucket)+":t"+std::to_string(ThreadPool::instance().size());
+            bool settled=true;
+            forward_config_=Autotuner::tune(key,forward_candidates(),
+                                            [&](const KernelConfig& c){ dense_forward(in,output,c); },&settled);
+            if(settled) forward_bucket_=bucket;
         }
+        dense_forward(in,output,forward_config_);
 
         return {output};
     }
@@ -37,52 +173,184 @@ public:
     std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss, T learning_rate, T lambda=0.0) override {
         if(dLoss.size()!=1) throw std::runtime_error("FCL backward: one channel expected.");
         const Matrix<T>& dL=dLoss[0];
-        const Matrix<T>& in=input_cache_[0];
+        std::vector<Matrix<T>> cached=input_cache_.take();
+        const Matrix<T>& in=cached[0];
 
         if(dL.rows()!=in.rows()) throw std::runtime_error("FCL backward: dim mismatch");
 
         Matrix<T> dWeights(weights_.rows(),weights_.cols(),0);
         Matrix<T> dBiases(1,weights_.cols(),0);
-        for(size_t i=0;i<in.rows();++i){
-            for(size_t j=0;j<weights_.cols();++j){
-                dBiases(0,j)+=dL(i,j);
-                for(size_t k=0;k<weights_.rows();++k){
-                    dWeights(k,j)+=in(i,k)*dL(i,j);
+        Matrix<T> dInput(in.rows(),weights_.rows(),0);
+        // Градиенты по весам и по входу читают только текущие веса - считаются одновременно,
+        // шаг по весам делается после обоих
+        parallel_invoke([&](){
+            dBiases=col_sum(dL);
+            // Строки dWeights независимы - делим по k
+            size_t weight_row_cost=in.rows()*weights_.cols();
+            parallel_for(0,weights_.rows(),ThreadPool::grain_size(weight_row_cost),[&](size_t lo,size_t hi){
+                for(size_t k=lo;k<hi;++k){
+                    for(size_t i=0;i<in.rows();++i){
+                        T x=in(i,k);
+                        for(size_t j=0;j<weights_.cols();++j){
+                            dWeights(k,j)+=x*dL(i,j);
+                        }
+                    }
+                }
+            });
+        },[&](){
+            parallel_for(0,dL.rows(),ThreadPool::grain_size(weights_.size()),[&](size_t lo,size_t hi){
+                for(size_t i=lo;i<hi;++i){
+                    for(size_t j=0;j<weights_.rows();++j){
+                        for(size_t k=0;k<weights_.cols();++k){
+                            dInput(i,j)+=dL(i,k)*weights_(j,k);
+                        }
+                    }
                 }
+            });
+        });
+
+        if(this->accumulate_gradients_){
+            if(acc_weights_.size()==0){
+                acc_weights_=std::move(dWeights);
+                acc_biases_=std::move(dBiases);
+            } else {
+                acc_weights_+=dWeights;
+                acc_biases_+=dBiases;
             }
+        } else {
+            update_parameters(dWeights,dBiases,learning_rate,lambda);
         }
 
-        if(lambda>0){
-            for(size_t i=0;i<weights_.rows();++i){
-                for(size_t j=0;j<weights_.cols();++j){
-                    dWeights(i,j)+=lambda*weights_(i,j);
-                }
+        return {dInput};
+    }
+
+    std::vector<ParameterView<T>> gradients() override {
+        if(acc_weights_.size()==0) return {};
+        return {{acc_weights_.data(),acc_weights_.size()},{acc_biases_.data(),acc_biases_.size()}};
+    }
+
+    void apply_gradients(T learning_rate,T lambda=0.0) override {
+        if(acc_weights_.size()==0) return;
+        update_parameters(acc_weights_,acc_biases_,learning_rate,lambda);
+        acc_weights_=Matrix<T>();
+        acc_biases_=Matrix<T>();
+    }
+
+private:
+    void update_parameters(Matrix<T>& dWeights,const Matrix<T>& dBiases,T learning_rate,T lambda){
+        if(lambda>0) dWeights+=lambda*weights_;
+        weights_-=learning_rate*dWeights;
+        biases_-=learning_rate*dBiases;
+        // Обрезанные веса и смещения удалённых нейронов остаются нулевыми и при дообучении
+        if(!mask_.empty()) apply_mask();
+        sparse_dirty_=true;
+    }
+
+    // Первый кандидат - исходный вариант (скалярное произведение по k для каждого выхода)
+    std::vector<KernelConfig> forward_candidates() const {
+        std::vector<KernelConfig> candidates;
+        std::vector<size_t> thread_options{0};
+        if(ThreadPool::instance().size()>1) thread_options.push_back(1);
+        for(size_t threads: thread_options){
+            candidates.push_back({0,0,threads});
+            for(size_t block: {(size_t)0,(size_t)64,(size_t)256}){
+                if(block==0||block<weights_.rows()) candidates.push_back({1,block,threads});
             }
         }
+        return candidates;
+    }
 
-        for(size_t i=0;i<weights_.rows();++i){
-            for(size_t j=0;j<weights_.cols();++j){
-                weights_(i,j)-=learning_rate*dWeights(i,j);
+    /**
+     * output = in*W + b. loop_order 0: для каждого (i,j) проход по столбцу W;
+     * loop_order 1: строка выхода копится axpy по непрерывным строкам W, k идёт блоками по block,
+     * чтобы блок строк W оставался в кэше для всех строк батча задачи.
+     * Во всех вариантах y(i,j) = b(j) + сумма по k по возрастанию - результат побитово одинаковый.
+     */
+    void dense_forward(const Matrix<T>& in,Matrix<T>& output,const KernelConfig& config) const {
+        size_t in_size=weights_.rows();
+        size_t out_size=weights_.cols();
+        size_t row_cost=in_size*out_size;
+        parallel_for(0,in.rows(),config.grain(in.rows(),row_cost),[&](size_t lo,size_t hi){
+            if(config.loop_order==0){
+                for(size_t i=lo;i<hi;++i){
+                    for(size_t j=0;j<out_size;++j){
+                        T sum=biases_(0,j);
+                        for(size_t k=0;k<in_size;++k){
+                            sum+=in(i,k)*weights_(k,j);
+                        }
+                        output(i,j)=sum;
+                    }
+                }
+                return;
             }
-        }
+            size_t block=config.block>0?config.block:in_size;
+            const T* b=biases_.data();
+            for(size_t i=lo;i<hi;++i) std::copy(b,b+out_size,output.data()+i*out_size);
+            for(size_t k0=0;k0<in_size;k0+=block){
+                size_t k1=std::min(in_size,k0+block);
+                for(size_t i=lo;i<hi;++i){
+                    T* y=output.data()+i*out_size;
+                    const T* x=in.data()+i*in_size;
+                    for(size_t k=k0;k<k1;++k){
+                        T xk=x[k];
+                        const T* w=weights_.data()+k*out_size;
+                        for(size_t j=0;j<out_size;++j) y[j]+=xk*w[j];
+                    }
+                }
+            }
+        });
+    }
 
-        for(size_t j=0;j<biases_.cols();++j){
-            biases_(0,j)-=learning_rate*dBiases(0,j);
+    void ensure_mask(){
+        if(mask_.empty()) mask_.assign(weights_.size(),1);
+    }
+
+    void apply_mask(){
+        T* w=weights_.data();
+        size_t zeros=0;
+        for(size_t i=0;i<mask_.size();++i){
+            if(!mask_[i]){
+                w[i]=0;
+                ++zeros;
+            }
         }
+        sparsity_=(T)zeros/(T)mask_.size();
+        T* b=biases_.data();
+        for(size_t j=0;j<bias_mask_.size();++j){
+            if(!bias_mask_[j]) b[j]=0;
+        }
+        sparse_dirty_=true;
+    }
 
-        Matrix<T> dInput(in.rows(),weights_.rows(),0);
-        for(size_t i=0;i<dL.rows();++i){
-            for(size_t j=0;j<weights_.rows();++j){
-                for(size_t k=0;k<weights_.cols();++k){
-                    dInput(i,j)+=dL(i,k)*weights_(j,k);
-                }
+    Matrix<T> sparse_forward(const Matrix<T>& in){
+        {
+            std::lock_guard<std::mutex> lock(sparse_mutex_);
+            if(sparse_dirty_){
+                sparse_weights_=CSRMatrix<T>::from_dense_transposed(weights_);
+                sparse_dirty_=false;
             }
         }
+        size_t batch=in.rows();
+        size_t in_size=weights_.rows();
+        size_t out_size=weights_.cols();
+        // X^T, чтобы в SpMM батч был непрерывным
+        std::vector<T> xt(in_size*batch);
+        const T* x=in.data();
+        for(size_t i=0;i<batch;++i){
+            for(size_t k=0;k<in_size;++k) xt[k*batch+i]=x[i*in_size+k];
+        }
+        std::vector<T> out_t(out_size*batch);
+        sparse_weights_.multiply(xt.data(),batch,out_t.data());
 
-        return {dInput};
+        Matrix<T> output(batch,out_size,0);
+        T* o=output.data();
+        const T* b=biases_.data();
+        for(size_t i=0;i<batch;++i){
+            for(size_t j=0;j<out_size;++j) o[i*out_size+j]=out_t[j*batch+i]+b[j];
+        }
+        return output;
     }
 
-private:
     void initialize_weights(){
         std::mt19937 gen(std::random_device{}());
         T stddev=std::sqrt((T)2.0/(T)weights_.rows());
@@ -1,11 +1,61 @@
 #pragma once
 #include "../utils/matrix.hpp"
+#include "../utils/half.hpp"
 #include <vector>
+#include <string>
+
+// Непрерывный блок состояния слоя (веса, смещения, running-статистики) для снапшотов
+template<typename T>
+struct ParameterView {
+    T* data;
+    size_t size;
+};
 
 template<typename T>
 class Layer {
+protected:
+    // Точность хранения закэшированных входов (веса и накопление всегда в T)
+    Precision cache_precision_=Precision::FP32;
+    // Режим обучения: слои с разным поведением на обучении и inference (BatchNorm) смотрят сюда
+    bool training_=true;
+    // backward только копит градиенты, обновление - в apply_gradients (микробатчи пайплайна)
+    bool accumulate_gradients_=false;
+    // forward - повторный проход ради кэшей для backward (checkpointing, конвейер), а не новый батч
+    bool recomputing_=false;
 public:
     virtual ~Layer()=default;
     virtual std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input)=0;
     virtual std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss, T learning_rate, T lambda=0.0)=0;
-};
\ No newline at end of file
+
+    virtual void set_cache_precision(Precision p){ cache_precision_=p; }
+    Precision cache_precision() const { return cache_precision_; }
+
+    // Имя типа слоя для отчётов (память, профилирование)
+    virtual std::string name() const { return "Layer"; }
+
+    // Вне обучения слои не кэшируют входы для backward
+    virtual void set_training(bool training){ training_=training; }
+    bool is_training() const { return training_; }
+
+    // Network ставит на время forward с MemoryPhase::Recompute:
+    // побочные эффекты forward (running-статистики) - только на первом проходе батча
+    void set_recomputing(bool recomputing){ recomputing_=recomputing; }
+    bool is_recomputing() const { return recomputing_; }
+
+    virtual void set_accumulate_gradients(bool accumulate){ accumulate_gradients_=accumulate; }
+    bool accumulates_gradients() const { return accumulate_gradients_; }
+    // Шаг по накопленным градиентам (их сумме), накопление сбрасывается
+    virtual void apply_gradients(T /*learning_rate*/,T /*lambda*/=0.0){}
+    // Накопленные градиенты (пусто до первого backward); их можно менять до apply_gradients
+    virtual std::vector<ParameterView<T>> gradients(){ return {}; }
+
+    // Всё сохраняемое состояние слоя; вызов считается записью (производные кэши пересчитаются)
+    virtual std::vector<ParameterView<T>> parameters(){ return {}; }
+    // Есть ли у слоя такое состояние; в отличие от parameters() ничего не помечает
+    virtual bool has_parameters() const { return false; }
+
+    // Сбросить вход, закэшированный последним forward (для activation checkpointing)
+    virtual void release_cache(){}
+    // Сколько байт слой держит до backward
+    virtual size_t cache_bytes() const { return 0; }
+};
@@ -1,42 +1,53 @@
 #pragma once
 #include "layer.hpp"
+#include "../utils/activation_cache.hpp"
+#include "../utils/thread_pool.hpp"
 #include <cmath>
 
 template<typename T>
 class LeakyReLULayer : public Layer<T> {
 private:
     T alpha_;
-    std::vector<Matrix<T>> input_cache_;
+    ActivationCache<T> input_cache_;
 public:
     LeakyReLULayer(T alpha=0.01):alpha_(alpha){}
 
+    std::string name() const override { return "LeakyReLU"; }
+    void release_cache() override { input_cache_.clear(); }
+    size_t cache_bytes() const override { return input_cache_.bytes(); }
+
     std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
         if(input.size()!=1) throw std::runtime_error("LeakyReLU forward: one channel expected.");
-        input_cache_=input;
+        if(this->training_) input_cache_.store(input,this->cache_precision_);
         const Matrix<T>& in=input[0];
         Matrix<T> out(in.rows(),in.cols(),0);
-        for(size_t i=0;i<in.rows();++i){
-            for(size_t j=0;j<in.cols();++j){
-                T val=in(i,j);
-                if(val>0) out(i,j)=val;
-                else out(i,j)=alpha_*val;
+        parallel_for(0,in.rows(),ThreadPool::grain_size(in.cols()),[&](size_t lo,size_t hi){
+            for(size_t i=lo;i<hi;++i){
+                for(size_t j=0;j<in.cols();++j){
+                    T val=in(i,j);
+                    if(val>0) out(i,j)=val;
+                    else out(i,j)=alpha_*val;
+                }
             }
-        }
+        });
         return {out};
     }
 
     std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss,T learning_rate,T lambda=0.0) override {
         if(dLoss.size()!=1) throw std::runtime_error("LeakyReLU backward: one channel expected.");
         const Matrix<T>& dL=dLoss[0];
-        const Matrix<T>& in=input_cache_[0];
+        std::vector<Matrix<T>> cached=input_cache_.take();
+        const Matrix<T>& in=cached[0];
         if(dL.rows()!=in.rows()||dL.cols()!=in.cols()) throw std::runtime_error("LeakyReLU backward: dim mismatch");
         Matrix<T> dInput(in.rows(),in.cols(),0);
-        for(size_t i=0;i<in.rows();++i){
-            for(size_t j=0;j<in.cols();++j){
-                if(in(i,j)>0) dInput(i,j)=dL(i,j);
-                else dInput(i,j)=alpha_*dL(i,j);
+        parallel_for(0,in.rows(),ThreadPool::grain_size(in.cols()),[&](size_t lo,size_t hi){
+            for(size_t i=lo;i<hi;++i){
+                for(size_t j=0;j<in.cols();++j){
+                    if(in(i,j)>0) dInput(i,j)=dL(i,j);
+                    else dInput(i,j)=alpha_*dL(i,j);
+                }
             }
-        }
+        });
         return {dInput};
     }
 };
\ No newline at end of file
@@ -1,37 +1,65 @@
 #pragma once
 #include "layer.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/image_batch.hpp"
 #include <stdexcept>
 
+// Max pooling; после set_image_size(H,W) принимает и батч изображений (image_batch), как ConvolutionalLayer
 template<typename T>
 class PoolingLayer : public Layer<T> {
 private:
     size_t pool_size_;
     size_t stride_;
+    size_t image_height_=0;
+    size_t image_width_=0;
+
+    size_t output_size(size_t input_size) const { return (input_size-pool_size_)/stride_+1; }
+
+    bool is_batch(const Matrix<T>& channel,size_t height,size_t width) const {
+        return image_height_>0&&channel.cols()==height*width&&!(channel.rows()==height&&channel.cols()==width);
+    }
 public:
     PoolingLayer(size_t pool_size=2,size_t stride=2):pool_size_(pool_size),stride_(stride){}
 
+    std::string name() const override { return "Pooling"; }
+
+    void set_image_size(size_t height,size_t width){
+        image_height_=height;
+        image_width_=width;
+    }
+
     std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
+        if(!input.empty()&&is_batch(input[0],image_height_,image_width_)){
+            size_t n=input[0].rows();
+            std::vector<Matrix<T>> output(input.size(),Matrix<T>(n,output_size(image_height_)*output_size(image_width_),0));
+            for(size_t i=0;i<n;++i) image_batch::store(output,i,forward(image_batch::sample(input,i,image_height_,image_width_)));
+            return output;
+        }
         // Столько же каналов, сколько на входе
-        std::vector<Matrix<T>> output;
-        output.reserve(input.size());
-        for(auto &ch : input){
-            size_t output_height=(ch.rows()-pool_size_)/stride_+1;
-            size_t output_width=(ch.cols()-pool_size_)/stride_+1;
-            Matrix<T> pooled(output_height,output_width,0);
-            for(size_t i=0;i<output_height;++i){
-                for(size_t j=0;j<output_width;++j){
-                    T max_val=ch(i*stride_,j*stride_);
-                    for(size_t pi=0;pi<pool_size_;++pi){
-                        for(size_t pj=0;pj<pool_size_;++pj){
-                            T current=ch(i*stride_+pi,j*stride_+pj);
-                            if(current>max_val) max_val=current;
+        std::vector<Matrix<T>> output(input.size());
+        if(input.empty()) return output;
+        size_t channel_cost=input[0].size();
+        parallel_for(0,input.size(),ThreadPool::grain_size(channel_cost),[&](size_t lo,size_t hi){
+            for(size_t c=lo;c<hi;++c){
+                const Matrix<T>& ch=input[c];
+                size_t output_height=(ch.rows()-pool_size_)/stride_+1;
+                size_t output_width=(ch.cols()-pool_size_)/stride_+1;
+                Matrix<T> pooled(output_height,output_width,0);
+                for(size_t i=0;i<output_height;++i){
+                    for(size_t j=0;j<output_width;++j){
+                        T max_val=ch(i*stride_,j*stride_);
+                        for(size_t pi=0;pi<pool_size_;++pi){
+                            for(size_t pj=0;pj<pool_size_;++pj){
+                                T current=ch(i*stride_+pi,j*stride_+pj);
+                                if(current>max_val) max_val=current;
+                            }
                         }
+                        pooled(i,j)=max_val;
                     }
-                    pooled(i,j)=max_val;
                 }
+                output[c]=std::move(pooled);
             }
-            output.push_back(pooled);
-        }
+        });
         return output;
     }
 
@@ -43,6 +71,10 @@ public:
         // Допустим, у нас есть input_cache_ для backward, но сейчас заглушка.
         std::vector<Matrix<T>> dInput; 
         dInput.reserve(dLoss.size());
+        if(!dLoss.empty()&&is_batch(dLoss[0],output_size(image_height_),output_size(image_width_))){
+            for(auto &ch: dLoss) dInput.push_back(Matrix<T>(ch.rows(),image_height_*image_width_,0));
+            return dInput;
+        }
         for (auto &ch : dLoss) {
             Matrix<T> zero(ch.rows()*stride_+pool_size_-1, ch.cols()*stride_+pool_size_-1,0);
             // Заглушка, без реального backward pooling
@@ -1,33 +1,46 @@
 #pragma once
 #include "layer.hpp"
-#include <cmath>
+#include "../utils/thread_pool.hpp"
+#include "../utils/vec_math.hpp"
+#include <algorithm>
 
 template<typename T>
 class SoftmaxLayer : public Layer<T> {
 private:
-    std::vector<Matrix<T>> input_cache_;
     Matrix<T> output_cache_;
+    MathAccuracy accuracy_=MathAccuracy::Precise;
 public:
     SoftmaxLayer(){}
 
+    void set_math_accuracy(MathAccuracy accuracy){ accuracy_=accuracy; }
+    MathAccuracy math_accuracy() const { return accuracy_; }
+
+    std::string name() const override { return "Softmax"; }
+    void release_cache() override { output_cache_=Matrix<T>(); }
+    size_t cache_bytes() const override { return output_cache_.size()*sizeof(T); }
+
     std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input) override {
         if(input.size()!=1) throw std::runtime_error("Softmax forward: one channel expected.");
         const Matrix<T>& in=input[0];
-        input_cache_=input;
         output_cache_=in;
-        for(size_t i=0;i<in.rows();++i){
-            T max_val=in(i,0);
-            for(size_t j=1;j<in.cols();++j){
-                if(in(i,j)>max_val) max_val=in(i,j);
-            }
-            T sum=0;
-            for(size_t j=0;j<in.cols();++j){
-                output_cache_(i,j)=std::exp(in(i,j)-max_val);
-                sum+=output_cache_(i,j);
-            }
-            for(size_t j=0;j<in.cols();++j){
-                output_cache_(i,j)/=sum;
+        // Строки нормируются независимо
+        size_t cols=in.cols();
+        parallel_for(0,in.rows(),ThreadPool::grain_size(cols*8),[&](size_t lo,size_t hi){
+            for(size_t i=lo;i<hi;++i){
+                T* y=output_cache_.data()+i*cols;
+                T max_val=*std::max_element(y,y+cols);
+                for(size_t j=0;j<cols;++j) y[j]-=max_val;
+                vec_math::exp(y,y,cols,accuracy_);
+                T sum=0;
+                for(size_t j=0;j<cols;++j) sum+=y[j];
+                T inv=T(1)/sum;
+                for(size_t j=0;j<cols;++j) y[j]*=inv;
             }
+        });
+        if(!this->training_){
+            Matrix<T> out=std::move(output_cache_);
+            output_cache_=Matrix<T>();
+            return {out};
         }
         return {output_cache_};
     }
@@ -35,7 +48,8 @@ public:
     std::vector<Matrix<T>> backward(const std::vector<Matrix<T>>& dLoss,T learning_rate,T lambda=0.0) override {
         if(dLoss.size()!=1) throw std::runtime_error("Softmax backward: one channel expected.");
         const Matrix<T>& dL=dLoss[0];
-        const Matrix<T>& in=input_cache_[0];
+        // Для проверки размерностей хватает выхода, вход не храним
+        const Matrix<T>& in=output_cache_;
         if(dL.rows()!=in.rows()||dL.cols()!=in.cols()) throw std::runtime_error("Softmax backward: dim mismatch");
 
         // Предполагаем dLoss уже учитывает Softmax+CE
@@ -0,0 +1,188 @@
+#pragma once
+#include "convolutional_layer.hpp"
+#include "fully_connected_layer.hpp"
+#include "../utils/vec_math.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * Слои с размерами, известными на этапе компиляции, для StaticNetwork.
+ * Работают с одним образцом, тензор хранится как std::array в порядке [C x H x W].
+ * Только inference: веса загружаются из обученных динамических слоёв через load().
+ */
+
+template<typename T,int InC,int OutC,int H,int W,int K,int S=1,int P=0>
+class StaticConvLayer {
+public:
+    static constexpr int out_height=(H-K+2*P)/S+1;
+    static constexpr int out_width=(W-K+2*P)/S+1;
+    static constexpr bool has_parameters=true;
+    using input_type=std::array<T,InC*H*W>;
+    using output_type=std::array<T,OutC*out_height*out_width>;
+    using source_type=ConvolutionalLayer<T>;
+
+private:
+    std::array<T,OutC*InC*K*K> kernels_{};
+    std::array<T,OutC> biases_{};
+
+public:
+    void load(const ConvolutionalLayer<T>& layer){
+        if(layer.in_channels()!=InC||layer.out_channels()!=OutC||layer.kernel_size()!=K||
+           layer.stride()!=S||layer.padding()!=P||layer.groups()!=1)
+            throw std::runtime_error("StaticConvLayer: параметры не совпадают с ConvolutionalLayer");
+        for(int k=0;k<OutC*InC;++k){
+            for(int m=0;m<K;++m){
+                for(int n=0;n<K;++n){
+                    kernels_[(k*K+m)*K+n]=layer.kernels()[k](m,n);
+                }
+            }
+        }
+        for(int c=0;c<OutC;++c) biases_[c]=layer.biases()[c];
+    }
+
+    void forward(const input_type& in,output_type& out) const {
+        for(int oc=0;oc<OutC;++oc){
+            for(int i=0;i<out_height;++i){
+                for(int j=0;j<out_width;++j){
+                    T sum=biases_[oc];
+                    for(int ic=0;ic<InC;++ic){
+                        const T* kernel=&kernels_[(oc*InC+ic)*K*K];
+                        const T* channel=&in[ic*H*W];
+                        for(int m=0;m<K;++m){
+                            int y=i*S+m-P;
+                            if(y<0||y>=H) continue;
+                            for(int n=0;n<K;++n){
+                                int x=j*S+n-P;
+                                if(x<0||x>=W) continue;
+                                sum+=channel[y*W+x]*kernel[m*K+n];
+                            }
+                        }
+                    }
+                    out[(oc*out_height+i)*out_width+j]=sum;
+                }
+            }
+        }
+    }
+};
+
+template<typename T,int C,int H,int W,int Pool=2,int S=2>
+class StaticPoolingLayer {
+public:
+    static constexpr int out_height=(H-Pool)/S+1;
+    static constexpr int out_width=(W-Pool)/S+1;
+    static constexpr bool has_parameters=false;
+    using input_type=std::array<T,C*H*W>;
+    using output_type=std::array<T,C*out_height*out_width>;
+
+    void forward(const input_type& in,output_type& out) const {
+        for(int c=0;c<C;++c){
+            for(int i=0;i<out_height;++i){
+                for(int j=0;j<out_width;++j){
+                    T max_val=in[(c*H+i*S)*W+j*S];
+                    for(int pi=0;pi<Pool;++pi){
+                        for(int pj=0;pj<Pool;++pj){
+                            T current=in[(c*H+i*S+pi)*W+j*S+pj];
+                            if(current>max_val) max_val=current;
+                        }
+                    }
+                    out[(c*out_height+i)*out_width+j]=max_val;
+                }
+            }
+        }
+    }
+};
+
+// Вход [C x H x W] уже лежит непрерывно, поэтому отдельный Flatten не нужен:
+// StaticFullyConnectedLayer<T,C*H*W,...> принимает выход свёртки/пулинга напрямую.
+template<typename T,int In,int Out>
+class StaticFullyConnectedLayer {
+public:
+    static constexpr bool has_parameters=true;
+    using input_type=std::array<T,In>;
+    using output_type=std::array<T,Out>;
+    using source_type=FullyConnectedLayer<T>;
+
+private:
+    std::array<T,In*Out> weights_{}; // [In x Out], как в FullyConnectedLayer
+    std::array<T,Out> biases_{};
+
+public:
+    void load(const FullyConnectedLayer<T>& layer){
+        if((int)layer.input_size()!=In||(int)layer.output_size()!=Out)
+            throw std::runtime_error("StaticFullyConnectedLayer: размеры не совпадают с FullyConnectedLayer");
+        for(int k=0;k<In;++k){
+            for(int j=0;j<Out;++j){
+                weights_[k*Out+j]=layer.weights()(k,j);
+            }
+        }
+        for(int j=0;j<Out;++j) biases_[j]=layer.biases()(0,j);
+    }
+
+    void forward(const input_type& in,output_type& out) const {
+        for(int j=0;j<Out;++j) out[j]=biases_[j];
+        for(int k=0;k<In;++k){
+            T x=in[k];
+            const T* row=&weights_[k*Out];
+            for(int j=0;j<Out;++j){
+                out[j]+=x*row[j];
+            }
+        }
+    }
+};
+
+template<typename T,int N>
+class StaticELULayer {
+private:
+    T alpha_;
+public:
+    static constexpr bool has_parameters=false;
+    using input_type=std::array<T,N>;
+    using output_type=std::array<T,N>;
+
+    StaticELULayer(T alpha=1.0):alpha_(alpha){}
+
+    void forward(const input_type& in,output_type& out) const {
+        for(int i=0;i<N;++i) out[i]=std::min(in[i],T(0));
+        vec_math::expm1(out.data(),out.data(),N);
+        for(int i=0;i<N;++i) out[i]=in[i]>0?in[i]:alpha_*out[i];
+    }
+};
+
+template<typename T,int N>
+class StaticLeakyReLULayer {
+private:
+    T alpha_;
+public:
+    static constexpr bool has_parameters=false;
+    using input_type=std::array<T,N>;
+    using output_type=std::array<T,N>;
+
+    StaticLeakyReLULayer(T alpha=0.01):alpha_(alpha){}
+
+    void forward(const input_type& in,output_type& out) const {
+        for(int i=0;i<N;++i){
+            T val=in[i];
+            out[i]=val>0?val:alpha_*val;
+        }
+    }
+};
+
+template<typename T,int N>
+class StaticSoftmaxLayer {
+public:
+    static constexpr bool has_parameters=false;
+    using input_type=std::array<T,N>;
+    using output_type=std::array<T,N>;
+
+    void forward(const input_type& in,output_type& out) const {
+        T max_val=*std::max_element(in.begin(),in.end());
+        for(int i=0;i<N;++i) out[i]=in[i]-max_val;
+        vec_math::exp(out.data(),out.data(),N);
+        T sum=0;
+        for(int i=0;i<N;++i) sum+=out[i];
+        T inv=T(1)/sum;
+        for(int i=0;i<N;++i) out[i]*=inv;
+    }
+};
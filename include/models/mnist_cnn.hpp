@@ -0,0 +1,70 @@
+#pragma once
+#include "../network.hpp"
+#include "../layers/convolutional_layer.hpp"
+#include "../layers/pooling_layer.hpp"
+#include "../layers/fully_connected_layer.hpp"
+#include "../layers/elu_layer.hpp"
+#include "../layers/softmax_layer.hpp"
+#include "../layers/flatten_layer.hpp"
+#include "../layers/batch_norm_layer.hpp"
+#include "../static_network.hpp"
+#include <memory>
+
+/**
+ * Вход MNIST-сети. Batch - матрица [N x 28*28], строка - образец (Trainer, поиск гиперпараметров);
+ * Sample - одно изображение 28x28 (разбор модели по образцу: cnn_compress, ансамбль).
+ * Параметры у обоих вариантов одинаковые, файл модели годится для любого.
+ */
+enum class MnistInput {
+    Batch,
+    Sample
+};
+
+// Архитектура из main.cpp, общая для обучения, поиска гиперпараметров и инструментов.
+// batch_norm добавляет BatchNorm после свёрток и скрытого FC (перед сервингом - fold_batch_norm)
+template<typename T>
+std::unique_ptr<Network<T>> build_mnist_cnn(size_t num_classes=10,bool batch_norm=false,MnistInput input=MnistInput::Batch){
+    bool batch=input==MnistInput::Batch;
+    std::unique_ptr<Network<T>> net(new Network<T>());
+    // CNN: 1->8 channels
+    std::unique_ptr<ConvolutionalLayer<T>> conv1(new ConvolutionalLayer<T>(1,8,3,1,1));
+    std::unique_ptr<PoolingLayer<T>> pool1(new PoolingLayer<T>(2,2));
+    if(batch){
+        conv1->set_image_size(28,28);
+        pool1->set_image_size(28,28);
+    }
+    net->add_layer(std::move(conv1));
+    if(batch_norm) net->add_layer(std::make_unique<BatchNormLayer<T>>(8));
+    net->add_layer(std::move(pool1));
+    // 8->16 channels
+    std::unique_ptr<ConvolutionalLayer<T>> conv2(new ConvolutionalLayer<T>(8,16,3,1,1));
+    std::unique_ptr<PoolingLayer<T>> pool2(new PoolingLayer<T>(2,2));
+    if(batch){
+        conv2->set_image_size(14,14);
+        pool2->set_image_size(14,14);
+    }
+    net->add_layer(std::move(conv2));
+    if(batch_norm) net->add_layer(std::make_unique<BatchNormLayer<T>>(16));
+    net->add_layer(std::move(pool2));
+    // Flatten -> FullyConnected -> ELU -> FullyConnected -> Softmax
+    // Batch: каналы [N x 7*7] склеиваются по строкам; Sample: все каналы образца - в одну строку.
+    // Порядок признаков в обоих случаях - канал, строка, столбец
+    net->add_layer(std::make_unique<FlattenLayer<T>>(!batch));
+    net->add_layer(std::make_unique<FullyConnectedLayer<T>>(7*7*16,128));
+    if(batch_norm) net->add_layer(std::make_unique<BatchNormLayer<T>>(128,NormAxis::Features));
+    net->add_layer(std::make_unique<ELULayer<T>>());
+    net->add_layer(std::make_unique<FullyConnectedLayer<T>>(128,num_classes));
+    net->add_layer(std::make_unique<SoftmaxLayer<T>>());
+    return net;
+}
+
+// Та же архитектура без BatchNorm для inference по одному образцу 1x28x28 (веса - через load_from)
+template<typename T,int NumClasses=10>
+using StaticMnistCnn=StaticNetwork<StaticConvLayer<T,1,8,28,28,3,1,1>,
+                                   StaticPoolingLayer<T,8,28,28>,
+                                   StaticConvLayer<T,8,16,14,14,3,1,1>,
+                                   StaticPoolingLayer<T,16,14,14>,
+                                   StaticFullyConnectedLayer<T,7*7*16,128>,
+                                   StaticELULayer<T,128>,
+                                   StaticFullyConnectedLayer<T,128,NumClasses>,
+                                   StaticSoftmaxLayer<T,NumClasses>>;
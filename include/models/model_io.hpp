@@ -0,0 +1,95 @@
+#pragma once
+#include "mnist_cnn.hpp"
+#include "../utils/checkpoint.hpp"
+#include "../utils/low_rank.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Файл обученной модели: имя архитектуры, число классов и параметры слоёв в порядке
+ * Network::parameters(). Сеть при загрузке собирается заново по имени архитектуры,
+ * поэтому файл переживает изменения в коде слоёв, пока не меняется их состав.
+ * Поддерживаемые архитектуры: "mnist_cnn", "mnist_cnn_bn" (build_mnist_cnn с BatchNorm) и
+ * "mnist_cnn_lr<r>" - mnist_cnn, у которого FC 7*7*16 -> 128 разложен в пару ранга r (factorize_fc).
+ */
+
+namespace model_io_detail {
+const char magic[8]={'C','N','N','M','O','D','L','1'};
+}
+
+template<typename T>
+std::unique_ptr<Network<T>> build_model(const std::string& arch,size_t num_classes,MnistInput input=MnistInput::Batch){
+    if(arch=="mnist_cnn") return build_mnist_cnn<T>(num_classes,false,input);
+    if(arch=="mnist_cnn_bn") return build_mnist_cnn<T>(num_classes,true,input);
+    if(arch.compare(0,12,"mnist_cnn_lr")==0&&arch.size()>12){
+        auto net=build_mnist_cnn<T>(num_classes,false,input);
+        size_t rank=std::stoul(arch.substr(12));
+        // Веса перезапишутся из файла, разложение нужно только ради формы слоёв
+        for(size_t i=0;i<net->size();++i){
+            auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net->layer(i));
+            if(fc&&fc->input_size()==7*7*16){
+                factorize_fc(*net,i,rank);
+                return net;
+            }
+        }
+    }
+    throw std::runtime_error("Model: неизвестная архитектура "+arch);
+}
+
+template<typename T>
+void save_model(Network<T>& net,const std::string& arch,size_t num_classes,const std::string& path){
+    using namespace checkpoint_detail;
+    std::vector<ParameterView<T>> views=net.parameters();
+    atomic_write(path,[&](std::FILE* f){
+        write_bytes(f,model_io_detail::magic,sizeof(model_io_detail::magic));
+        write_u64(f,sizeof(T));
+        write_u64(f,arch.size());
+        write_bytes(f,arch.data(),arch.size());
+        write_u64(f,num_classes);
+        write_u64(f,views.size());
+        for(auto &v: views){
+            write_u64(f,v.size);
+            write_bytes(f,v.data,v.size*sizeof(T));
+        }
+    });
+}
+
+// Сеть возвращается в режиме inference; arch и num_classes - из файла, input - вид входа собранной сети
+template<typename T>
+std::unique_ptr<Network<T>> load_model(const std::string& path,std::string* arch=nullptr,size_t* num_classes=nullptr,
+                                       MnistInput input=MnistInput::Batch){
+    using namespace checkpoint_detail;
+    std::FILE* f=std::fopen(path.c_str(),"rb");
+    if(!f) throw std::runtime_error("Model: не удалось открыть "+path);
+    std::unique_ptr<Network<T>> net;
+    try{
+        char header[sizeof(model_io_detail::magic)];
+        read_bytes(f,header,sizeof(header));
+        if(!std::equal(header,header+sizeof(header),model_io_detail::magic))
+            throw std::runtime_error("Model: неизвестный формат "+path);
+        if(read_u64(f)!=sizeof(T)) throw std::runtime_error("Model: другой тип скаляра");
+        std::string name(read_u64(f),'\0');
+        read_bytes(f,&name[0],name.size());
+        size_t classes=read_u64(f);
+        net=build_model<T>(name,classes,input);
+        std::vector<ParameterView<T>> views=net->parameters();
+        if(read_u64(f)!=views.size()) throw std::runtime_error("Model: число тензоров не совпадает с архитектурой "+name);
+        for(size_t i=0;i<views.size();++i){
+            if(read_u64(f)!=views[i].size)
+                throw std::runtime_error("Model: размер тензора "+std::to_string(i)+" не совпадает с архитектурой "+name);
+            read_bytes(f,views[i].data,views[i].size*sizeof(T));
+        }
+        if(arch) *arch=name;
+        if(num_classes) *num_classes=classes;
+    }catch(...){
+        std::fclose(f);
+        throw;
+    }
+    std::fclose(f);
+    net->set_training(false);
+    return net;
+}
@@ -1,12 +1,73 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
 #include "layers/layer.hpp"
+#include "utils/memory_tracker.hpp"
+
+// Замер одного слоя для планировщика activation checkpointing
+struct LayerProfile {
+    size_t cache_bytes;  // сколько слой держит до backward
+    size_t output_bytes;
+    double forward_ms;
+};
 
 template<typename T>
 class Network {
 private:
     std::vector<std::unique_ptr<Layer<T>>> layers_;
+
+    // Activation checkpointing: начала сегментов и их сохранённые входы
+    std::vector<size_t> segment_starts_;
+    std::vector<std::vector<Matrix<T>>> segment_inputs_;
+
+    // Вызывается после backward каждого слоя (его градиенты готовы) - для обмена по сети
+    std::function<void(size_t)> backward_hook_;
+
+    static size_t channels_bytes(const std::vector<Matrix<T>>& channels){
+        size_t total=0;
+        for(auto &m: channels) total+=m.size()*sizeof(T);
+        return total;
+    }
+
+    // Метка слоя для MemoryTracker: "индекс:тип"
+    std::string layer_label(size_t i) const {
+        return std::to_string(i)+":"+layers_[i]->name();
+    }
+
+    std::vector<Matrix<T>> run_forward(size_t i,const std::vector<Matrix<T>>& input,MemoryPhase phase){
+        if(phase==MemoryPhase::Forward&&!layers_[i]->is_training()) phase=MemoryPhase::Eval;
+        MemoryScope scope(layer_label(i),phase);
+        if(phase==MemoryPhase::Recompute) return forward_again(i,input);
+        return layers_[i]->forward(input);
+    }
+
+    // Forward слоя без побочных эффектов (running-статистики не обновляются): пересчёт и замеры
+    std::vector<Matrix<T>> forward_again(size_t i,const std::vector<Matrix<T>>& input){
+        layers_[i]->set_recomputing(true);
+        std::vector<Matrix<T>> output;
+        try{
+            output=layers_[i]->forward(input);
+        }catch(...){
+            layers_[i]->set_recomputing(false);
+            throw;
+        }
+        layers_[i]->set_recomputing(false);
+        return output;
+    }
+
+    std::vector<Matrix<T>> run_backward(size_t i,const std::vector<Matrix<T>>& grad,T learning_rate,T lambda){
+        MemoryScope scope(layer_label(i),MemoryPhase::Backward);
+        std::vector<Matrix<T>> result=layers_[i]->backward(grad,learning_rate,lambda);
+        if(backward_hook_) backward_hook_(i);
+        return result;
+    }
+
+    size_t segment_end(size_t s) const {
+        return s+1<segment_starts_.size()?segment_starts_[s+1]:layers_.size();
+    }
 public:
     Network()=default;
 
@@ -14,18 +75,168 @@ public:
         layers_.emplace_back(std::move(layer));
     }
 
+    size_t size() const { return layers_.size(); }
+    Layer<T>& layer(size_t i){ return *layers_.at(i); }
+    const Layer<T>& layer(size_t i) const { return *layers_.at(i); }
+
+    // Убирает слой (например, BatchNorm после свёртки в fold_batch_norm); границы сегментов сбрасываются
+    std::unique_ptr<Layer<T>> remove_layer(size_t i){
+        if(i>=layers_.size()) throw std::runtime_error("Network: индекс слоя вне диапазона");
+        std::unique_ptr<Layer<T>> removed=std::move(layers_[i]);
+        layers_.erase(layers_.begin()+i);
+        segment_starts_.clear();
+        segment_inputs_.clear();
+        return removed;
+    }
+
+    // Вставляет слой перед позицией i (i==size() - в конец); границы сегментов сбрасываются
+    void insert_layer(size_t i,std::unique_ptr<Layer<T>> layer){
+        if(i>layers_.size()) throw std::runtime_error("Network: индекс слоя вне диапазона");
+        layers_.insert(layers_.begin()+i,std::move(layer));
+        segment_starts_.clear();
+        segment_inputs_.clear();
+    }
+
+    void set_training(bool training){
+        for(auto &layer: layers_) layer->set_training(training);
+    }
+
+    /**
+     * Включает activation checkpointing: starts - индексы слоёв, с которых начинаются сегменты.
+     * В forward сохраняются только входы сегментов, кэши слоёв всех сегментов, кроме последнего,
+     * сбрасываются; в backward сегмент сначала пересчитывается от своего входа.
+     * Пустой список выключает режим.
+     */
+    void set_activation_checkpoints(std::vector<size_t> starts){
+        segment_inputs_.clear();
+        if(starts.empty()){
+            segment_starts_.clear();
+            return;
+        }
+        if(starts[0]!=0) starts.insert(starts.begin(),0);
+        for(size_t i=1;i<starts.size();++i){
+            if(starts[i]<=starts[i-1]||starts[i]>=layers_.size())
+                throw std::runtime_error("Network: некорректные границы сегментов");
+        }
+        segment_starts_=std::move(starts);
+    }
+
+    const std::vector<size_t>& activation_checkpoints() const { return segment_starts_; }
+
     std::vector<Matrix<T>> forward(const std::vector<Matrix<T>>& input){
         std::vector<Matrix<T>> current_input=input;
-        for(auto &layer: layers_){
-            current_input=layer->forward(current_input);
+        if(segment_starts_.empty()){
+            for(size_t i=0;i<layers_.size();++i){
+                current_input=run_forward(i,current_input,MemoryPhase::Forward);
+            }
+            return current_input;
+        }
+
+        segment_inputs_.assign(segment_starts_.size(),std::vector<Matrix<T>>());
+        for(size_t s=0;s<segment_starts_.size();++s){
+            segment_inputs_[s]=current_input;
+            size_t end=segment_end(s);
+            for(size_t i=segment_starts_[s];i<end;++i){
+                current_input=run_forward(i,current_input,MemoryPhase::Forward);
+            }
+            // Последний сегмент сразу пойдёт в backward, его кэши оставляем
+            if(s+1<segment_starts_.size()){
+                for(size_t i=segment_starts_[s];i<end;++i) layers_[i]->release_cache();
+            }
         }
         return current_input;
     }
 
+    // Смешанная точность: активации хранятся в BF16/FP16, веса и накопление в T
+    void set_cache_precision(Precision p){
+        for(auto &layer: layers_) layer->set_cache_precision(p);
+    }
+
     void backward(const std::vector<Matrix<T>>& dLoss,T learning_rate,T lambda=0.0){
         std::vector<Matrix<T>> grad=dLoss;
-        for(auto it=layers_.rbegin(); it!=layers_.rend();++it){
-            grad=(*it)->backward(grad,learning_rate,lambda);
+        if(segment_starts_.empty()){
+            for(size_t i=layers_.size();i-->0;){
+                grad=run_backward(i,grad,learning_rate,lambda);
+            }
+            return;
+        }
+        if(segment_inputs_.size()!=segment_starts_.size())
+            throw std::runtime_error("Network backward: нет сохранённых входов сегментов");
+
+        for(size_t s=segment_starts_.size();s-->0;){
+            size_t start=segment_starts_[s];
+            size_t end=segment_end(s);
+            if(s+1<segment_starts_.size()){
+                std::vector<Matrix<T>> current=segment_inputs_[s];
+                for(size_t i=start;i<end;++i) current=run_forward(i,current,MemoryPhase::Recompute);
+            }
+            for(size_t i=end;i-->start;){
+                grad=run_backward(i,grad,learning_rate,lambda);
+            }
+            segment_inputs_[s].clear();
+        }
+        segment_inputs_.clear();
+    }
+
+    // Сбросить кэши после forward без backward (оценка на валидации и т.п.)
+    void release_caches(){
+        for(auto &layer: layers_) layer->release_cache();
+    }
+
+    // Проходы по слоям [begin,end) - для стадий пайплайна
+    std::vector<Matrix<T>> forward_range(size_t begin,size_t end,std::vector<Matrix<T>> input,
+                                         MemoryPhase phase=MemoryPhase::Forward){
+        for(size_t i=begin;i<end;++i) input=run_forward(i,input,phase);
+        return input;
+    }
+
+    std::vector<Matrix<T>> backward_range(size_t begin,size_t end,std::vector<Matrix<T>> grad,T learning_rate,T lambda=0.0){
+        for(size_t i=end;i-->begin;) grad=run_backward(i,grad,learning_rate,lambda);
+        return grad;
+    }
+
+    void release_caches(size_t begin,size_t end){
+        for(size_t i=begin;i<end;++i) layers_[i]->release_cache();
+    }
+
+    // Состояние всех слоёв подряд (для снапшотов обучения)
+    std::vector<ParameterView<T>> parameters(){
+        std::vector<ParameterView<T>> views;
+        for(auto &layer: layers_){
+            auto v=layer->parameters();
+            views.insert(views.end(),v.begin(),v.end());
+        }
+        return views;
+    }
+
+    // Накопление градиентов по микробатчам: backward копит, apply_gradients делает шаг
+    void set_accumulate_gradients(bool accumulate){
+        for(auto &layer: layers_) layer->set_accumulate_gradients(accumulate);
+    }
+
+    void apply_gradients(T learning_rate,T lambda=0.0){
+        for(auto &layer: layers_) layer->apply_gradients(learning_rate,lambda);
+    }
+
+    // hook(i) после backward слоя i; слои идут от последнего к первому. Пустая функция снимает hook
+    void set_backward_hook(std::function<void(size_t)> hook){ backward_hook_=std::move(hook); }
+
+    // Один проход forward с замером памяти кэшей и времени по слоям; кэши после замера сбрасываются,
+    // состояние слоёв (running-статистики) не меняется
+    std::vector<LayerProfile> profile_layers(const std::vector<Matrix<T>>& input){
+        std::vector<LayerProfile> profile;
+        std::vector<Matrix<T>> current=input;
+        for(size_t i=0;i<layers_.size();++i){
+            auto start=std::chrono::steady_clock::now();
+            current=forward_again(i,current);
+            auto stop=std::chrono::steady_clock::now();
+            LayerProfile p;
+            p.cache_bytes=layers_[i]->cache_bytes();
+            p.output_bytes=channels_bytes(current);
+            p.forward_ms=std::chrono::duration<double,std::milli>(stop-start).count();
+            profile.push_back(p);
         }
+        release_caches();
+        return profile;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include "network.hpp"
+#include "layers/static_layers.hpp"
+#include <tuple>
+#include <type_traits>
+#include <stdexcept>
+
+namespace static_network_detail {
+template<typename... Ls>
+struct chain_compatible : std::true_type {};
+
+template<typename A,typename B,typename... Rest>
+struct chain_compatible<A,B,Rest...>
+    : std::integral_constant<bool,std::is_same<typename A::output_type,typename B::input_type>::value&&
+                                  chain_compatible<B,Rest...>::value> {};
+}
+
+/**
+ * StaticNetwork: сеть, где состав и размеры слоёв заданы шаблонными параметрами.
+ * Нет виртуальных вызовов и аллокаций в forward: промежуточные буферы - std::array
+ * внутри объекта, поэтому компилятор видит все размеры и может инлайнить проход целиком.
+ * Только inference, веса берутся из обученной Network<T> через load_from().
+ *
+ * Пример для модели из main.cpp (один образец 1x28x28):
+ *   StaticNetwork<StaticConvLayer<float,1,8,28,28,3,1,1>,
+ *                 StaticPoolingLayer<float,8,28,28>,
+ *                 StaticConvLayer<float,8,16,14,14,3,1,1>,
+ *                 StaticPoolingLayer<float,16,14,14>,
+ *                 StaticFullyConnectedLayer<float,7*7*16,128>,
+ *                 StaticELULayer<float,128>,
+ *                 StaticFullyConnectedLayer<float,128,10>,
+ *                 StaticSoftmaxLayer<float,10>> net;
+ */
+template<typename... Layers>
+class StaticNetwork {
+    static_assert(sizeof...(Layers)>0,"StaticNetwork: нужен хотя бы один слой");
+    static_assert(static_network_detail::chain_compatible<Layers...>::value,
+                  "StaticNetwork: выход каждого слоя должен совпадать со входом следующего");
+private:
+    using layers_tuple=std::tuple<Layers...>;
+    static constexpr size_t num_layers=sizeof...(Layers);
+
+    layers_tuple layers_;
+    std::tuple<typename Layers::output_type...> buffers_;
+
+public:
+    using input_type=typename std::tuple_element<0,layers_tuple>::type::input_type;
+    using output_type=typename std::tuple_element<num_layers-1,layers_tuple>::type::output_type;
+
+    StaticNetwork()=default;
+    explicit StaticNetwork(Layers... layers):layers_(std::move(layers)...){}
+
+    template<size_t I>
+    typename std::tuple_element<I,layers_tuple>::type& layer(){ return std::get<I>(layers_); }
+
+    // Результат живёт во внутреннем буфере до следующего вызова forward
+    const output_type& forward(const input_type& input){
+        run(input,std::integral_constant<size_t,0>());
+        return std::get<num_layers-1>(buffers_);
+    }
+
+    // Слои с параметрами сопоставляются по порядку со слоями с параметрами в Network;
+    // несовпадение типа, нехватка или лишние слои с параметрами - исключение
+    template<typename T>
+    void load_from(const Network<T>& net){
+        size_t cursor=0;
+        load_impl(net,cursor,std::integral_constant<size_t,0>());
+        for(;cursor<net.size();++cursor){
+            if(net.layer(cursor).has_parameters())
+                throw std::runtime_error("StaticNetwork: в Network лишний слой с параметрами "+std::to_string(cursor)+
+                                         " ("+net.layer(cursor).name()+")");
+        }
+    }
+
+private:
+    template<typename In,size_t I>
+    void run(const In& in,std::integral_constant<size_t,I>){
+        std::get<I>(layers_).forward(in,std::get<I>(buffers_));
+        run(std::get<I>(buffers_),std::integral_constant<size_t,I+1>());
+    }
+
+    template<typename In>
+    void run(const In&,std::integral_constant<size_t,num_layers>){}
+
+    template<typename T,size_t I>
+    void load_impl(const Network<T>& net,size_t& cursor,std::integral_constant<size_t,I>){
+        using L=typename std::tuple_element<I,layers_tuple>::type;
+        load_layer(std::get<I>(layers_),net,cursor,std::integral_constant<bool,L::has_parameters>());
+        load_impl(net,cursor,std::integral_constant<size_t,I+1>());
+    }
+
+    template<typename T>
+    void load_impl(const Network<T>&,size_t&,std::integral_constant<size_t,num_layers>){}
+
+    template<typename L,typename T>
+    static void load_layer(L& layer,const Network<T>& net,size_t& cursor,std::true_type){
+        for(;cursor<net.size();++cursor){
+            const Layer<T>& candidate=net.layer(cursor);
+            if(!candidate.has_parameters()) continue;
+            const auto* src=dynamic_cast<const typename L::source_type*>(&candidate);
+            if(!src) throw std::runtime_error("StaticNetwork: слой "+std::to_string(cursor)+" Network ("+candidate.name()+
+                                              ") не соответствует слою с параметрами StaticNetwork");
+            layer.load(*src);
+            ++cursor;
+            return;
+        }
+        throw std::runtime_error("StaticNetwork: в Network не хватает слоёв с параметрами");
+    }
+
+    template<typename L,typename T>
+    static void load_layer(L&,const Network<T>&,size_t&,std::false_type){}
+};
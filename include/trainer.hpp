@@ -2,7 +2,18 @@
 #include "network.hpp"
 #include "utils/logger.hpp"
 #include "utils/metrics.hpp"
+#include "utils/batch_loader.hpp"
+#include "utils/memory_tracker.hpp"
+#include "utils/pipeline.hpp"
+#include "utils/checkpoint.hpp"
+#include "utils/distributed.hpp"
+#include "utils/hogwild.hpp"
+#include "utils/pruning.hpp"
+#include "utils/selective_backprop.hpp"
+#include "utils/sharded_dataset.hpp"
+#include "utils/vec_math.hpp"
 #include "exception.hpp"
+#include <chrono>
 #include <cmath>
 #include <stdexcept>
 #include <vector>
@@ -11,6 +22,7 @@
 #include <random>
 #include <tuple>
 #include <limits>
+#include <functional>
 
 enum class LossFunction {
     MSE,
@@ -20,52 +32,222 @@ enum class LossFunction {
 
 template<typename T>
 class Trainer {
+private:
+    // Вызывается в конце каждой эпохи (прунинг по расписанию и т.п.)
+    std::function<void(size_t,Network<T>&)> epoch_callback_;
+
+    std::mt19937 rng_{std::random_device{}()};
+    // Сборка батчей в фоновых потоках и аугментация на лету
+    size_t loader_workers_=0;
+    bool augment_=false;
+    AugmentationConfig augmentation_;
+    // Запись метрик эпох в общий лог (выключается, когда обучаются несколько сетей параллельно)
+    bool log_epochs_=true;
+    // Конвейер по слоям: число стадий и микробатчей на батч (1/1 - обычный режим)
+    size_t pipeline_stages_=1;
+    size_t pipeline_micro_batches_=1;
+    // Снимки обучения (пусто - выключено) и снимок, с которого продолжить
+    std::string checkpoint_path_;
+    size_t checkpoint_every_=1;
+    std::string resume_path_;
+    // Data parallel между процессами: шард данных на процесс, градиенты усредняются по кольцу
+    RingCommunicator* comm_=nullptr;
+    size_t bucket_bytes_=1<<20;
+    // Асинхронный SGD: число потоков, фабрика реплик и допустимое отставание
+    size_t hogwild_threads_=1;
+    std::function<std::unique_ptr<Network<T>>()> replica_factory_;
+    size_t hogwild_staleness_=hogwild_unbounded_staleness;
+    // Selective backprop: backward только по отобранным по лоссу примерам
+    bool selective_=false;
+    SelectiveBackpropConfig selective_config_;
+    // Постепенный прунинг FC-слоёв в конце каждой эпохи (по расписанию MagnitudePruner)
+    bool pruning_=false;
+    MagnitudePruner<T> pruner_{0};
+    // Последняя эпоха: время обучающего прохода (без оценки) и доля примеров, прошедших backward
+    double last_train_seconds_=0;
+    double last_backward_fraction_=1;
+    // Ранняя остановка между вызовами train(): лучший лосс и счётчик терпения прошлого вызова
+    bool carry_early_stopping_=false;
+    T best_loss_=std::numeric_limits<T>::max();
+    size_t wait_=0;
+    // Последний вызов train(): сколько эпох реально прошло и остановился ли он по терпению
+    size_t last_epochs_run_=0;
+    bool last_stopped_early_=false;
+
+    // Forward/backward по отобранным примерам; при bias_correction градиент строки умножается на 1/p
+    void selective_step(Network<T>& net,const std::vector<T>& x,const std::vector<T>& y,const std::vector<double>& prob,
+                        size_t rows,size_t x_cols,size_t y_cols,LossFunction loss_fn,T learning_rate,T lambda){
+        Matrix<T> X(rows,x_cols,0),Y(rows,y_cols,0);
+        std::copy(x.begin(),x.begin()+rows*x_cols,X.data());
+        std::copy(y.begin(),y.begin()+rows*y_cols,Y.data());
+        std::vector<Matrix<T>> preds=net.forward({X});
+        Matrix<T> grad=loss_fn==LossFunction::MSE?mse_loss_grad(preds[0],Y):cross_entropy_loss_grad(preds[0],Y);
+        if(selective_config_.bias_correction){
+            // Самонормированные веса: в среднем 1, масштаб шага как у обычного батча
+            double mean=0;
+            for(size_t i=0;i<rows;++i) mean+=1.0/prob[i];
+            mean/=(double)rows;
+            for(size_t i=0;i<rows;++i){
+                T w=(T)(1.0/prob[i]/mean);
+                T* g=grad.data()+i*y_cols;
+                for(size_t j=0;j<y_cols;++j) g[j]*=w;
+            }
+        }
+        net.backward({grad},learning_rate,lambda);
+    }
+
+    void prune_after_epoch(size_t epoch,Network<T>& net){
+        if(!pruning_) return;
+        pruner_.apply(net,epoch);
+        if(log_epochs_) Logger::info("Pruning: epoch "+std::to_string(epoch)+", target sparsity "+
+                                     std::to_string(pruner_.target_sparsity(epoch)));
+    }
 public:
+    void set_epoch_logging(bool enabled){ log_epochs_=enabled; }
+
+    void set_seed(unsigned seed){ rng_.seed(seed); }
+
+    void set_loader_workers(size_t workers){ loader_workers_=workers; }
+
+    void set_augmentation(const AugmentationConfig& config,size_t workers=2){
+        augment_=true;
+        augmentation_=config;
+        loader_workers_=workers;
+    }
+
+    // Стадии подбираются по замеру forward на первом батче (balance_pipeline_stages)
+    void set_pipeline(size_t num_stages,size_t micro_batches){
+        pipeline_stages_=std::max<size_t>(1,num_stages);
+        pipeline_micro_batches_=std::max<size_t>(1,micro_batches);
+    }
+
+    // Снимок каждые every_epochs эпох и в конце; пишется в фоне, атомарно через rename
+    void set_checkpointing(const std::string& path,size_t every_epochs=1){
+        checkpoint_path_=path;
+        checkpoint_every_=std::max<size_t>(1,every_epochs);
+    }
+
+    // Если снимок существует, train() загружает его и продолжает с сохранённой эпохи
+    void set_resume(const std::string& path){ resume_path_=path; }
+
+    /**
+     * Распределённое обучение: каждый процесс берёт свою долю перемешанных примеров, после backward
+     * градиенты усредняются allreduce по корзинам bucket_bytes (обмен идёт параллельно с backward
+     * следующих слоёв). Начальные веса и seed берутся у процесса 0; снимки пишет только он.
+     * Все процессы вызывают train() с одинаковыми данными и параметрами.
+     */
+    void set_distributed(RingCommunicator& comm,size_t bucket_bytes=1<<20){
+        comm_=&comm;
+        bucket_bytes_=std::max<size_t>(sizeof(T),bucket_bytes);
+    }
+
+    /**
+     * Hogwild: threads потоков обучают общую сеть без блокировок, каждый на своих батчах
+     * (HogwildExecutor). factory строит реплику той же архитектуры, что и обучаемая сеть.
+     * max_staleness - насколько шагов поток может опередить самый медленный.
+     */
+    void set_hogwild(size_t threads,std::function<std::unique_ptr<Network<T>>()> factory,
+                     size_t max_staleness=hogwild_unbounded_staleness){
+        hogwild_threads_=std::max<size_t>(1,threads);
+        replica_factory_=std::move(factory);
+        hogwild_staleness_=max_staleness;
+    }
+
+    /**
+     * Selective backprop: каждый батч сначала проходит дешёвый forward без кэшей, по лоссам примеров
+     * (SelectiveBackpropSampler) отбираются трудные, и forward/backward делается только по ним,
+     * батчами того же размера. Несовместим с конвейером, распределённым режимом и Hogwild.
+     */
+    void set_selective_backprop(const SelectiveBackpropConfig& config){
+        selective_=true;
+        selective_config_=config;
+    }
+
+    /**
+     * Прунинг во время обучения: после каждой эпохи pruner.apply(net,epoch) поднимает разреженность
+     * FC-слоёв по расписанию, обрезанные веса остаются нулевыми до конца обучения.
+     * Несовместим с Hogwild (реплики обновляют веса без масок).
+     */
+    void set_pruning(const MagnitudePruner<T>& pruner){
+        pruning_=true;
+        pruner_=pruner;
+    }
+
+    double last_epoch_train_seconds() const { return last_train_seconds_; }
+    double last_backward_fraction() const { return last_backward_fraction_; }
+
+    /**
+     * Обучение по частям (раунды successive halving): каждый следующий train()/train_streaming()
+     * продолжает раннюю остановку предыдущего - лучший лосс и счётчик терпения не сбрасываются.
+     * Включение сбрасывает накопленное состояние.
+     */
+    void set_carry_early_stopping(bool carry){
+        carry_early_stopping_=carry;
+        best_loss_=std::numeric_limits<T>::max();
+        wait_=0;
+    }
+
+    // Меньше запрошенного - ранняя остановка (last_stopped_early) или ошибка в эпохе (она в логе)
+    size_t last_epochs_run() const { return last_epochs_run_; }
+    bool last_stopped_early() const { return last_stopped_early_; }
+
+    void set_epoch_callback(std::function<void(size_t,Network<T>&)> callback){
+        epoch_callback_=std::move(callback);
+    }
+
     static T mse_loss(const Matrix<T>& pred, const Matrix<T>& target) {
         if(pred.rows()!=target.rows()||pred.cols()!=target.cols()) throw std::runtime_error("MSE: dim mismatch");
-        T sum=0;
         size_t count=pred.rows()*pred.cols();
-        for(size_t i=0;i<pred.rows();++i){
-            for(size_t j=0;j<pred.cols();++j){
-                T diff=pred(i,j)-target(i,j);
-                sum+=diff*diff;
-            }
-        }
-        return sum/(T)count;
+        return sum(elementwise(pred-target,[](T diff){ return diff*diff; }))/(T)count;
     }
 
     static Matrix<T> mse_loss_grad(const Matrix<T>& pred, const Matrix<T>& target){
         if(pred.rows()!=target.rows()||pred.cols()!=target.cols()) throw std::runtime_error("MSE_grad: dim mismatch");
-        Matrix<T> grad(pred.rows(), pred.cols(),0);
         size_t count=pred.rows()*pred.cols();
-        for(size_t i=0;i<pred.rows();++i){
-            for(size_t j=0;j<pred.cols();++j){
-                grad(i,j)=2*(pred(i,j)-target(i,j))/ (T)count;
-            }
-        }
-        return grad;
+        return (pred-target)*(T)2/(T)count;
     }
 
     static T cross_entropy_loss(const Matrix<T>& pred, const Matrix<T>& target){
         if(pred.rows()!=target.rows()||pred.cols()!=target.cols()) throw std::runtime_error("CE: dim mismatch");
         T loss=0;
+        size_t cols=pred.cols();
+        std::vector<T> logp(cols);
         for(size_t i=0;i<pred.rows();++i){
-            for(size_t j=0;j<pred.cols();++j){
-                loss-=target(i,j)*std::log(pred(i,j)+(T)1e-15);
-            }
+            const T* p=pred.data()+i*cols;
+            const T* t=target.data()+i*cols;
+            for(size_t j=0;j<cols;++j) logp[j]=p[j]+(T)1e-15;
+            vec_math::log(logp.data(),logp.data(),cols);
+            for(size_t j=0;j<cols;++j) loss-=t[j]*logp[j];
         }
         return loss/(T)pred.rows();
     }
 
     static Matrix<T> cross_entropy_loss_grad(const Matrix<T>& pred, const Matrix<T>& target){
         if(pred.rows()!=target.rows()||pred.cols()!=target.cols()) throw std::runtime_error("CE_grad: dim mismatch");
-        Matrix<T> grad(pred.rows(), pred.cols(),0);
+        return -target/(pred+(T)1e-15);
+    }
+
+    // Лосс каждой строки (для отбора примеров)
+    static std::vector<double> per_example_loss(const Matrix<T>& pred,const Matrix<T>& target,LossFunction loss_fn){
+        if(pred.rows()!=target.rows()||pred.cols()!=target.cols()) throw std::runtime_error("per_example_loss: dim mismatch");
+        if(loss_fn==LossFunction::Hinge) throw std::runtime_error("Hinge loss not implemented");
+        std::vector<double> losses(pred.rows(),0);
+        size_t cols=pred.cols();
         for(size_t i=0;i<pred.rows();++i){
-            for(size_t j=0;j<pred.cols();++j){
-                grad(i,j)=-target(i,j)/(pred(i,j)+(T)1e-15);
+            const T* p=pred.data()+i*cols;
+            const T* t=target.data()+i*cols;
+            double loss=0;
+            for(size_t j=0;j<cols;++j){
+                if(loss_fn==LossFunction::MSE){
+                    double diff=(double)p[j]-(double)t[j];
+                    loss+=diff*diff/(double)cols;
+                } else if(t[j]!=0){
+                    loss-=(double)t[j]*std::log((double)p[j]+1e-15);
+                }
             }
+            losses[i]=loss;
         }
-        return grad;
+        return losses;
     }
 
     std::tuple<T,float,float,float, T,float,float,float> train(Network<T>& net, 
@@ -75,79 +257,262 @@ public:
                                           T lambda=0.0, size_t patience=10, T min_delta=1e-4,
                                           LossFunction loss_fn=LossFunction::MSE) {
         if(X.size()!=1||Y.size()!=1) throw std::runtime_error("Trainer: Expect single matrix for X and Y");
+        // Всё, что выделяется вне слоёв (лоссы, градиенты, метрики), учитывается как Trainer
+        MemoryScope memory_scope("Trainer",MemoryPhase::Other);
         const Matrix<T>& X_full = X[0];
         const Matrix<T>& Y_full = Y[0];
         size_t num_samples = X_full.rows();
         if(num_samples == 0) throw std::runtime_error("No data");
-        size_t feature_dim = X_full.cols();
         size_t num_classes = Y_full.cols();
-        size_t num_batches = num_samples/batch_size;
+        size_t world_size=comm_?comm_->world_size():1;
+        size_t rank=comm_?comm_->rank():0;
+        bool distributed=world_size>1;
+        // При распределённом обучении у каждого процесса num_samples/world_size примеров
+        size_t num_batches = num_samples/world_size/batch_size;
+        if(distributed&&num_batches==0) throw std::runtime_error("Trainer: меньше одного батча на процесс");
 
-        T best_loss=std::numeric_limits<T>::max();
-        size_t wait=0;
+        T best_loss=carry_early_stopping_?best_loss_:std::numeric_limits<T>::max();
+        size_t wait=carry_early_stopping_?wait_:0;
+        last_epochs_run_=0;
+        last_stopped_early_=false;
         T final_train_loss=0;
         float final_train_acc=0.0f, final_train_f1=0.0f, final_train_auc=0.0f;
         float final_val_loss=0.0f, final_val_acc=0.0f, final_val_f1=0.0f, final_val_auc=0.0f;
 
+        std::unique_ptr<PipelineExecutor<T>> pipeline;
+        if(pipeline_stages_>1||pipeline_micro_batches_>1){
+            size_t sample_rows=std::min(batch_size,num_samples);
+            Matrix<T> sample(sample_rows,X_full.cols(),0);
+            std::copy(X_full.data(),X_full.data()+sample.size(),sample.data());
+            net.set_training(true);
+            std::vector<size_t> starts=balance_pipeline_stages(net.profile_layers({sample}),pipeline_stages_);
+            pipeline.reset(new PipelineExecutor<T>(net,starts,pipeline_micro_batches_));
+            if(log_epochs_){
+                std::string bounds;
+                for(size_t s: pipeline->stage_starts()) bounds+=(bounds.empty()?"":" ")+std::to_string(s);
+                Logger::info("Pipeline: stages ["+bounds+"], micro-batches "+std::to_string(pipeline_micro_batches_));
+            }
+        }
+
         std::vector<size_t> indices(num_samples);
         for(size_t i=0;i<num_samples;++i) indices[i]=i;
 
-        for(size_t epoch=0;epoch<epochs;++epoch){
+        size_t start_epoch=0;
+        bool resumed=false;
+        TrainingSnapshot<T> snapshot;
+        if(!resume_path_.empty()){
+            if(load_snapshot(resume_path_,snapshot)){
+                if(snapshot.indices.size()!=num_samples)
+                    throw std::runtime_error("Trainer: снимок сделан на другом наборе данных");
+                snapshot.restore(net,rng_);
+                indices=snapshot.indices;
+                best_loss=snapshot.best_loss;
+                wait=snapshot.wait;
+                start_epoch=snapshot.next_epoch;
+                resumed=true;
+                if(log_epochs_) Logger::info("Resumed from "+resume_path_+" at epoch "+std::to_string(start_epoch));
+            }
+        }
+        std::unique_ptr<GradientAllReducer<T>> reducer;
+        if(distributed){
+            if(pipeline) throw std::runtime_error("Trainer: распределённый режим несовместим с конвейером");
+            // Одинаковые веса и порядок перемешивания во всех процессах (после resume они уже совпадают)
+            for(auto &v: net.parameters()) comm_->broadcast(v.data,v.size);
+            if(!resumed){
+                uint32_t seed=(uint32_t)rng_();
+                comm_->broadcast(&seed,1);
+                rng_.seed(seed);
+            }
+            reducer.reset(new GradientAllReducer<T>(*comm_,bucket_bytes_));
+            net.set_accumulate_gradients(true);
+            net.set_backward_hook([&](size_t i){ reducer->add(net.layer(i).gradients()); });
+        }
+        std::vector<size_t> shard;
+
+        std::unique_ptr<HogwildExecutor<T>> hogwild;
+        if(hogwild_threads_>1){
+            if(pipeline||distributed) throw std::runtime_error("Trainer: Hogwild несовместим с конвейером и распределённым режимом");
+            if(pruning_) throw std::runtime_error("Trainer: Hogwild несовместим с прунингом");
+            if(!replica_factory_) throw std::runtime_error("Trainer: для Hogwild нужна фабрика реплик");
+            hogwild.reset(new HogwildExecutor<T>(net,replica_factory_,hogwild_threads_,hogwild_staleness_));
+        }
+
+        std::unique_ptr<SelectiveBackpropSampler> sampler;
+        if(selective_){
+            if(pipeline||distributed||hogwild)
+                throw std::runtime_error("Trainer: selective backprop несовместим с конвейером, распределённым режимом и Hogwild");
+            sampler.reset(new SelectiveBackpropSampler(selective_config_));
+            if(resumed) sampler->restore_history(snapshot.sampler_history,snapshot.sampler_next);
+        }
+        // Отобранные, но ещё не обученные примеры (копятся до batch_size)
+        std::vector<T> pending_x,pending_y;
+        std::vector<double> pending_prob;
+
+        std::unique_ptr<CheckpointWriter<T>> checkpoint_writer;
+        if(!checkpoint_path_.empty()&&rank==0) checkpoint_writer.reset(new CheckpointWriter<T>(checkpoint_path_));
+
+        for(size_t epoch=start_epoch;epoch<epochs;++epoch){
             try{
-                std::shuffle(indices.begin(),indices.end(),std::mt19937(std::random_device{}()));
+                std::shuffle(indices.begin(),indices.end(),rng_);
+                if(distributed){
+                    shard.resize(num_samples/world_size);
+                    for(size_t i=0;i<shard.size();++i) shard[i]=indices[i*world_size+rank];
+                }
+                BatchLoader<T> loader(X_full,Y_full,distributed?shard:indices,batch_size,loader_workers_,
+                                      augment_?&augmentation_:nullptr,(unsigned)rng_());
 
                 T epoch_loss=0;
                 float sum_train_acc=0.0f,sum_train_f1=0.0f,sum_train_auc=0.0f;
 
-                for(size_t batch=0;batch<num_batches;++batch){
-                    size_t start=batch*batch_size;
-                    size_t end=start+batch_size;
-                    Matrix<T> X_batch(batch_size, feature_dim,0);
-                    Matrix<T> Y_batch(batch_size, num_classes,0);
-                    for(size_t i=start;i<end;++i){
-                        size_t bi=i-start;
-                        for(size_t j=0;j<feature_dim;++j){
-                            X_batch(bi,j)=X_full(indices[i],j);
-                        }
-                        for(size_t c=0;c<num_classes;++c){
-                            Y_batch(bi,c)=Y_full(indices[i],c);
+                net.set_training(true);
+                auto train_start=std::chrono::steady_clock::now();
+                if(hogwild){
+                    StepMetrics sums=hogwild->run_epoch(loader,learning_rate,lambda,[&](Network<T>& replica,const Batch<T>& batch){
+                        std::vector<Matrix<T>> preds=replica.forward({batch.X});
+                        if(preds.size()!=1) throw std::runtime_error("Trainer::train: Network output should have one channel");
+                        const Matrix<T>& predictions=preds[0];
+                        StepMetrics m;
+                        Matrix<T> grad;
+                        if(loss_fn==LossFunction::MSE){
+                            m.loss=mse_loss(predictions,batch.Y);
+                            grad=mse_loss_grad(predictions,batch.Y);
+                        } else if(loss_fn==LossFunction::CrossEntropy){
+                            m.loss=cross_entropy_loss(predictions,batch.Y);
+                            grad=cross_entropy_loss_grad(predictions,batch.Y);
+                        } else {
+                            throw std::runtime_error("Hinge loss not implemented");
                         }
-                    }
+                        m.accuracy=Metrics<T>::accuracy(predictions,batch.Y);
+                        m.f1=Metrics<T>::f1_score(predictions,batch.Y,num_classes);
+                        m.auc=Metrics<T>::roc_auc_multiclass(predictions,batch.Y,num_classes);
+                        replica.backward({grad},learning_rate,lambda);
+                        return m;
+                    });
+                    epoch_loss=(T)sums.loss;
+                    sum_train_acc=(float)sums.accuracy;
+                    sum_train_f1=(float)sums.f1;
+                    sum_train_auc=(float)sums.auc;
+                } else {
+                    bool selecting=sampler&&epoch>=selective_config_.warmup_epochs;
+                    if(sampler) sampler->reset_counters();
+                    size_t x_cols=X_full.cols(),y_cols=Y_full.cols();
+                    Batch<T> next_batch;
+                    while(loader.next(next_batch)){
+                        const Matrix<T>& X_batch=next_batch.X;
+                        const Matrix<T>& Y_batch=next_batch.Y;
 
-                    auto preds = net.forward({X_batch});
-                    if(preds.size()!=1) throw std::runtime_error("Trainer::train: Network output should have one channel");
-                    const Matrix<T>& predictions = preds[0];
+                        std::vector<Matrix<T>> preds;
+                        if(pipeline){
+                            // Градиент по микробатчу в масштабе всего батча: сумма по микробатчам = градиент батча
+                            preds.push_back(pipeline->train_step(X_batch,[&](const Matrix<T>& p,size_t lo,size_t hi){
+                                Matrix<T> y(hi-lo,Y_batch.cols(),0);
+                                std::copy(Y_batch.data()+lo*Y_batch.cols(),Y_batch.data()+hi*Y_batch.cols(),y.data());
+                                if(loss_fn==LossFunction::CrossEntropy) return cross_entropy_loss_grad(p,y);
+                                if(loss_fn!=LossFunction::MSE) throw std::runtime_error("Hinge loss not implemented");
+                                Matrix<T> g=mse_loss_grad(p,y);
+                                T scale=(T)(hi-lo)/(T)Y_batch.rows();
+                                for(size_t i=0;i<g.size();++i) g.data()[i]*=scale;
+                                return g;
+                            },learning_rate,lambda));
+                        } else if(selecting){
+                            // Кандидатный проход: кэши для backward не нужны
+                            net.set_training(false);
+                            preds=net.forward({X_batch});
+                            net.set_training(true);
+                        } else {
+                            preds=net.forward({X_batch});
+                        }
+                        if(preds.size()!=1) throw std::runtime_error("Trainer::train: Network output should have one channel");
+                        const Matrix<T>& predictions = preds[0];
 
-                    T loss;
-                    Matrix<T> grad;
-                    if(loss_fn==LossFunction::MSE){
-                        loss=mse_loss(predictions,Y_batch);
-                        grad=mse_loss_grad(predictions,Y_batch);
-                    } else if(loss_fn==LossFunction::CrossEntropy){
-                        loss=cross_entropy_loss(predictions,Y_batch);
-                        grad=cross_entropy_loss_grad(predictions,Y_batch);
-                    } else {
-                        throw std::runtime_error("Hinge loss not implemented");
-                    }
+                        T loss;
+                        Matrix<T> grad;
+                        if(loss_fn==LossFunction::MSE){
+                            loss=mse_loss(predictions,Y_batch);
+                            if(!pipeline&&!selecting) grad=mse_loss_grad(predictions,Y_batch);
+                        } else if(loss_fn==LossFunction::CrossEntropy){
+                            loss=cross_entropy_loss(predictions,Y_batch);
+                            if(!pipeline&&!selecting) grad=cross_entropy_loss_grad(predictions,Y_batch);
+                        } else {
+                            throw std::runtime_error("Hinge loss not implemented");
+                        }
 
-                    epoch_loss+=loss;
-                    float acc=Metrics<T>::accuracy(predictions,Y_batch);
-                    float f1=Metrics<T>::f1_score(predictions,Y_batch,num_classes);
-                    float auc=Metrics<T>::roc_auc_multiclass(predictions,Y_batch,num_classes);
+                        epoch_loss+=loss;
+                        float acc=Metrics<T>::accuracy(predictions,Y_batch);
+                        float f1=Metrics<T>::f1_score(predictions,Y_batch,num_classes);
+                        float auc=Metrics<T>::roc_auc_multiclass(predictions,Y_batch,num_classes);
 
-                    sum_train_acc+=acc;
-                    sum_train_f1+=f1;
-                    sum_train_auc+=auc;
+                        sum_train_acc+=acc;
+                        sum_train_f1+=f1;
+                        sum_train_auc+=auc;
 
-                    net.backward({grad},learning_rate,lambda);
+                        if(selecting){
+                            std::vector<size_t> chosen;
+                            std::vector<double> chosen_prob;
+                            sampler->select(per_example_loss(predictions,Y_batch,loss_fn),rng_,chosen,chosen_prob);
+                            for(size_t k=0;k<chosen.size();++k){
+                                size_t r=chosen[k];
+                                pending_x.insert(pending_x.end(),X_batch.data()+r*x_cols,X_batch.data()+(r+1)*x_cols);
+                                pending_y.insert(pending_y.end(),Y_batch.data()+r*y_cols,Y_batch.data()+(r+1)*y_cols);
+                                pending_prob.push_back(chosen_prob[k]);
+                            }
+                            if(pending_prob.size()>=batch_size){
+                                selective_step(net,pending_x,pending_y,pending_prob,batch_size,x_cols,y_cols,loss_fn,learning_rate,lambda);
+                                pending_x.erase(pending_x.begin(),pending_x.begin()+batch_size*x_cols);
+                                pending_y.erase(pending_y.begin(),pending_y.begin()+batch_size*y_cols);
+                                pending_prob.erase(pending_prob.begin(),pending_prob.begin()+batch_size);
+                            }
+                        } else if(reducer){
+                            net.backward({grad},learning_rate,lambda);
+                            reducer->finish();
+                            net.apply_gradients(learning_rate,lambda);
+                        } else if(!pipeline){
+                            net.backward({grad},learning_rate,lambda);
+                        }
+                    }
+                    // Остаток эпохи - неполным батчем
+                    if(!pending_prob.empty()){
+                        selective_step(net,pending_x,pending_y,pending_prob,pending_prob.size(),x_cols,y_cols,loss_fn,learning_rate,lambda);
+                        pending_x.clear();
+                        pending_y.clear();
+                        pending_prob.clear();
+                    }
+                }
+                double train_s=std::chrono::duration<double>(std::chrono::steady_clock::now()-train_start).count();
+                last_train_seconds_=train_s;
+                last_backward_fraction_=sampler&&sampler->seen()>0?(double)sampler->selected()/(double)sampler->seen():1.0;
+                if(sampler&&log_epochs_){
+                    Logger::info("Selective backprop: epoch "+std::to_string(epoch)+", backward "+std::to_string(sampler->selected())+
+                                 " of "+std::to_string(sampler->seen())+" examples, train "+std::to_string(train_s)+" s");
                 }
 
                 T epoch_loss_avg=epoch_loss/(T)num_batches;
                 float train_acc_avg=sum_train_acc/(float)num_batches;
                 float train_f1_avg=sum_train_f1/(float)num_batches;
                 float train_auc_avg=sum_train_auc/(float)num_batches;
+                if(distributed){
+                    // Метрики по всем шардам: решение о ранней остановке должно совпасть во всех процессах
+                    T stats[4]={epoch_loss_avg,(T)train_acc_avg,(T)train_f1_avg,(T)train_auc_avg};
+                    comm_->allreduce_sum(stats,4);
+                    epoch_loss_avg=stats[0]/(T)world_size;
+                    train_acc_avg=(float)(stats[1]/(T)world_size);
+                    train_f1_avg=(float)(stats[2]/(T)world_size);
+                    train_auc_avg=(float)(stats[3]/(T)world_size);
+                }
+                if(hogwild&&log_epochs_){
+                    Logger::info("Hogwild: epoch "+std::to_string(epoch)+", threads "+std::to_string(hogwild->num_threads())+
+                                 ", "+std::to_string(train_s>0?num_batches*batch_size/train_s:0.0)+" samples/s"+
+                                 ", staleness waits "+std::to_string(hogwild->stale_waits()));
+                }
+                if(comm_&&log_epochs_){
+                    double samples=(double)(num_batches*batch_size*world_size);
+                    Logger::info("Distributed: epoch "+std::to_string(epoch)+", processes "+std::to_string(world_size)+
+                                 ", "+std::to_string(train_s>0?samples/train_s:0.0)+" samples/s"+
+                                 (reducer?", allreduce "+std::to_string(reducer->communication_ms())+" ms total":""));
+                }
 
-                // Оценка на полном наборе
+                // Оценка на полном наборе (BatchNorm на running-статистиках)
+                net.set_training(false);
                 auto pred_full_vec = net.forward({X_full});
                 if(pred_full_vec.size()!=1) throw std::runtime_error("Full dataset prediction not single channel");
                 const Matrix<T>& pred_full=pred_full_vec[0];
@@ -165,17 +530,27 @@ public:
                 float val_f1=Metrics<T>::f1_score(pred_full,Y_full,num_classes);
                 float val_auc=Metrics<T>::roc_auc_multiclass(pred_full,Y_full,num_classes);
 
-                Logger::log_metrics(epoch,
-                                    epoch_loss_avg, train_acc_avg, train_f1_avg, train_auc_avg,
-                                    val_loss, val_acc, val_f1, val_auc);
+                // Пик за эпоху: log_epoch ниже начинает новый отсчёт
+                size_t peak_mem=MemoryTracker::peak_bytes();
+                if(log_epochs_){
+                    Logger::log_metrics(epoch,
+                                        epoch_loss_avg, train_acc_avg, train_f1_avg, train_auc_avg,
+                                        val_loss, val_acc, val_f1, val_auc);
+                    MemoryTracker::log_epoch(epoch);
+                }
+
+                prune_after_epoch(epoch,net);
+                if(epoch_callback_) epoch_callback_(epoch,net);
 
+                ++last_epochs_run_;
                 if(epoch_loss_avg+min_delta<best_loss){
                     best_loss=epoch_loss_avg;
                     wait=0;
                 } else {
                     wait++;
                     if(wait>=patience){
-                        Logger::info("Early stopping on epoch "+std::to_string(epoch)+" with loss "+std::to_string(epoch_loss_avg));
+                        last_stopped_early_=true;
+                        if(log_epochs_) Logger::info("Early stopping on epoch "+std::to_string(epoch)+" with loss "+std::to_string(epoch_loss_avg));
                         final_train_loss=epoch_loss_avg;
                         final_train_acc=train_acc_avg;
                         final_train_f1=train_f1_avg;
@@ -188,11 +563,12 @@ public:
                     }
                 }
 
-                if(epoch%10==0){
+                if(log_epochs_&&epoch%10==0){
                     Logger::info("Epoch "+std::to_string(epoch)+" - Train Loss: "+std::to_string(epoch_loss_avg)+
                                  ", Train Acc: "+std::to_string(train_acc_avg)+
                                  ", Val Loss: "+std::to_string(val_loss)+
-                                 ", Val Acc: "+std::to_string(val_acc));
+                                 ", Val Acc: "+std::to_string(val_acc)+
+                                 ", Peak Mem: "+std::to_string(peak_mem/(1024*1024))+" MB");
                 }
 
                 final_train_loss=epoch_loss_avg;
@@ -204,13 +580,147 @@ public:
                 final_val_f1=val_f1;
                 final_val_auc=val_auc;
 
+                // Копия состояния снимается здесь, на диск её пишет фоновый поток
+                if(checkpoint_writer&&((epoch+1)%checkpoint_every_==0||epoch+1==epochs)){
+                    checkpoint_writer->submit(TrainingSnapshot<T>::capture(net,epoch+1,best_loss,wait,rng_,indices,sampler.get()));
+                }
+
             }catch(const std::exception &ex){
                 Logger::error(std::string("Exception during training epoch ")+std::to_string(epoch)+": "+ex.what());
                 break;
             }
         }
 
+        if(reducer){
+            net.set_backward_hook(nullptr);
+            net.set_accumulate_gradients(false);
+        }
+        best_loss_=best_loss;
+        wait_=wait;
+
         return std::make_tuple(final_train_loss, final_train_acc, final_train_f1, final_train_auc,
                                final_val_loss, final_val_acc, final_val_f1, final_val_auc);
     }
+
+    /**
+     * Обучение на наборе больше памяти: батчи каждой эпохи читаются из шардов потоком
+     * (StreamingBatchLoader: случайный порядок шардов и буфер перемешивания на shuffle_buffer записей),
+     * память не зависит от размера набора. Валидация - на X_val/Y_val в памяти (пустые - без неё).
+     * Только обычный цикл: конвейер, распределённый режим, Hogwild, selective backprop,
+     * аугментация и снимки здесь не поддерживаются.
+     */
+    std::tuple<T,float,float,float, T,float,float,float> train_streaming(Network<T>& net,const ShardedDataset& dataset,
+                                          const Matrix<T>& X_val,const Matrix<T>& Y_val,
+                                          size_t epochs,T learning_rate,size_t batch_size=32,
+                                          T lambda=0.0,size_t patience=10,T min_delta=1e-4,
+                                          LossFunction loss_fn=LossFunction::MSE,size_t shuffle_buffer=8192){
+        if(pipeline_stages_>1||pipeline_micro_batches_>1||comm_||hogwild_threads_>1||selective_||augment_||
+           !checkpoint_path_.empty()||!resume_path_.empty())
+            throw std::runtime_error("Trainer::train_streaming: поддерживается только обычный цикл обучения");
+        if(loss_fn==LossFunction::Hinge) throw std::runtime_error("Hinge loss not implemented");
+        size_t num_classes=dataset.num_classes();
+        if(X_val.rows()>0&&(X_val.cols()!=dataset.feature_dim()||Y_val.cols()!=num_classes||Y_val.rows()!=X_val.rows()))
+            throw std::runtime_error("Trainer::train_streaming: валидация не совпадает по размерам с набором");
+        if(dataset.num_records()<batch_size) throw std::runtime_error("Trainer::train_streaming: меньше одного батча");
+        MemoryScope memory_scope("Trainer",MemoryPhase::Other);
+
+        T best_loss=carry_early_stopping_?best_loss_:std::numeric_limits<T>::max();
+        size_t wait=carry_early_stopping_?wait_:0;
+        last_epochs_run_=0;
+        last_stopped_early_=false;
+        T final_train_loss=0;
+        float final_train_acc=0.0f,final_train_f1=0.0f,final_train_auc=0.0f;
+        float final_val_loss=0.0f,final_val_acc=0.0f,final_val_f1=0.0f,final_val_auc=0.0f;
+
+        for(size_t epoch=0;epoch<epochs;++epoch){
+            try{
+                StreamingBatchLoader<T> loader(dataset,batch_size,(unsigned)rng_(),shuffle_buffer);
+                size_t num_batches=loader.num_batches();
+                T epoch_loss=0;
+                float sum_train_acc=0.0f,sum_train_f1=0.0f,sum_train_auc=0.0f;
+
+                net.set_training(true);
+                auto train_start=std::chrono::steady_clock::now();
+                Batch<T> batch;
+                while(loader.next(batch)){
+                    std::vector<Matrix<T>> preds=net.forward({batch.X});
+                    if(preds.size()!=1) throw std::runtime_error("Trainer::train_streaming: Network output should have one channel");
+                    const Matrix<T>& predictions=preds[0];
+                    Matrix<T> grad;
+                    if(loss_fn==LossFunction::MSE){
+                        epoch_loss+=mse_loss(predictions,batch.Y);
+                        grad=mse_loss_grad(predictions,batch.Y);
+                    } else {
+                        epoch_loss+=cross_entropy_loss(predictions,batch.Y);
+                        grad=cross_entropy_loss_grad(predictions,batch.Y);
+                    }
+                    sum_train_acc+=Metrics<T>::accuracy(predictions,batch.Y);
+                    sum_train_f1+=Metrics<T>::f1_score(predictions,batch.Y,num_classes);
+                    sum_train_auc+=Metrics<T>::roc_auc_multiclass(predictions,batch.Y,num_classes);
+                    net.backward({grad},learning_rate,lambda);
+                }
+                double train_s=std::chrono::duration<double>(std::chrono::steady_clock::now()-train_start).count();
+                last_train_seconds_=train_s;
+                last_backward_fraction_=1.0;
+
+                T epoch_loss_avg=epoch_loss/(T)num_batches;
+                float train_acc_avg=sum_train_acc/(float)num_batches;
+                float train_f1_avg=sum_train_f1/(float)num_batches;
+                float train_auc_avg=sum_train_auc/(float)num_batches;
+                if(log_epochs_){
+                    Logger::info("Streaming: epoch "+std::to_string(epoch)+", "+std::to_string(dataset.shards().size())+" shards, "+
+                                 std::to_string(train_s>0?num_batches*batch_size/train_s:0.0)+" samples/s");
+                }
+
+                T val_loss=0;
+                float val_acc=0.0f,val_f1=0.0f,val_auc=0.0f;
+                if(X_val.rows()>0){
+                    net.set_training(false);
+                    std::vector<Matrix<T>> pred_val=net.forward({X_val});
+                    net.release_caches();
+                    val_loss=loss_fn==LossFunction::MSE?mse_loss(pred_val[0],Y_val):cross_entropy_loss(pred_val[0],Y_val);
+                    val_acc=Metrics<T>::accuracy(pred_val[0],Y_val);
+                    val_f1=Metrics<T>::f1_score(pred_val[0],Y_val,num_classes);
+                    val_auc=Metrics<T>::roc_auc_multiclass(pred_val[0],Y_val,num_classes);
+                }
+
+                if(log_epochs_){
+                    Logger::log_metrics(epoch,
+                                        epoch_loss_avg,train_acc_avg,train_f1_avg,train_auc_avg,
+                                        val_loss,val_acc,val_f1,val_auc);
+                    MemoryTracker::log_epoch(epoch);
+                }
+
+                prune_after_epoch(epoch,net);
+                if(epoch_callback_) epoch_callback_(epoch,net);
+
+                final_train_loss=epoch_loss_avg;
+                final_train_acc=train_acc_avg;
+                final_train_f1=train_f1_avg;
+                final_train_auc=train_auc_avg;
+                final_val_loss=(float)val_loss;
+                final_val_acc=val_acc;
+                final_val_f1=val_f1;
+                final_val_auc=val_auc;
+
+                ++last_epochs_run_;
+                if(epoch_loss_avg+min_delta<best_loss){
+                    best_loss=epoch_loss_avg;
+                    wait=0;
+                } else if(++wait>=patience){
+                    last_stopped_early_=true;
+                    if(log_epochs_) Logger::info("Early stopping on epoch "+std::to_string(epoch)+" with loss "+std::to_string(epoch_loss_avg));
+                    break;
+                }
+            }catch(const std::exception &ex){
+                Logger::error(std::string("Exception during training epoch ")+std::to_string(epoch)+": "+ex.what());
+                break;
+            }
+        }
+        best_loss_=best_loss;
+        wait_=wait;
+
+        return std::make_tuple(final_train_loss,final_train_acc,final_train_f1,final_train_auc,
+                               final_val_loss,final_val_acc,final_val_f1,final_val_auc);
+    }
 };
\ No newline at end of file
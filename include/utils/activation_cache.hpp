@@ -0,0 +1,80 @@
+#pragma once
+#include "matrix.hpp"
+#include "half.hpp"
+#include <vector>
+#include <utility>
+
+/**
+ * ActivationCache: хранит входы слоя до backward.
+ * В режиме FP32 каналы лежат как есть, в BF16/FP16 упакованы в 2 байта на элемент
+ * и распаковываются обратно в T при take().
+ */
+template<typename T>
+class ActivationCache {
+private:
+    Precision precision_=Precision::FP32;
+    std::vector<Matrix<T>> full_;
+    std::vector<std::vector<uint16_t>> packed_;
+    std::vector<std::pair<size_t,size_t>> shapes_;
+public:
+    ActivationCache()=default;
+
+    void store(const std::vector<Matrix<T>>& channels,Precision p){
+        if(p==Precision::FP32){
+            std::vector<Matrix<T>> copy=channels;
+            store(std::move(copy),p);
+            return;
+        }
+        clear();
+        precision_=p;
+        packed_.resize(channels.size());
+        shapes_.reserve(channels.size());
+        for(size_t c=0;c<channels.size();++c){
+            packed_[c].resize(channels[c].size());
+            half_precision::pack(channels[c].data(),packed_[c].data(),channels[c].size(),p);
+            shapes_.emplace_back(channels[c].rows(),channels[c].cols());
+        }
+    }
+
+    void store(std::vector<Matrix<T>>&& channels,Precision p){
+        if(p!=Precision::FP32){
+            store(static_cast<const std::vector<Matrix<T>>&>(channels),p);
+            return;
+        }
+        clear();
+        precision_=p;
+        full_=std::move(channels);
+    }
+
+    // Забирает содержимое, кэш после вызова пуст
+    std::vector<Matrix<T>> take(){
+        std::vector<Matrix<T>> out;
+        if(precision_==Precision::FP32){
+            out=std::move(full_);
+        } else {
+            out.reserve(packed_.size());
+            for(size_t c=0;c<packed_.size();++c){
+                Matrix<T> m(shapes_[c].first,shapes_[c].second);
+                half_precision::unpack(packed_[c].data(),m.data(),m.size(),precision_);
+                out.push_back(std::move(m));
+            }
+        }
+        clear();
+        return out;
+    }
+
+    bool empty() const { return full_.empty()&&packed_.empty(); }
+
+    size_t bytes() const {
+        size_t total=0;
+        for(auto &m: full_) total+=m.size()*sizeof(T);
+        for(auto &p: packed_) total+=p.size()*sizeof(uint16_t);
+        return total;
+    }
+
+    void clear(){
+        full_.clear();
+        packed_.clear();
+        shapes_.clear();
+    }
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include "../network.hpp"
+#include "logger.hpp"
+#include <vector>
+#include <string>
+#include <algorithm>
+
+struct CheckpointPlan {
+    std::vector<size_t> segment_starts;
+    size_t stored_bytes=0;        // сохранённые входы сегментов
+    size_t peak_bytes=0;          // stored_bytes + самый тяжёлый сегмент
+    size_t baseline_peak_bytes=0; // без checkpointing: все кэши сразу
+    double recompute_ms=0;        // лишний forward в backward
+    double forward_ms=0;          // обычный forward всей сети
+    bool fits_budget=false;
+};
+
+/**
+ * Жадно режет слои на сегменты с суммарным кэшем не больше L для каждого кандидата L
+ * (все суммы подряд идущих слоёв) и выбирает план, который укладывается в budget_bytes
+ * с минимальным пересчётом. Если ни один не укладывается - план с минимальной памятью.
+ */
+inline CheckpointPlan plan_activation_checkpoints(const std::vector<LayerProfile>& profile,size_t input_bytes,size_t budget_bytes){
+    size_t n=profile.size();
+    CheckpointPlan best;
+    if(n==0) return best;
+
+    size_t total_cache=0;
+    double total_ms=0;
+    for(auto &p: profile){
+        total_cache+=p.cache_bytes;
+        total_ms+=p.forward_ms;
+    }
+
+    std::vector<size_t> candidates;
+    for(size_t i=0;i<n;++i){
+        size_t sum=0;
+        for(size_t j=i;j<n;++j){
+            sum+=profile[j].cache_bytes;
+            candidates.push_back(sum);
+        }
+    }
+    std::sort(candidates.begin(),candidates.end());
+    candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end());
+
+    bool have_best=false;
+    for(size_t limit: candidates){
+        CheckpointPlan plan;
+        plan.baseline_peak_bytes=total_cache;
+        plan.forward_ms=total_ms;
+        size_t segment_cache=0;
+        size_t max_segment=0;
+        double segment_ms=0;
+        plan.segment_starts.push_back(0);
+        plan.stored_bytes=input_bytes;
+        for(size_t i=0;i<n;++i){
+            if(i>0&&segment_cache+profile[i].cache_bytes>limit){
+                max_segment=std::max(max_segment,segment_cache);
+                plan.recompute_ms+=segment_ms;
+                plan.segment_starts.push_back(i);
+                plan.stored_bytes+=profile[i-1].output_bytes;
+                segment_cache=0;
+                segment_ms=0;
+            }
+            segment_cache+=profile[i].cache_bytes;
+            segment_ms+=profile[i].forward_ms;
+        }
+        max_segment=std::max(max_segment,segment_cache);
+        // Один сегмент - это обычный режим, входы отдельно не сохраняются
+        if(plan.segment_starts.size()==1) plan.stored_bytes=0;
+        plan.peak_bytes=plan.stored_bytes+max_segment;
+        plan.fits_budget=plan.peak_bytes<=budget_bytes;
+
+        bool better;
+        if(!have_best) better=true;
+        else if(plan.fits_budget!=best.fits_budget) better=plan.fits_budget;
+        else if(plan.fits_budget) better=plan.recompute_ms<best.recompute_ms||
+                                         (plan.recompute_ms==best.recompute_ms&&plan.peak_bytes<best.peak_bytes);
+        else better=plan.peak_bytes<best.peak_bytes;
+        if(better){
+            best=plan;
+            have_best=true;
+        }
+    }
+    return best;
+}
+
+inline void log_checkpoint_plan(const CheckpointPlan& plan,size_t budget_bytes){
+    std::string starts;
+    for(size_t i=0;i<plan.segment_starts.size();++i){
+        if(i) starts+=" ";
+        starts+=std::to_string(plan.segment_starts[i]);
+    }
+    double overhead=plan.forward_ms>0?100.0*plan.recompute_ms/plan.forward_ms:0.0;
+    Logger::info("Checkpointing budget="+std::to_string(budget_bytes)+
+                 " segments=["+starts+"] peak="+std::to_string(plan.peak_bytes)+
+                 " (baseline "+std::to_string(plan.baseline_peak_bytes)+")"+
+                 " stored="+std::to_string(plan.stored_bytes)+
+                 " recompute=+"+std::to_string(overhead)+"% forward"+
+                 (plan.fits_budget?"":" [не укладывается в бюджет]"));
+}
+
+// Замеряет сеть на sample, выбирает план под budget_bytes и включает его
+template<typename T>
+CheckpointPlan enable_activation_checkpointing(Network<T>& net,const std::vector<Matrix<T>>& sample,size_t budget_bytes){
+    size_t input_bytes=0;
+    for(auto &m: sample) input_bytes+=m.size()*sizeof(T);
+    CheckpointPlan plan=plan_activation_checkpoints(net.profile_layers(sample),input_bytes,budget_bytes);
+    net.set_activation_checkpoints(plan.segment_starts.size()>1?plan.segment_starts:std::vector<size_t>());
+    log_checkpoint_plan(plan,budget_bytes);
+    return plan;
+}
+
+// Компромисс память/пересчёт для нескольких бюджетов без изменения сети
+template<typename T>
+std::vector<CheckpointPlan> checkpoint_tradeoff_report(Network<T>& net,const std::vector<Matrix<T>>& sample,
+                                                       const std::vector<size_t>& budgets){
+    size_t input_bytes=0;
+    for(auto &m: sample) input_bytes+=m.size()*sizeof(T);
+    std::vector<LayerProfile> profile=net.profile_layers(sample);
+    std::vector<CheckpointPlan> plans;
+    for(size_t budget: budgets){
+        plans.push_back(plan_activation_checkpoints(profile,input_bytes,budget));
+        log_checkpoint_plan(plans.back(),budget);
+    }
+    return plans;
+}
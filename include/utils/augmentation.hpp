@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+struct AugmentationConfig {
+    size_t height=28;
+    size_t width=28;
+    float max_shift=2.0f;      // сдвиг в пикселях (субпиксельный)
+    float max_rotation=0.17f;  // радианы, ~10 градусов
+    float max_scale=0.1f;      // относительное изменение масштаба
+    float max_shear=0.1f;
+    float elastic_alpha=0.0f;  // амплитуда эластичных искажений, 0 - выключены
+    float elastic_sigma=4.0f;  // сглаживание поля смещений
+    float noise_stddev=0.0f;   // гауссов шум после выборки
+};
+
+/**
+ * Augmenter: случайное аффинное преобразование + эластичные искажения + шум
+ * для одного изображения [height x width], лежащего строкой матрицы.
+ * Выборка билинейная по изображению с нулевой рамкой (1 пиксель слева/сверху,
+ * 2 справа/снизу), поэтому ветвлений по границам нет. Строка выхода считается в два прохода:
+ * координаты, доли и смещения соседей - непрерывными массивами (этот цикл векторизуется),
+ * затем выборка четырёх соседей по смещениям (gather, скалярный).
+ * Состояние (буферы) своё у каждого экземпляра: по одному на поток.
+ */
+template<typename T>
+class Augmenter {
+private:
+    AugmentationConfig config_;
+    std::vector<float> padded_;
+    std::vector<float> dx_;
+    std::vector<float> dy_;
+    std::vector<float> blur_tmp_;
+    std::vector<float> kernel_;
+    // Проход по строке выхода: смещение левого верхнего соседа и доли по x/y
+    std::vector<int> offset_;
+    std::vector<float> fx_;
+    std::vector<float> fy_;
+public:
+    explicit Augmenter(const AugmentationConfig& config=AugmentationConfig()):config_(config){
+        padded_.assign((config_.height+3)*(config_.width+3),0.0f);
+        size_t n=config_.height*config_.width;
+        dx_.assign(n,0.0f);
+        dy_.assign(n,0.0f);
+        blur_tmp_.assign(n,0.0f);
+        offset_.assign(config_.width,0);
+        fx_.assign(config_.width,0.0f);
+        fy_.assign(config_.width,0.0f);
+        if(config_.elastic_alpha>0){
+            int radius=(int)std::ceil(3*config_.elastic_sigma);
+            float sum=0;
+            for(int k=-radius;k<=radius;++k){
+                float w=std::exp(-(float)(k*k)/(2*config_.elastic_sigma*config_.elastic_sigma));
+                kernel_.push_back(w);
+                sum+=w;
+            }
+            for(auto &w: kernel_) w/=sum;
+        }
+    }
+
+    const AugmentationConfig& config() const { return config_; }
+
+    void augment(const T* src,T* dst,std::mt19937& rng){
+        const int h=(int)config_.height;
+        const int w=(int)config_.width;
+        const int pw=w+3;
+        for(int r=0;r<h;++r){
+            for(int c=0;c<w;++c) padded_[(r+1)*pw+c+1]=(float)src[r*w+c];
+        }
+
+        std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+        float angle=unit(rng)*config_.max_rotation;
+        float scale=1.0f+unit(rng)*config_.max_scale;
+        float shear=unit(rng)*config_.max_shear;
+        float tx=unit(rng)*config_.max_shift;
+        float ty=unit(rng)*config_.max_shift;
+
+        // Обратное отображение: для пикселя выхода ищем точку во входе
+        float cs=std::cos(angle)/scale;
+        float sn=std::sin(angle)/scale;
+        float a00=cs, a01=sn+shear*cs;
+        float a10=-sn, a11=cs-shear*sn;
+        float cx=(w-1)*0.5f, cy=(h-1)*0.5f;
+
+        bool elastic=config_.elastic_alpha>0;
+        if(elastic) make_displacement_field(rng);
+
+        const float max_x=(float)(w+1);
+        const float max_y=(float)(h+1);
+        // Без эластичных искажений поле смещений нулевое
+        const float* ex=dx_.data();
+        const float* ey=dy_.data();
+        int* offset=offset_.data();
+        float* fx=fx_.data();
+        float* fy=fy_.data();
+        for(int r=0;r<h;++r){
+            float yr=(float)r-cy-ty;
+            for(int c=0;c<w;++c){
+                float xr=(float)c-cx-tx;
+                // +1 - смещение на рамку
+                float sx=a00*xr+a01*yr+cx+1.0f+ex[r*w+c];
+                float sy=a10*xr+a11*yr+cy+1.0f+ey[r*w+c];
+                sx=std::min(std::max(sx,0.0f),max_x);
+                sy=std::min(std::max(sy,0.0f),max_y);
+                int x0=(int)sx;
+                int y0=(int)sy;
+                fx[c]=sx-(float)x0;
+                fy[c]=sy-(float)y0;
+                offset[c]=y0*pw+x0;
+            }
+            T* out=dst+r*w;
+            for(int c=0;c<w;++c){
+                const float* p=&padded_[offset[c]];
+                float top=p[0]+(p[1]-p[0])*fx[c];
+                float bottom=p[pw]+(p[pw+1]-p[pw])*fx[c];
+                out[c]=(T)(top+(bottom-top)*fy[c]);
+            }
+        }
+
+        if(config_.noise_stddev>0){
+            std::normal_distribution<float> noise(0.0f,config_.noise_stddev);
+            for(int i=0;i<h*w;++i) dst[i]+=(T)noise(rng);
+        }
+    }
+
+private:
+    // Случайное поле смещений, сглаженное гауссовым фильтром (Simard et al.)
+    void make_displacement_field(std::mt19937& rng){
+        std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+        for(auto &v: dx_) v=unit(rng);
+        for(auto &v: dy_) v=unit(rng);
+        smooth(dx_);
+        smooth(dy_);
+        for(auto &v: dx_) v*=config_.elastic_alpha;
+        for(auto &v: dy_) v*=config_.elastic_alpha;
+    }
+
+    void smooth(std::vector<float>& field){
+        const int h=(int)config_.height;
+        const int w=(int)config_.width;
+        const int radius=(int)kernel_.size()/2;
+        for(int r=0;r<h;++r){
+            for(int c=0;c<w;++c){
+                float sum=0;
+                for(int k=-radius;k<=radius;++k){
+                    int cc=std::min(std::max(c+k,0),w-1);
+                    sum+=kernel_[k+radius]*field[r*w+cc];
+                }
+                blur_tmp_[r*w+c]=sum;
+            }
+        }
+        for(int r=0;r<h;++r){
+            for(int c=0;c<w;++c){
+                float sum=0;
+                for(int k=-radius;k<=radius;++k){
+                    int rr=std::min(std::max(r+k,0),h-1);
+                    sum+=kernel_[k+radius]*blur_tmp_[rr*w+c];
+                }
+                field[r*w+c]=sum;
+            }
+        }
+    }
+};
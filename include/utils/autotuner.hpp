@@ -0,0 +1,122 @@
+#pragma once
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Вариант ядра слоя: порядок циклов (смысл - у конкретного ядра), размер блока
+ * (0 - без блокирования) и число задач ThreadPool (0 - по ThreadPool::grain_size).
+ */
+struct KernelConfig {
+    int loop_order=0;
+    size_t block=0;
+    size_t threads=0;
+
+    std::string str() const {
+        std::ostringstream out;
+        out<<"order="<<loop_order<<" block="<<block<<" threads="<<threads;
+        return out.str();
+    }
+
+    // grain для parallel_for по n итерациям стоимостью cost
+    size_t grain(size_t n,size_t cost) const {
+        return threads==0?ThreadPool::grain_size(cost):std::max<size_t>(1,(n+threads-1)/threads);
+    }
+};
+
+/**
+ * Autotuner: выбор варианта ядра по замеру на реальных данных.
+ * При первом обращении к ключу (тип слоя, форма, корзина батча, число потоков пула) каждый кандидат
+ * прогоняется несколько раз, побеждает минимальное время. Результаты дописываются в файл кэша
+ * (init) строками "модель CPU<TAB>ключ<TAB>order block threads"; при загрузке берутся только
+ * строки текущего CPU, поэтому один файл годится для разных машин.
+ * Ключ настраивается одним потоком: пока идёт замер, остальные (и вложенные в замер вызовы
+ * из задач ThreadPool) получают первый кандидат с settled=false и спрашивают снова позже.
+ * Кандидаты одного ключа считают одно и то же (порядок циклов, блоки, число задач), поэтому выбор
+ * меняет только время; алгоритмы с другой погрешностью (Winograd) включаются явно, а не замером.
+ * CNN_AUTOTUNE=0 - воспроизводимый режим: замеров и файла кэша нет, всегда первый кандидат
+ * (ручной вариант по умолчанию), результат не зависит от машины, нагрузки и порядка запусков.
+ */
+class Autotuner {
+private:
+    static std::string path_;
+    static std::string cpu_;
+    static std::map<std::string,KernelConfig> cache_;
+    static std::set<std::string> pending_; // ключи, которые сейчас замеряются
+    static std::mutex mtx_;
+    static std::atomic<bool> enabled_;
+    static thread_local bool measuring_;
+
+    // false - ключ уже в кэше (config заполнен) или его замеряет другой поток
+    static bool begin(const std::string& key,KernelConfig& config,bool& settled);
+    static void store(const std::string& key,const KernelConfig& config);
+    static void abandon(const std::string& key);
+
+public:
+    // Загрузка кэша из файла; без init результаты живут только в памяти процесса
+    static void init(const std::string& cache_path);
+    static bool enabled(){ return enabled_; }
+    static void set_enabled(bool enabled){ enabled_=enabled; }
+    static const std::string& cpu_model();
+
+    // Корзина размера батча для ключа: ближайшая сверху степень двойки
+    static size_t bucket(size_t rows){
+        size_t b=1;
+        while(b<rows) b<<=1;
+        return b;
+    }
+
+    /**
+     * run(config) выполняет ядро целиком; кандидаты должны давать одинаковый результат (см. выше).
+     * settled=false - выбор временный (ключ замеряется в другом потоке), вызвать tune снова позже.
+     */
+    template<typename Run>
+    static KernelConfig tune(const std::string& key,const std::vector<KernelConfig>& candidates,Run run,
+                             bool* settled=nullptr){
+        KernelConfig best=candidates.front();
+        bool done=true;
+        if(settled) *settled=true;
+        if(!enabled_||candidates.size()==1) return best;
+        if(!begin(key,best,done)){
+            if(settled) *settled=done;
+            return best;
+        }
+
+        double best_ms=std::numeric_limits<double>::max();
+        measuring_=true;
+        try{
+            for(auto &c: candidates){
+                run(c); // прогрев
+                double ms=std::numeric_limits<double>::max();
+                for(int rep=0;rep<3;++rep){
+                    auto start=std::chrono::steady_clock::now();
+                    run(c);
+                    ms=std::min(ms,std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+                }
+                if(ms<best_ms){
+                    best_ms=ms;
+                    best=c;
+                }
+            }
+        }catch(...){
+            measuring_=false;
+            abandon(key);
+            throw;
+        }
+        measuring_=false;
+        store(key,best);
+        std::ostringstream msg;
+        msg<<"Autotuner: "<<key<<" -> "<<best.str()<<" ("<<best_ms<<" мс)";
+        Logger::info(msg.str());
+        return best;
+    }
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include "matrix.hpp"
+#include "augmentation.hpp"
+#include "bounded_queue.hpp"
+#include <vector>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+template<typename T>
+struct Batch {
+    Matrix<T> X;
+    Matrix<T> Y;
+};
+
+/**
+ * BatchLoader: собирает батчи эпохи в фоновых потоках, опционально с аугментацией.
+ * Батч b собирает воркер b % num_workers со своим генератором (seed, worker),
+ * поэтому результат воспроизводим и не зависит от планирования потоков.
+ * Каждый воркер держит не больше prefetch готовых батчей; next() отдаёт их по порядку.
+ * При num_workers==0 батчи собираются прямо в next().
+ * Исключение воркера закрывает его очередь и пробрасывается из next() на его батче.
+ */
+template<typename T>
+class BatchLoader {
+private:
+    struct Worker {
+        std::unique_ptr<BoundedQueue<Batch<T>>> queue;
+        std::unique_ptr<Augmenter<T>> augmenter;
+        std::mt19937 rng;
+    };
+
+    const Matrix<T>& X_;
+    const Matrix<T>& Y_;
+    const std::vector<size_t>& indices_;
+    size_t batch_size_;
+    size_t num_batches_;
+    bool augment_;
+    std::vector<Worker> workers_;
+    std::vector<std::thread> threads_;
+    size_t next_=0;
+    std::exception_ptr error_;
+    std::mutex error_mtx_;
+
+public:
+    BatchLoader(const Matrix<T>& X,const Matrix<T>& Y,const std::vector<size_t>& indices,size_t batch_size,
+                size_t num_workers=0,const AugmentationConfig* augmentation=nullptr,unsigned seed=0,size_t prefetch=2)
+        : X_(X), Y_(Y), indices_(indices), batch_size_(batch_size),
+          num_batches_(batch_size>0?indices.size()/batch_size:0), augment_(augmentation!=nullptr) {
+        if(augment_&&X.cols()!=augmentation->height*augmentation->width)
+            throw std::runtime_error("BatchLoader: размер изображения не совпадает с AugmentationConfig");
+        size_t count=num_workers>0?num_workers:1;
+        workers_.resize(count);
+        for(size_t w=0;w<count;++w){
+            std::seed_seq seq{seed,(unsigned)w};
+            workers_[w].rng.seed(seq);
+            if(augment_) workers_[w].augmenter.reset(new Augmenter<T>(*augmentation));
+            if(num_workers>0) workers_[w].queue.reset(new BoundedQueue<Batch<T>>(prefetch));
+        }
+        for(size_t w=0;w<num_workers;++w){
+            threads_.emplace_back([this,w,num_workers](){
+                MemoryScope scope("BatchLoader",MemoryPhase::Other);
+                try{
+                    for(size_t b=w;b<num_batches_;b+=num_workers){
+                        if(!workers_[w].queue->push(assemble(b,workers_[w]))) return;
+                    }
+                }catch(...){
+                    std::lock_guard<std::mutex> lock(error_mtx_);
+                    if(!error_) error_=std::current_exception();
+                }
+                workers_[w].queue->close();
+            });
+        }
+    }
+
+    ~BatchLoader(){
+        for(auto &w: workers_){
+            if(w.queue) w.queue->close();
+        }
+        for(auto &t: threads_) t.join();
+    }
+
+    BatchLoader(const BatchLoader&)=delete;
+    BatchLoader& operator=(const BatchLoader&)=delete;
+
+    size_t num_batches() const { return num_batches_; }
+
+    bool next(Batch<T>& batch){
+        if(next_>=num_batches_) return false;
+        size_t b=next_++;
+        if(threads_.empty()){
+            batch=assemble(b,workers_[0]);
+            return true;
+        }
+        if(workers_[b%threads_.size()].queue->pop(batch)) return true;
+        std::lock_guard<std::mutex> lock(error_mtx_);
+        if(error_) std::rethrow_exception(error_);
+        throw std::runtime_error("BatchLoader: сборка батчей прервана");
+    }
+
+private:
+    Batch<T> assemble(size_t b,Worker& worker){
+        size_t feature_dim=X_.cols();
+        size_t num_classes=Y_.cols();
+        Batch<T> batch{Matrix<T>(batch_size_,feature_dim,0),Matrix<T>(batch_size_,num_classes,0)};
+        size_t start=b*batch_size_;
+        for(size_t bi=0;bi<batch_size_;++bi){
+            size_t src=indices_[start+bi];
+            const T* x=X_.data()+src*feature_dim;
+            T* dst=batch.X.data()+bi*feature_dim;
+            if(augment_) worker.augmenter->augment(x,dst,worker.rng);
+            else std::copy(x,x+feature_dim,dst);
+            const T* y=Y_.data()+src*num_classes;
+            std::copy(y,y+num_classes,batch.Y.data()+bi*num_classes);
+        }
+        return batch;
+    }
+};
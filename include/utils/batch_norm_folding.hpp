@@ -0,0 +1,58 @@
+#pragma once
+#include "../network.hpp"
+#include "../layers/batch_norm_layer.hpp"
+#include "../layers/convolutional_layer.hpp"
+#include "../layers/depthwise_separable_conv_layer.hpp"
+#include "../layers/fully_connected_layer.hpp"
+#include "logger.hpp"
+#include <string>
+
+/**
+ * Вливает BatchNormLayer в стоящий перед ним слой для inference:
+ * свёртка (NormAxis::Channels, обычная или depthwise-separable) получает kernels*scale
+ * и bias*scale+shift по выходным каналам, FullyConnected (NormAxis::Features) - то же
+ * по столбцам весов. Сами BN-слои удаляются.
+ * BN без подходящего предшественника остаётся в сети. Сеть переводится в режим inference.
+ * Возвращает число влитых слоёв.
+ */
+template<typename T>
+size_t fold_batch_norm(Network<T>& net){
+    net.set_training(false);
+    size_t folded=0;
+    for(size_t i=1;i<net.size();){
+        auto* bn=dynamic_cast<BatchNormLayer<T>*>(&net.layer(i));
+        if(!bn){
+            ++i;
+            continue;
+        }
+        std::vector<T> scale,shift;
+        bn->inference_affine(scale,shift);
+        bool merged=false;
+        if(bn->axis()==NormAxis::Channels){
+            auto* conv=dynamic_cast<ConvolutionalLayer<T>*>(&net.layer(i-1));
+            if(conv&&(size_t)conv->out_channels()==bn->num_features()){
+                conv->fold_output_affine(scale,shift);
+                merged=true;
+            }
+            auto* separable=dynamic_cast<DepthwiseSeparableConvLayer<T>*>(&net.layer(i-1));
+            if(separable&&(size_t)separable->out_channels()==bn->num_features()){
+                separable->fold_output_affine(scale,shift);
+                merged=true;
+            }
+        } else {
+            auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net.layer(i-1));
+            if(fc&&fc->output_size()==bn->num_features()){
+                fc->fold_output_affine(scale,shift);
+                merged=true;
+            }
+        }
+        if(merged){
+            net.remove_layer(i);
+            ++folded;
+        } else {
+            ++i;
+        }
+    }
+    Logger::info("BatchNorm folding: влито слоёв "+std::to_string(folded));
+    return folded;
+}
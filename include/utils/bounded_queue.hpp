@@ -0,0 +1,48 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * BoundedQueue: блокирующая очередь ограниченной ёмкости для конвейеров
+ * "производитель -> потребитель". После close() push() игнорируется,
+ * а pop() возвращает false, когда очередь опустела.
+ */
+template<typename Item>
+class BoundedQueue {
+private:
+    size_t capacity_;
+    std::deque<Item> items_;
+    bool closed_=false;
+    std::mutex mtx_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+public:
+    explicit BoundedQueue(size_t capacity):capacity_(capacity>0?capacity:1){}
+
+    bool push(Item item){
+        std::unique_lock<std::mutex> lock(mtx_);
+        not_full_.wait(lock,[this](){ return closed_||items_.size()<capacity_; });
+        if(closed_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(Item& item){
+        std::unique_lock<std::mutex> lock(mtx_);
+        not_empty_.wait(lock,[this](){ return closed_||!items_.empty(); });
+        if(items_.empty()) return false;
+        item=std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close(){
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_=true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+};
@@ -0,0 +1,285 @@
+#pragma once
+#include "../network.hpp"
+#include "../layers/fully_connected_layer.hpp"
+#include "logger.hpp"
+#include "selective_backprop.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * Снимок обучения: параметры сети и всё состояние Trainer, от которого зависит
+ * продолжение (ГСЧ перемешивания, текущая перестановка индексов, счётчики early stopping,
+ * история лоссов selective backprop, маски прунинга FC-слоёв).
+ * Снимок - независимая копия, поэтому его можно писать на диск, пока сеть обучается дальше.
+ */
+template<typename T>
+struct TrainingSnapshot {
+    size_t next_epoch=0;
+    T best_loss=0;
+    size_t wait=0;
+    std::string rng_state;
+    std::vector<size_t> indices;
+    std::vector<std::vector<T>> tensors;
+    // Selective backprop: кольцевой буфер лоссов сэмплера (пусто - режим выключен)
+    std::vector<double> sampler_history;
+    size_t sampler_next=0;
+    // Маски прунинга по индексу слоя; пустые у слоёв не FC и не прунившихся
+    std::vector<std::vector<unsigned char>> masks;
+    std::vector<std::vector<unsigned char>> bias_masks;
+
+    static TrainingSnapshot capture(Network<T>& net,size_t next_epoch,T best_loss,size_t wait,
+                                    const std::mt19937& rng,const std::vector<size_t>& indices,
+                                    const SelectiveBackpropSampler* sampler=nullptr){
+        TrainingSnapshot s;
+        s.next_epoch=next_epoch;
+        s.best_loss=best_loss;
+        s.wait=wait;
+        std::ostringstream rng_out;
+        rng_out<<rng;
+        s.rng_state=rng_out.str();
+        s.indices=indices;
+        for(auto &v: net.parameters()) s.tensors.emplace_back(v.data,v.data+v.size);
+        if(sampler){
+            s.sampler_history=sampler->history();
+            s.sampler_next=sampler->history_next();
+        }
+        s.masks.resize(net.size());
+        s.bias_masks.resize(net.size());
+        for(size_t i=0;i<net.size();++i){
+            auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net.layer(i));
+            if(!fc) continue;
+            s.masks[i]=fc->mask();
+            s.bias_masks[i]=fc->bias_mask();
+        }
+        return s;
+    }
+
+    void restore(Network<T>& net,std::mt19937& rng) const {
+        std::vector<ParameterView<T>> views=net.parameters();
+        if(views.size()!=tensors.size())
+            throw std::runtime_error("Checkpoint: число тензоров не совпадает с сетью");
+        for(size_t i=0;i<views.size();++i){
+            if(views[i].size!=tensors[i].size())
+                throw std::runtime_error("Checkpoint: размер тензора "+std::to_string(i)+" не совпадает с сетью");
+        }
+        for(size_t i=0;i<views.size();++i) std::copy(tensors[i].begin(),tensors[i].end(),views[i].data);
+        if(!masks.empty()&&masks.size()!=net.size())
+            throw std::runtime_error("Checkpoint: число слоёв не совпадает с сетью");
+        for(size_t i=0;i<masks.size();++i){
+            auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net.layer(i));
+            if(fc) fc->set_masks(masks[i],bias_masks[i]);
+            else if(!masks[i].empty()) throw std::runtime_error("Checkpoint: маска прунинга у слоя "+std::to_string(i)+" не FC");
+        }
+        std::istringstream rng_in(rng_state);
+        rng_in>>rng;
+        if(rng_in.fail()) throw std::runtime_error("Checkpoint: повреждено состояние ГСЧ");
+    }
+};
+
+namespace checkpoint_detail {
+
+// Версия 2 добавила историю selective backprop и маски прунинга; версия 1 читается без них
+const char magic[8]={'C','N','N','C','K','P','T','2'};
+const char magic_v1[8]={'C','N','N','C','K','P','T','1'};
+
+inline void write_bytes(std::FILE* f,const void* data,size_t bytes){
+    if(bytes>0&&std::fwrite(data,1,bytes,f)!=bytes) throw std::runtime_error("Checkpoint: ошибка записи");
+}
+
+inline void write_u64(std::FILE* f,uint64_t v){ write_bytes(f,&v,sizeof(v)); }
+
+inline void read_bytes(std::FILE* f,void* data,size_t bytes){
+    if(bytes>0&&std::fread(data,1,bytes,f)!=bytes) throw std::runtime_error("Checkpoint: файл обрезан");
+}
+
+inline uint64_t read_u64(std::FILE* f){
+    uint64_t v;
+    read_bytes(f,&v,sizeof(v));
+    return v;
+}
+
+template<typename Item>
+void write_vector(std::FILE* f,const std::vector<Item>& v){
+    write_u64(f,v.size());
+    write_bytes(f,v.data(),v.size()*sizeof(Item));
+}
+
+template<typename Item>
+void read_vector(std::FILE* f,std::vector<Item>& v){
+    v.resize(read_u64(f));
+    read_bytes(f,v.data(),v.size()*sizeof(Item));
+}
+
+/**
+ * Атомарная запись: во временный файл рядом, fsync, затем rename поверх старого файла.
+ * При сбое на любом шаге на диске остаётся предыдущий целый файл.
+ */
+template<typename WriteFn>
+void atomic_write(const std::string& path,WriteFn write){
+    std::string tmp=path+".tmp";
+    std::FILE* f=std::fopen(tmp.c_str(),"wb");
+    if(!f) throw std::runtime_error("Checkpoint: не удалось открыть "+tmp);
+    try{
+        write(f);
+        if(std::fflush(f)!=0||::fsync(fileno(f))!=0) throw std::runtime_error("Checkpoint: ошибка fsync");
+    }catch(...){
+        std::fclose(f);
+        std::remove(tmp.c_str());
+        throw;
+    }
+    std::fclose(f);
+    if(std::rename(tmp.c_str(),path.c_str())!=0) throw std::runtime_error("Checkpoint: не удалось переименовать "+tmp);
+}
+
+} // namespace checkpoint_detail
+
+template<typename T>
+void save_snapshot(const TrainingSnapshot<T>& s,const std::string& path){
+    using namespace checkpoint_detail;
+    atomic_write(path,[&](std::FILE* f){
+        write_bytes(f,magic,sizeof(magic));
+        write_u64(f,sizeof(T));
+        write_u64(f,s.next_epoch);
+        write_bytes(f,&s.best_loss,sizeof(T));
+        write_u64(f,s.wait);
+        write_u64(f,s.rng_state.size());
+        write_bytes(f,s.rng_state.data(),s.rng_state.size());
+        write_u64(f,s.indices.size());
+        for(size_t idx: s.indices) write_u64(f,idx);
+        write_u64(f,s.tensors.size());
+        for(auto &t: s.tensors){
+            write_u64(f,t.size());
+            write_bytes(f,t.data(),t.size()*sizeof(T));
+        }
+        write_vector(f,s.sampler_history);
+        write_u64(f,s.sampler_next);
+        write_u64(f,s.masks.size());
+        for(size_t i=0;i<s.masks.size();++i){
+            write_vector(f,s.masks[i]);
+            write_vector(f,s.bias_masks[i]);
+        }
+    });
+}
+
+// false, если файла нет; исключение, если файл есть, но не читается
+template<typename T>
+bool load_snapshot(const std::string& path,TrainingSnapshot<T>& s){
+    using namespace checkpoint_detail;
+    std::FILE* f=std::fopen(path.c_str(),"rb");
+    if(!f) return false;
+    try{
+        char header[sizeof(magic)];
+        read_bytes(f,header,sizeof(header));
+        bool v1=std::equal(header,header+sizeof(header),magic_v1);
+        if(!v1&&!std::equal(header,header+sizeof(header),magic)) throw std::runtime_error("Checkpoint: неизвестный формат "+path);
+        if(read_u64(f)!=sizeof(T)) throw std::runtime_error("Checkpoint: другой тип скаляра");
+        s.next_epoch=read_u64(f);
+        read_bytes(f,&s.best_loss,sizeof(T));
+        s.wait=read_u64(f);
+        s.rng_state.resize(read_u64(f));
+        read_bytes(f,&s.rng_state[0],s.rng_state.size());
+        s.indices.resize(read_u64(f));
+        for(auto &idx: s.indices) idx=read_u64(f);
+        s.tensors.resize(read_u64(f));
+        for(auto &t: s.tensors){
+            t.resize(read_u64(f));
+            read_bytes(f,t.data(),t.size()*sizeof(T));
+        }
+        if(!v1){
+            read_vector(f,s.sampler_history);
+            s.sampler_next=read_u64(f);
+            s.masks.resize(read_u64(f));
+            s.bias_masks.resize(s.masks.size());
+            for(size_t i=0;i<s.masks.size();++i){
+                read_vector(f,s.masks[i]);
+                read_vector(f,s.bias_masks[i]);
+            }
+        }
+    }catch(...){
+        std::fclose(f);
+        throw;
+    }
+    std::fclose(f);
+    return true;
+}
+
+/**
+ * CheckpointWriter: пишет снимки в фоновом потоке, обучение на диске не ждёт.
+ * Ожидающий снимок один: если новый приходит, пока пишется предыдущий,
+ * более старый неписаный снимок заменяется - на диске важен только последний.
+ */
+template<typename T>
+class CheckpointWriter {
+private:
+    std::string path_;
+    std::shared_ptr<const TrainingSnapshot<T>> pending_;
+    bool writing_=false;
+    bool stop_=false;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    void loop(){
+        std::unique_lock<std::mutex> lock(mtx_);
+        while(true){
+            cv_.wait(lock,[this](){ return stop_||pending_; });
+            if(!pending_) return;
+            std::shared_ptr<const TrainingSnapshot<T>> snapshot=std::move(pending_);
+            pending_.reset();
+            writing_=true;
+            lock.unlock();
+            try{
+                save_snapshot(*snapshot,path_);
+            }catch(const std::exception& ex){
+                Logger::error(std::string("Checkpoint: ")+ex.what());
+            }
+            lock.lock();
+            writing_=false;
+            cv_.notify_all();
+        }
+    }
+
+public:
+    explicit CheckpointWriter(const std::string& path) : path_(path) {
+        thread_=std::thread(&CheckpointWriter::loop,this);
+    }
+
+    ~CheckpointWriter(){
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_=true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    CheckpointWriter(const CheckpointWriter&)=delete;
+    CheckpointWriter& operator=(const CheckpointWriter&)=delete;
+
+    void submit(TrainingSnapshot<T>&& snapshot){
+        std::shared_ptr<const TrainingSnapshot<T>> s=std::make_shared<const TrainingSnapshot<T>>(std::move(snapshot));
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            pending_=std::move(s);
+        }
+        cv_.notify_all();
+    }
+
+    // Дождаться записи всего, что уже отдано
+    void flush(){
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock,[this](){ return !pending_&&!writing_; });
+    }
+};
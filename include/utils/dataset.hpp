@@ -4,6 +4,17 @@
 #include <string>
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+
+// Целые в заголовках IDX хранятся big-endian
+inline bool read_idx_int(std::istream& f,int32_t& val){
+    unsigned char b[4];
+    if(!f.read((char*)b,4)) return false;
+    val=(int32_t)(((uint32_t)b[0]<<24)|((uint32_t)b[1]<<16)|((uint32_t)b[2]<<8)|(uint32_t)b[3]);
+    return true;
+}
 
 struct MNISTImage {
     Matrix<float> pixels; // 28x28
@@ -58,18 +69,47 @@ public:
     }
 
 private:
-    static int32_t reverse_int(int32_t i){
-        unsigned char c1,c2,c3,c4;
-        c1=i&255;
-        c2=(i>>8)&255;
-        c3=(i>>16)&255;
-        c4=(i>>24)&255;
-        return ((int32_t)c1<<24)+((int32_t)c2<<16)+((int32_t)c3<<8)+c4;
+    static bool read_int(std::ifstream &f,int32_t &val){ return read_idx_int(f,val); }
+};
+
+/**
+ * IdxImageStream: последовательное чтение файла изображений IDX (magic 2051) кусками,
+ * без загрузки всего файла в память. read() отдаёт сырые байты пикселей [count x rows*cols].
+ */
+class IdxImageStream {
+private:
+    std::ifstream file_;
+    size_t num_images_=0;
+    size_t rows_=0;
+    size_t cols_=0;
+    size_t consumed_=0;
+
+public:
+    explicit IdxImageStream(const std::string& path) : file_(path,std::ios::binary) {
+        if(!file_.is_open()) throw std::runtime_error("Не удалось открыть файл изображений: "+path);
+        int32_t magic=0,count=0,rows=0,cols=0;
+        if(!read_idx_int(file_,magic)||magic!=2051)
+            throw std::runtime_error("Неверный магический номер для изображений: "+path);
+        if(!read_idx_int(file_,count)||!read_idx_int(file_,rows)||!read_idx_int(file_,cols)||count<0||rows<=0||cols<=0)
+            throw std::runtime_error("Повреждён заголовок IDX: "+path);
+        num_images_=(size_t)count;
+        rows_=(size_t)rows;
+        cols_=(size_t)cols;
     }
 
-    static bool read_int(std::ifstream &f,int32_t &val){
-        if(!f.read((char*)&val,4)) return false;
-        val=reverse_int(val);
-        return true;
+    size_t num_images() const { return num_images_; }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t image_size() const { return rows_*cols_; }
+    size_t remaining() const { return num_images_-consumed_; }
+
+    // Следующие min(max_images, remaining()) изображений; 0 - файл прочитан
+    size_t read(size_t max_images,std::vector<unsigned char>& pixels){
+        size_t count=std::min(max_images,remaining());
+        pixels.resize(count*image_size());
+        if(count>0&&!file_.read((char*)pixels.data(),(std::streamsize)pixels.size()))
+            throw std::runtime_error("Файл IDX обрезан на изображении "+std::to_string(consumed_));
+        consumed_+=count;
+        return count;
     }
-};
\ No newline at end of file
+};
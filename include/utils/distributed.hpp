@@ -0,0 +1,209 @@
+#pragma once
+#include "../layers/layer.hpp"
+#include "bounded_queue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Параметры процесса в распределённом обучении (data parallel).
+ * address: "host:port" - процесс rank слушает port+rank, соседи на том же host;
+ * "host0:port0,host1:port1,..." - свой адрес на каждый rank (разные машины);
+ * "unix:/path" - Unix-сокеты /path.<rank> (несколько процессов на одной машине).
+ */
+struct DistributedConfig {
+    size_t rank=0;
+    size_t world_size=1;
+    std::string address="127.0.0.1:29500";
+    // Сколько ждать запуска соседей при установке кольца
+    double connect_timeout_s=60.0;
+
+    // CNN_RANK, CNN_WORLD_SIZE, CNN_MASTER_ADDR; без них - один процесс
+    static DistributedConfig from_env();
+};
+
+/**
+ * Кольцо процессов: у каждого одно соединение к следующему (rank+1) и одно от предыдущего.
+ * Коллективные операции блокирующие и должны вызываться всеми процессами в одном порядке.
+ */
+class RingCommunicator {
+private:
+    size_t rank_;
+    size_t world_size_;
+    int next_fd_=-1;
+    int prev_fd_=-1;
+
+    void send_all(const void* data,size_t bytes);
+    void recv_all(void* data,size_t bytes);
+    // Отправка следующему и приём от предыдущего одновременно (через poll, без взаимной блокировки)
+    void exchange(const void* send,size_t send_bytes,void* recv,size_t recv_bytes);
+
+public:
+    explicit RingCommunicator(const DistributedConfig& config);
+    ~RingCommunicator();
+
+    RingCommunicator(const RingCommunicator&)=delete;
+    RingCommunicator& operator=(const RingCommunicator&)=delete;
+
+    size_t rank() const { return rank_; }
+    size_t world_size() const { return world_size_; }
+
+    /**
+     * Сумма по всем процессам на месте: reduce-scatter и all-gather по кольцу.
+     * Каждый процесс передаёт 2*(N-1)/N объёма данных независимо от числа процессов.
+     */
+    template<typename T>
+    void allreduce_sum(T* data,size_t n){
+        if(world_size_==1||n==0) return;
+        size_t w=world_size_;
+        auto chunk_begin=[&](size_t c){ return n*c/w; };
+        std::vector<T> incoming(n/w+1);
+        for(size_t step=0;step+1<w;++step){
+            size_t send_c=(rank_+w-step)%w;
+            size_t recv_c=(rank_+w-step-1)%w;
+            size_t send_n=chunk_begin(send_c+1)-chunk_begin(send_c);
+            size_t recv_n=chunk_begin(recv_c+1)-chunk_begin(recv_c);
+            exchange(data+chunk_begin(send_c),send_n*sizeof(T),incoming.data(),recv_n*sizeof(T));
+            T* dst=data+chunk_begin(recv_c);
+            for(size_t i=0;i<recv_n;++i) dst[i]+=incoming[i];
+        }
+        // После reduce-scatter у процесса полностью просуммирован кусок rank+1
+        for(size_t step=0;step+1<w;++step){
+            size_t send_c=(rank_+1+w-step)%w;
+            size_t recv_c=(rank_+w-step)%w;
+            size_t send_n=chunk_begin(send_c+1)-chunk_begin(send_c);
+            size_t recv_n=chunk_begin(recv_c+1)-chunk_begin(recv_c);
+            exchange(data+chunk_begin(send_c),send_n*sizeof(T),data+chunk_begin(recv_c),recv_n*sizeof(T));
+        }
+    }
+
+    // Копия данных процесса root у всех (передача по кольцу)
+    void broadcast(void* data,size_t bytes,size_t root=0);
+
+    template<typename T>
+    void broadcast(T* data,size_t n,size_t root=0){ broadcast((void*)data,n*sizeof(T),root); }
+
+    void barrier();
+};
+
+/**
+ * Усреднение градиентов между процессами с перекрытием backward.
+ * add() вызывается после backward слоя (Network::set_backward_hook): градиенты слоя дописываются
+ * в текущую корзину, заполненная корзина уходит фоновому потоку, который делает allreduce,
+ * пока backward идёт по предыдущим слоям. finish() отправляет остаток и ждёт всех корзин.
+ * Порядок слоёв одинаков во всех процессах, поэтому корзины совпадают без согласования.
+ */
+template<typename T>
+class GradientAllReducer {
+private:
+    struct Bucket {
+        std::vector<ParameterView<T>> views;
+        size_t elements=0;
+    };
+
+    RingCommunicator& comm_;
+    size_t bucket_elements_;
+    Bucket current_;
+    BoundedQueue<Bucket> queue_;
+    size_t submitted_=0;
+    size_t completed_=0;
+    std::exception_ptr error_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    double comm_ms_=0;
+
+    void reduce(Bucket& bucket,std::vector<T>& flat){
+        flat.resize(bucket.elements);
+        size_t offset=0;
+        for(auto &v: bucket.views){
+            std::copy(v.data,v.data+v.size,flat.begin()+offset);
+            offset+=v.size;
+        }
+        comm_.allreduce_sum(flat.data(),flat.size());
+        T scale=T(1)/(T)comm_.world_size();
+        offset=0;
+        for(auto &v: bucket.views){
+            for(size_t i=0;i<v.size;++i) v.data[i]=flat[offset+i]*scale;
+            offset+=v.size;
+        }
+    }
+
+    void loop(){
+        std::vector<T> flat;
+        Bucket bucket;
+        while(queue_.pop(bucket)){
+            auto start=std::chrono::steady_clock::now();
+            std::exception_ptr error;
+            try{
+                reduce(bucket,flat);
+            }catch(...){
+                error=std::current_exception();
+            }
+            double ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(error&&!error_) error_=error;
+            comm_ms_+=ms;
+            ++completed_;
+            cv_.notify_all();
+        }
+    }
+
+    void submit(){
+        if(current_.views.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++submitted_;
+        }
+        queue_.push(std::move(current_));
+        current_=Bucket();
+    }
+
+public:
+    explicit GradientAllReducer(RingCommunicator& comm,size_t bucket_bytes=1<<20)
+        : comm_(comm), bucket_elements_(std::max<size_t>(1,bucket_bytes/sizeof(T))), queue_(64) {
+        thread_=std::thread(&GradientAllReducer::loop,this);
+    }
+
+    ~GradientAllReducer(){
+        queue_.close();
+        thread_.join();
+    }
+
+    GradientAllReducer(const GradientAllReducer&)=delete;
+    GradientAllReducer& operator=(const GradientAllReducer&)=delete;
+
+    // Буферы должны жить и не меняться до finish()
+    void add(const std::vector<ParameterView<T>>& gradients){
+        for(auto &v: gradients){
+            if(v.size==0) continue;
+            current_.views.push_back(v);
+            current_.elements+=v.size;
+        }
+        if(current_.elements>=bucket_elements_) submit();
+    }
+
+    // После finish() все градиенты усреднены по процессам
+    void finish(){
+        submit();
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock,[this](){ return completed_==submitted_; });
+        if(error_){
+            std::exception_ptr error=error_;
+            error_=nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Суммарное время фонового обмена (перекрытое с backward)
+    double communication_ms(){
+        std::lock_guard<std::mutex> lock(mtx_);
+        return comm_ms_;
+    }
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#if defined(__F16C__) || defined(__AVX2__) || defined(__AVX512BF16__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Форматы хранения активаций. Вычисления и веса всегда остаются в T (fp32),
+ * понижается только точность тензоров, которые слои держат до backward.
+ */
+enum class Precision {
+    FP32,
+    BF16,
+    FP16
+};
+
+namespace half_precision {
+
+inline uint16_t float_to_bf16(float f){
+    uint32_t x;
+    std::memcpy(&x,&f,4);
+    if((x&0x7fffffffu)>0x7f800000u) return (uint16_t)((x>>16)|0x40); // quiet NaN
+    x+=0x7fffu+((x>>16)&1u); // round to nearest even
+    return (uint16_t)(x>>16);
+}
+
+inline float bf16_to_float(uint16_t h){
+    uint32_t x=(uint32_t)h<<16;
+    float f;
+    std::memcpy(&f,&x,4);
+    return f;
+}
+
+inline uint16_t float_to_fp16(float f){
+    uint32_t x;
+    std::memcpy(&x,&f,4);
+    uint32_t sign=(x>>16)&0x8000u;
+    uint32_t mant=x&0x7fffffu;
+    int32_t exp=(int32_t)((x>>23)&0xff);
+    if(exp==0xff) return (uint16_t)(sign|0x7c00u|(mant?0x200u:0u));
+    int32_t e=exp-127+15;
+    if(e>=0x1f) return (uint16_t)(sign|0x7c00u); // переполнение -> inf
+    if(e<=0){
+        // субнормальные fp16
+        if(e<-10) return (uint16_t)sign;
+        mant|=0x800000u;
+        uint32_t shift=(uint32_t)(14-e);
+        uint32_t h=mant>>shift;
+        uint32_t rem=mant&((1u<<shift)-1);
+        uint32_t halfway=1u<<(shift-1);
+        if(rem>halfway||(rem==halfway&&(h&1u))) ++h;
+        return (uint16_t)(sign|h);
+    }
+    uint32_t h=sign|((uint32_t)e<<10)|(mant>>13);
+    uint32_t rem=mant&0x1fffu;
+    if(rem>0x1000u||(rem==0x1000u&&(h&1u))) ++h; // перенос в экспоненту корректен
+    return (uint16_t)h;
+}
+
+inline float fp16_to_float(uint16_t h){
+    uint32_t sign=((uint32_t)h&0x8000u)<<16;
+    uint32_t exp=((uint32_t)h>>10)&0x1fu;
+    uint32_t mant=(uint32_t)h&0x3ffu;
+    uint32_t bits;
+    if(exp==0){
+        if(mant==0){
+            bits=sign;
+        } else {
+            int32_t e=1;
+            while(!(mant&0x400u)){ mant<<=1; --e; }
+            mant&=0x3ffu;
+            bits=sign|((uint32_t)(e+112)<<23)|(mant<<13);
+        }
+    } else if(exp==0x1f){
+        bits=sign|0x7f800000u|(mant<<13);
+    } else {
+        bits=sign|((exp+112)<<23)|(mant<<13);
+    }
+    float f;
+    std::memcpy(&f,&bits,4);
+    return f;
+}
+
+inline void pack(const float* src,uint16_t* dst,size_t n,Precision p){
+    size_t i=0;
+    if(p==Precision::BF16){
+#if defined(__AVX512BF16__)
+        for(;i+16<=n;i+=16){
+            __m256bh v=_mm512_cvtneps_pbh(_mm512_loadu_ps(src+i));
+            _mm256_storeu_si256((__m256i*)(dst+i),(__m256i)v);
+        }
+#endif
+        for(;i<n;++i) dst[i]=float_to_bf16(src[i]);
+    } else {
+#if defined(__F16C__)
+        for(;i+8<=n;i+=8){
+            __m128i v=_mm256_cvtps_ph(_mm256_loadu_ps(src+i),_MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128((__m128i*)(dst+i),v);
+        }
+#endif
+        for(;i<n;++i) dst[i]=float_to_fp16(src[i]);
+    }
+}
+
+inline void unpack(const uint16_t* src,float* dst,size_t n,Precision p){
+    size_t i=0;
+    if(p==Precision::BF16){
+#if defined(__AVX2__)
+        for(;i+8<=n;i+=8){
+            __m256i w=_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src+i)));
+            _mm256_storeu_ps(dst+i,_mm256_castsi256_ps(_mm256_slli_epi32(w,16)));
+        }
+#endif
+        for(;i<n;++i) dst[i]=bf16_to_float(src[i]);
+    } else {
+#if defined(__F16C__)
+        for(;i+8<=n;i+=8){
+            _mm256_storeu_ps(dst+i,_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src+i))));
+        }
+#endif
+        for(;i<n;++i) dst[i]=fp16_to_float(src[i]);
+    }
+}
+
+// Для T=double идём через float поэлементно
+inline void pack(const double* src,uint16_t* dst,size_t n,Precision p){
+    for(size_t i=0;i<n;++i){
+        dst[i]=(p==Precision::BF16)?float_to_bf16((float)src[i]):float_to_fp16((float)src[i]);
+    }
+}
+
+inline void unpack(const uint16_t* src,double* dst,size_t n,Precision p){
+    for(size_t i=0;i<n;++i){
+        dst[i]=(p==Precision::BF16)?bf16_to_float(src[i]):fp16_to_float(src[i]);
+    }
+}
+
+} // namespace half_precision
@@ -0,0 +1,193 @@
+#pragma once
+#include "../network.hpp"
+#include "batch_loader.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Без ограничения отставания (классический Hogwild)
+const size_t hogwild_unbounded_staleness=std::numeric_limits<size_t>::max();
+
+// Суммы метрик по шагам эпохи
+struct StepMetrics {
+    double loss=0;
+    double accuracy=0;
+    double f1=0;
+    double auc=0;
+};
+
+/**
+ * HogwildExecutor: асинхронный SGD без блокировок на общих весах.
+ * У каждого потока своя реплика сети (кэши forward/backward не разделяются). Шаг потока:
+ * снять копию общих весов в реплику, forward/backward на своём батче, обновление реплики
+ * её же правилом (apply_gradients: weight decay, маска прунинга) и прибавление разницы
+ * "после - до" к общим весам. Чтение и запись общих весов - relaxed-атомарные поэлементно,
+ * без блокировок: одновременные обновления одного веса могут потеряться, как в Hogwild.
+ *
+ * max_staleness ограничивает отставание (stale synchronous parallel): поток не начинает шаг,
+ * пока опережает самый медленный из работающих потоков больше чем на max_staleness шагов.
+ */
+template<typename T>
+class HogwildExecutor {
+private:
+    Network<T>& master_;
+    std::vector<ParameterView<T>> master_params_;
+    std::vector<std::unique_ptr<Network<T>>> replicas_;
+    std::vector<std::vector<T>> base_;  // веса, с которых реплика начала шаг
+    size_t max_staleness_;
+
+    // Шаги потоков в текущей эпохе; завершившие поток не ждут
+    std::vector<size_t> clocks_;
+    std::vector<bool> done_;
+    std::mutex clock_mtx_;
+    std::condition_variable clock_cv_;
+    size_t stale_waits_=0;
+
+    static T load(const T* p){
+        T v;
+        __atomic_load(p,&v,__ATOMIC_RELAXED);
+        return v;
+    }
+
+    static void store(T* p,T v){
+        __atomic_store(p,&v,__ATOMIC_RELAXED);
+    }
+
+    void pull(size_t w){
+        std::vector<ParameterView<T>> views=replicas_[w]->parameters();
+        T* base=base_[w].data();
+        for(size_t v=0;v<views.size();++v){
+            const T* src=master_params_[v].data;
+            for(size_t i=0;i<views[v].size;++i) base[i]=load(src+i);
+            std::copy(base,base+views[v].size,views[v].data);
+            base+=views[v].size;
+        }
+    }
+
+    void push(size_t w){
+        std::vector<ParameterView<T>> views=replicas_[w]->parameters();
+        const T* base=base_[w].data();
+        for(size_t v=0;v<views.size();++v){
+            T* dst=master_params_[v].data;
+            const T* updated=views[v].data;
+            for(size_t i=0;i<views[v].size;++i){
+                T delta=updated[i]-base[i];
+                if(delta!=0) store(dst+i,load(dst+i)+delta);
+            }
+            base+=views[v].size;
+        }
+    }
+
+    void wait_turn(size_t w){
+        if(max_staleness_==hogwild_unbounded_staleness) return;
+        std::unique_lock<std::mutex> lock(clock_mtx_);
+        auto allowed=[&](){
+            size_t slowest=std::numeric_limits<size_t>::max();
+            for(size_t i=0;i<clocks_.size();++i) if(!done_[i]) slowest=std::min(slowest,clocks_[i]);
+            return clocks_[w]<=slowest+max_staleness_;
+        };
+        if(!allowed()){
+            ++stale_waits_;
+            clock_cv_.wait(lock,allowed);
+        }
+    }
+
+    void advance(size_t w,bool finished){
+        {
+            std::lock_guard<std::mutex> lock(clock_mtx_);
+            if(finished) done_[w]=true;
+            else ++clocks_[w];
+        }
+        clock_cv_.notify_all();
+    }
+
+public:
+    HogwildExecutor(Network<T>& master,const std::function<std::unique_ptr<Network<T>>()>& factory,
+                    size_t num_threads,size_t max_staleness=hogwild_unbounded_staleness)
+        : master_(master), max_staleness_(max_staleness) {
+        num_threads=std::max<size_t>(1,num_threads);
+        master_params_=master_.parameters();
+        for(size_t w=0;w<num_threads;++w){
+            std::unique_ptr<Network<T>> replica=factory();
+            std::vector<ParameterView<T>> views=replica->parameters();
+            if(views.size()!=master_params_.size())
+                throw std::runtime_error("HogwildExecutor: реплика не совпадает с сетью по структуре");
+            size_t total=0;
+            for(size_t v=0;v<views.size();++v){
+                if(views[v].size!=master_params_[v].size)
+                    throw std::runtime_error("HogwildExecutor: реплика не совпадает с сетью по размерам");
+                total+=views[v].size;
+            }
+            replica->set_accumulate_gradients(true);
+            base_.emplace_back(total);
+            replicas_.push_back(std::move(replica));
+        }
+    }
+
+    size_t num_threads() const { return replicas_.size(); }
+    // Сколько раз потоки ждали из-за max_staleness (за всё время)
+    size_t stale_waits() const { return stale_waits_; }
+
+    /**
+     * Эпоха: потоки разбирают батчи loader и обновляют общие веса.
+     * step(replica,batch) делает forward, лосс и backward реплики (градиенты копятся в ней),
+     * возвращает метрики батча. Результат - суммы метрик по всем батчам.
+     */
+    template<typename Step>
+    StepMetrics run_epoch(BatchLoader<T>& loader,T learning_rate,T lambda,Step step){
+        size_t n=replicas_.size();
+        clocks_.assign(n,0);
+        done_.assign(n,false);
+        for(auto &r: replicas_) r->set_training(true);
+
+        std::mutex mtx;  // loader, сумма метрик, первая ошибка
+        StepMetrics total;
+        std::exception_ptr error;
+        std::atomic<bool> failed{false};
+
+        auto worker=[&](size_t w){
+            try{
+                while(!failed.load(std::memory_order_relaxed)){
+                    Batch<T> batch;
+                    {
+                        std::lock_guard<std::mutex> lock(mtx);
+                        if(!loader.next(batch)) break;
+                    }
+                    wait_turn(w);
+                    pull(w);
+                    StepMetrics m=step(*replicas_[w],batch);
+                    replicas_[w]->apply_gradients(learning_rate,lambda);
+                    push(w);
+                    advance(w,false);
+                    std::lock_guard<std::mutex> lock(mtx);
+                    total.loss+=m.loss;
+                    total.accuracy+=m.accuracy;
+                    total.f1+=m.f1;
+                    total.auc+=m.auc;
+                }
+            }catch(...){
+                std::lock_guard<std::mutex> lock(mtx);
+                if(!error) error=std::current_exception();
+                failed=true;
+            }
+            advance(w,true);
+        };
+
+        std::vector<std::thread> threads;
+        for(size_t w=1;w<n;++w) threads.emplace_back(worker,w);
+        worker(0);
+        for(auto &t: threads) t.join();
+        // Производные кэши общей сети (CSR, Winograd) пересчитаются от новых весов
+        master_params_=master_.parameters();
+        if(error) std::rethrow_exception(error);
+        return total;
+    }
+};
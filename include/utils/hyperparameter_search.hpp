@@ -0,0 +1,250 @@
+#pragma once
+#include "../trainer.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+struct HyperparameterConfig {
+    float learning_rate=0.001f;
+    size_t batch_size=64;
+    float lambda=0.0001f;
+    size_t patience=5;
+};
+
+// Диапазоны для случайного поиска: learning_rate и lambda сэмплируются лог-равномерно
+struct SearchSpace {
+    float learning_rate_min=1e-4f;
+    float learning_rate_max=1e-1f;
+    std::vector<size_t> batch_sizes{32,64,128};
+    float lambda_min=1e-6f;
+    float lambda_max=1e-2f;
+    std::vector<size_t> patiences{3,5,10};
+};
+
+struct TrialResult {
+    size_t id=0;
+    HyperparameterConfig config;
+    size_t rung=0;
+    size_t epochs=0;          // реально пройденные эпохи (меньше бюджета после ранней остановки)
+    bool stopped_early=false;
+    float val_loss=0.0f;
+    float val_accuracy=0.0f;
+    double seconds=0.0;
+};
+
+/**
+ * HyperparameterSearch: параллельный перебор конфигураций Trainer на одном наборе данных в памяти.
+ * Successive halving: все испытания обучаются min_epochs эпох, лучшие 1/eta продолжают
+ * с бюджетом в eta раз больше и т.д. Испытания одного раунда разбирают потоки по мере
+ * освобождения, так что ядра отсеянных испытаний сразу уходят оставшимся.
+ * Ранняя остановка (patience) продолжается между раундами; остановившееся испытание
+ * дальше не обучается и сравнивается по последней оценке.
+ * Все раунды всех испытаний пишутся в один CSV. Первое исключение испытания
+ * останавливает раунд и пробрасывается из successive_halving.
+ */
+template<typename T>
+class HyperparameterSearch {
+public:
+    using NetworkFactory=std::function<std::unique_ptr<Network<T>>()>;
+
+private:
+    struct Trial {
+        TrialResult result;
+        std::unique_ptr<Network<T>> net;
+        Trainer<T> trainer;
+    };
+
+    NetworkFactory factory_;
+    const Matrix<T>& X_train_;
+    const Matrix<T>& Y_train_;
+    const Matrix<T>& X_val_;
+    const Matrix<T>& Y_val_;
+    LossFunction loss_fn_;
+    size_t num_threads_;
+    std::ofstream csv_;
+    std::mutex csv_mtx_;
+    size_t next_id_=0;
+
+public:
+    HyperparameterSearch(NetworkFactory factory,
+                         const Matrix<T>& X_train,const Matrix<T>& Y_train,
+                         const Matrix<T>& X_val,const Matrix<T>& Y_val,
+                         const std::string& csv_path="hyperparameter_search.csv",
+                         LossFunction loss_fn=LossFunction::CrossEntropy,size_t num_threads=0)
+        : factory_(std::move(factory)), X_train_(X_train), Y_train_(Y_train), X_val_(X_val), Y_val_(Y_val),
+          loss_fn_(loss_fn), num_threads_(num_threads>0?num_threads:std::max(1u,std::thread::hardware_concurrency())) {
+        csv_.open(csv_path,std::ios::out);
+        if(!csv_.is_open()) throw std::runtime_error("HyperparameterSearch: не удалось открыть "+csv_path);
+        csv_<<"Trial,Rung,Epochs,Stopped_Early,Learning_Rate,Batch_Size,Lambda,Patience,Val_Loss,Val_Accuracy,Seconds\n";
+    }
+
+    static std::vector<HyperparameterConfig> random_configs(const SearchSpace& space,size_t count,unsigned seed){
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> unit(0.0f,1.0f);
+        auto log_uniform=[&](float lo,float hi){
+            return std::exp(std::log(lo)+unit(gen)*(std::log(hi)-std::log(lo)));
+        };
+        std::vector<HyperparameterConfig> configs;
+        for(size_t i=0;i<count;++i){
+            HyperparameterConfig c;
+            c.learning_rate=log_uniform(space.learning_rate_min,space.learning_rate_max);
+            c.lambda=log_uniform(space.lambda_min,space.lambda_max);
+            c.batch_size=space.batch_sizes[gen()%space.batch_sizes.size()];
+            c.patience=space.patiences[gen()%space.patiences.size()];
+            configs.push_back(c);
+        }
+        return configs;
+    }
+
+    static std::vector<HyperparameterConfig> grid_configs(const std::vector<float>& learning_rates,
+                                                          const std::vector<size_t>& batch_sizes,
+                                                          const std::vector<float>& lambdas,
+                                                          const std::vector<size_t>& patiences){
+        std::vector<HyperparameterConfig> configs;
+        for(float lr: learning_rates)
+            for(size_t bs: batch_sizes)
+                for(float l: lambdas)
+                    for(size_t p: patiences){
+                        HyperparameterConfig c;
+                        c.learning_rate=lr;
+                        c.batch_size=bs;
+                        c.lambda=l;
+                        c.patience=p;
+                        configs.push_back(c);
+                    }
+        return configs;
+    }
+
+    TrialResult successive_halving(const std::vector<HyperparameterConfig>& configs,
+                                   size_t min_epochs,size_t max_epochs,size_t eta=3){
+        if(configs.empty()) throw std::runtime_error("HyperparameterSearch: пустой список конфигураций");
+        if(eta<2) eta=2;
+        std::vector<std::unique_ptr<Trial>> alive;
+        for(auto &c: configs){
+            std::unique_ptr<Trial> trial(new Trial());
+            trial->result.id=next_id_++;
+            trial->result.config=c;
+            trial->net=factory_();
+            trial->trainer.set_epoch_logging(false);
+            trial->trainer.set_carry_early_stopping(true);
+            alive.push_back(std::move(trial));
+        }
+
+        size_t budget=std::max<size_t>(1,min_epochs);
+        for(size_t rung=0;;++rung){
+            run_rung(alive,rung,budget);
+            std::sort(alive.begin(),alive.end(),[](const std::unique_ptr<Trial>& a,const std::unique_ptr<Trial>& b){
+                return a->result.val_accuracy>b->result.val_accuracy;
+            });
+            Logger::info("Successive halving rung "+std::to_string(rung)+": "+std::to_string(alive.size())+
+                         " trials, "+std::to_string(budget)+" epochs, best acc "+
+                         std::to_string(alive.front()->result.val_accuracy));
+            size_t keep=alive.size()/eta;
+            if(keep<1||budget>=max_epochs) break;
+            alive.resize(keep);
+            budget=std::min(max_epochs,budget*eta);
+        }
+        return alive.front()->result;
+    }
+
+    /**
+     * Hyperband: несколько запусков successive halving с разным соотношением
+     * "число конфигураций / стартовый бюджет", от агрессивного к консервативному.
+     */
+    TrialResult hyperband(const SearchSpace& space,size_t max_epochs,size_t eta=3,unsigned seed=42){
+        if(eta<2) eta=2;
+        size_t s_max=0;
+        while(std::pow((double)eta,(double)(s_max+1))<=(double)max_epochs) ++s_max;
+        TrialResult best;
+        bool have_best=false;
+        for(size_t s=s_max+1;s-->0;){
+            size_t n=(size_t)std::ceil((double)(s_max+1)/(double)(s+1)*std::pow((double)eta,(double)s));
+            size_t r=std::max<size_t>(1,(size_t)((double)max_epochs/std::pow((double)eta,(double)s)));
+            TrialResult result=successive_halving(random_configs(space,n,seed+(unsigned)s),r,max_epochs,eta);
+            if(!have_best||result.val_accuracy>best.val_accuracy){
+                best=result;
+                have_best=true;
+            }
+        }
+        return best;
+    }
+
+private:
+    // Доучивает каждое испытание до budget эпох; потоки берут испытания по одному из общего счётчика
+    void run_rung(std::vector<std::unique_ptr<Trial>>& trials,size_t rung,size_t budget){
+        std::atomic<size_t> next(0);
+        std::mutex error_mtx;
+        std::exception_ptr error;
+        std::atomic<bool> failed{false};
+        auto worker=[&](){
+            while(!failed.load(std::memory_order_relaxed)){
+                size_t i=next.fetch_add(1);
+                if(i>=trials.size()) return;
+                try{
+                    run_trial(*trials[i],rung,budget);
+                }catch(...){
+                    std::lock_guard<std::mutex> lock(error_mtx);
+                    if(!error) error=std::current_exception();
+                    failed=true;
+                }
+            }
+        };
+        size_t count=std::min(num_threads_,trials.size());
+        std::vector<std::thread> threads;
+        for(size_t t=1;t<count;++t) threads.emplace_back(worker);
+        worker();
+        for(auto &t: threads) t.join();
+        if(error) std::rethrow_exception(error);
+    }
+
+    void run_trial(Trial& trial,size_t rung,size_t budget){
+        size_t extra=budget>trial.result.epochs?budget-trial.result.epochs:0;
+        auto start=std::chrono::steady_clock::now();
+        if(extra>0&&!trial.result.stopped_early){
+            const HyperparameterConfig& c=trial.result.config;
+            trial.trainer.train(*trial.net,{X_train_},{Y_train_},extra,(T)c.learning_rate,c.batch_size,
+                                (T)c.lambda,c.patience,(T)1e-4,loss_fn_);
+            size_t ran=trial.trainer.last_epochs_run();
+            trial.result.epochs+=ran;
+            trial.result.stopped_early=trial.trainer.last_stopped_early();
+            // Trainer пишет ошибку эпохи в лог и выходит; недоученное испытание сравнивать нельзя
+            if(ran<extra&&!trial.result.stopped_early)
+                throw std::runtime_error("HyperparameterSearch: испытание "+std::to_string(trial.result.id)+
+                                         " прервано на эпохе "+std::to_string(trial.result.epochs)+" (см. лог)");
+        }
+        evaluate(trial);
+        trial.result.rung=rung;
+        trial.result.seconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        write_row(trial.result);
+    }
+
+    void evaluate(Trial& trial){
+        trial.net->set_training(false);
+        auto preds=trial.net->forward({X_val_});
+        trial.net->release_caches();
+        const Matrix<T>& p=preds[0];
+        trial.result.val_accuracy=Metrics<T>::accuracy(p,Y_val_);
+        trial.result.val_loss=(float)(loss_fn_==LossFunction::MSE?Trainer<T>::mse_loss(p,Y_val_)
+                                                                  :Trainer<T>::cross_entropy_loss(p,Y_val_));
+    }
+
+    void write_row(const TrialResult& r){
+        std::lock_guard<std::mutex> lock(csv_mtx_);
+        csv_<<r.id<<","<<r.rung<<","<<r.epochs<<","<<(r.stopped_early?1:0)<<","<<r.config.learning_rate<<","<<r.config.batch_size<<","
+            <<r.config.lambda<<","<<r.config.patience<<","<<r.val_loss<<","<<r.val_accuracy<<","<<r.seconds<<"\n";
+        csv_.flush();
+    }
+};
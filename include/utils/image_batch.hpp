@@ -0,0 +1,38 @@
+#pragma once
+#include "matrix.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Батч изображений для свёрточных слоёв: канал - матрица [N x H*W], строка n - изображение n
+ * построчно. Так батч проходит через слои, работающие по строкам (BatchNorm, Flatten, FC),
+ * а Flatten по строкам даёт тот же порядок признаков (канал, строка, столбец), что и один образец.
+ */
+namespace image_batch {
+
+// Каналы изображения n как матрицы H x W
+template<typename T>
+std::vector<Matrix<T>> sample(const std::vector<Matrix<T>>& batch,size_t n,size_t height,size_t width){
+    std::vector<Matrix<T>> image;
+    image.reserve(batch.size());
+    for(auto &ch: batch){
+        if(ch.cols()!=height*width||n>=ch.rows()) throw std::runtime_error("image_batch: размер канала не совпадает с изображением");
+        Matrix<T> m(height,width,0);
+        std::copy(ch.data()+n*ch.cols(),ch.data()+(n+1)*ch.cols(),m.data());
+        image.push_back(std::move(m));
+    }
+    return image;
+}
+
+// Пишет каналы изображения в строку n батча (батч уже нужного размера)
+template<typename T>
+void store(std::vector<Matrix<T>>& batch,size_t n,const std::vector<Matrix<T>>& image){
+    if(image.size()!=batch.size()) throw std::runtime_error("image_batch: число каналов не совпадает");
+    for(size_t c=0;c<image.size();++c){
+        if(image[c].size()!=batch[c].cols()) throw std::runtime_error("image_batch: размер изображения не совпадает");
+        std::copy(image[c].data(),image[c].data()+image[c].size(),batch[c].data()+n*batch[c].cols());
+    }
+}
+
+} // namespace image_batch
@@ -0,0 +1,191 @@
+#pragma once
+#include "../network.hpp"
+#include "../layers/fully_connected_layer.hpp"
+#include "metrics.hpp"
+#include "logger.hpp"
+#include <Eigen/SVD>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Сжатие FullyConnectedLayer усечённым SVD: W (in x out) = U S V^T ~ U_r S_r V_r^T.
+ * Слой заменяется парой без активации между ними: in -> r с весами U_r*sqrt(S_r) без смещения
+ * и r -> out с весами sqrt(S_r)*V_r^T и исходным смещением. Пара остаётся линейной, как исходный
+ * слой, а умножений на пример r*(in+out) вместо in*out - выигрыш при r < in*out/(in+out).
+ */
+namespace low_rank_detail {
+
+template<typename T>
+Eigen::BDCSVD<Eigen::MatrixXd> svd(const FullyConnectedLayer<T>& fc){
+    const Matrix<T>& w=fc.weights();
+    Eigen::MatrixXd m(w.rows(),w.cols());
+    for(size_t i=0;i<w.rows();++i){
+        for(size_t j=0;j<w.cols();++j) m(i,j)=(double)w.data()[i*w.cols()+j];
+    }
+    return Eigen::BDCSVD<Eigen::MatrixXd>(m,Eigen::ComputeThinU|Eigen::ComputeThinV);
+}
+
+} // namespace low_rank_detail
+
+// Сингулярные числа весов слоя по убыванию
+template<typename T>
+std::vector<T> fc_singular_values(const FullyConnectedLayer<T>& fc){
+    Eigen::VectorXd s=low_rank_detail::svd(fc).singularValues();
+    return std::vector<T>(s.data(),s.data()+s.size());
+}
+
+// Доля суммы квадратов сингулярных чисел, которую сохраняют первые rank
+template<typename T>
+T rank_energy(const std::vector<T>& singular_values,size_t rank){
+    double total=0,kept=0;
+    for(size_t i=0;i<singular_values.size();++i){
+        double s2=(double)singular_values[i]*singular_values[i];
+        total+=s2;
+        if(i<rank) kept+=s2;
+    }
+    return total>0?(T)(kept/total):(T)1;
+}
+
+// Минимальный ранг, сохраняющий долю energy (0..1]
+template<typename T>
+size_t rank_for_energy(const std::vector<T>& singular_values,T energy){
+    for(size_t r=1;r<=singular_values.size();++r){
+        if(rank_energy(singular_values,r)>=energy) return r;
+    }
+    return singular_values.size();
+}
+
+// Ранг, выше которого факторизация не уменьшает ни число весов, ни умножений
+inline size_t max_profitable_rank(size_t in,size_t out){
+    return in*out/(in+out);
+}
+
+/**
+ * Заменяет FullyConnectedLayer с позиции index парой слоёв ранга rank.
+ * Режим training новых слоёв - как у исходного. Возвращает исходный слой (для unfactorize_fc).
+ */
+template<typename T>
+std::unique_ptr<Layer<T>> factorize_fc(Network<T>& net,size_t index,size_t rank){
+    auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net.layer(index));
+    if(!fc) throw std::runtime_error("LowRank: слой "+std::to_string(index)+" не FullyConnected");
+    size_t in=fc->input_size(),out=fc->output_size();
+    if(rank==0||rank>std::min(in,out))
+        throw std::runtime_error("LowRank: ранг "+std::to_string(rank)+" вне 1.."+std::to_string(std::min(in,out)));
+
+    auto svd=low_rank_detail::svd(*fc);
+    const Eigen::MatrixXd& u=svd.matrixU();
+    const Eigen::MatrixXd& v=svd.matrixV();
+    const Eigen::VectorXd& s=svd.singularValues();
+    Matrix<T> first(in,rank,0),second(rank,out,0);
+    for(size_t k=0;k<rank;++k){
+        double root=std::sqrt(s(k));
+        for(size_t i=0;i<in;++i) first(i,k)=(T)(u(i,k)*root);
+        for(size_t j=0;j<out;++j) second(k,j)=(T)(v(j,k)*root);
+    }
+
+    std::unique_ptr<FullyConnectedLayer<T>> down(new FullyConnectedLayer<T>((int)in,(int)rank));
+    std::unique_ptr<FullyConnectedLayer<T>> up(new FullyConnectedLayer<T>((int)rank,(int)out));
+    down->set_parameters(first,Matrix<T>(1,rank,0));
+    up->set_parameters(second,fc->biases());
+    down->set_training(fc->is_training());
+    up->set_training(fc->is_training());
+
+    std::unique_ptr<Layer<T>> original=net.remove_layer(index);
+    net.insert_layer(index,std::move(up));
+    net.insert_layer(index,std::move(down));
+    return original;
+}
+
+// Возвращает исходный слой на место пары, вставленной factorize_fc
+template<typename T>
+void unfactorize_fc(Network<T>& net,size_t index,std::unique_ptr<Layer<T>> original){
+    net.remove_layer(index+1);
+    net.remove_layer(index);
+    net.insert_layer(index,std::move(original));
+}
+
+template<typename T>
+size_t parameter_bytes(Network<T>& net){
+    size_t total=0;
+    for(auto &v: net.parameters()) total+=v.size*sizeof(T);
+    return total;
+}
+
+struct LowRankReportRow {
+    size_t rank;        // 0 - исходный слой без факторизации
+    float energy;
+    float accuracy;
+    double forward_ms;  // лучшее из нескольких прогонов forward по всем входам
+    size_t model_bytes;
+};
+
+/**
+ * Ранг / точность / время forward / размер модели для факторизации слоя index.
+ * inputs - входы сети по очереди (весь батч одним входом или по образцу, как у свёрточной
+ * MNIST-сети); строки их выходов подряд сравниваются с Y. Первая строка - исходная сеть.
+ * fine_tune (если задан) дообучает сеть после каждой факторизации; все веса сети
+ * восстанавливаются после каждого замера и в конце.
+ */
+template<typename T>
+std::vector<LowRankReportRow> low_rank_report(Network<T>& net,size_t index,
+                                              const std::vector<std::vector<Matrix<T>>>& inputs,const Matrix<T>& Y,
+                                              const std::vector<size_t>& ranks,
+                                              const std::function<void(Network<T>&)>& fine_tune=nullptr,
+                                              size_t repeats=3){
+    auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net.layer(index));
+    if(!fc) throw std::runtime_error("LowRank: слой "+std::to_string(index)+" не FullyConnected");
+    std::vector<T> singular=fc_singular_values(*fc);
+
+    std::vector<std::vector<T>> snapshot;
+    for(auto &v: net.parameters()) snapshot.emplace_back(v.data,v.data+v.size);
+    auto restore=[&](){
+        std::vector<ParameterView<T>> views=net.parameters();
+        for(size_t i=0;i<views.size();++i) std::copy(snapshot[i].begin(),snapshot[i].end(),views[i].data);
+    };
+
+    auto measure=[&](size_t rank,float energy){
+        net.set_training(false);
+        LowRankReportRow row;
+        row.rank=rank;
+        row.energy=energy;
+        row.forward_ms=std::numeric_limits<double>::max();
+        Matrix<T> preds(Y.rows(),Y.cols(),0);
+        for(size_t r=0;r<std::max<size_t>(1,repeats);++r){
+            size_t offset=0;
+            auto start=std::chrono::steady_clock::now();
+            for(auto &in: inputs){
+                std::vector<Matrix<T>> out=net.forward(in);
+                if(out.size()!=1||out[0].cols()!=Y.cols()||offset+out[0].rows()>Y.rows())
+                    throw std::runtime_error("LowRank: выходы сети не совпадают с Y");
+                std::copy(out[0].data(),out[0].data()+out[0].size(),preds.data()+offset*Y.cols());
+                offset+=out[0].rows();
+            }
+            auto stop=std::chrono::steady_clock::now();
+            if(offset!=Y.rows()) throw std::runtime_error("LowRank: выходов сети меньше, чем строк Y");
+            row.forward_ms=std::min(row.forward_ms,std::chrono::duration<double,std::milli>(stop-start).count());
+        }
+        row.accuracy=Metrics<T>::accuracy(preds,Y);
+        row.model_bytes=parameter_bytes(net);
+        Logger::info(std::to_string(row.rank)+","+std::to_string(row.energy)+","+std::to_string(row.accuracy)+","+
+                     std::to_string(row.forward_ms)+","+std::to_string(row.model_bytes));
+        return row;
+    };
+
+    std::vector<LowRankReportRow> rows;
+    Logger::info("Rank,Energy,Accuracy,Forward_ms,Model_bytes");
+    rows.push_back(measure(0,1.0f));
+    for(size_t rank: ranks){
+        std::unique_ptr<Layer<T>> original=factorize_fc(net,index,rank);
+        if(fine_tune) fine_tune(net);
+        rows.push_back(measure(rank,(float)rank_energy(singular,rank)));
+        unfactorize_fc(net,index,std::move(original));
+        restore();
+    }
+    return rows;
+}
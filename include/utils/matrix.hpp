@@ -2,19 +2,75 @@
 #include <vector>
 #include <stdexcept>
 #include <iostream>
+#include "memory_tracker.hpp"
+#include "matrix_expr.hpp"
 
 template<typename T>
 class Matrix {
 private:
     size_t rows_;
     size_t cols_;
-    std::vector<T> data_;
+    // Через TrackingAllocator: память учитывается по слоям и фазам (MemoryTracker)
+    std::vector<T,TrackingAllocator<T>> data_;
+
+    template<typename E>
+    void check_shape(const E& e) const {
+        if(e.rows()!=rows_||e.cols()!=cols_) throw std::runtime_error("Matrix: dim mismatch");
+    }
 public:
     Matrix() : rows_(0), cols_(0) {}
     Matrix(size_t rows, size_t cols, T val=T()) : rows_(rows), cols_(cols), data_(rows*cols,val) {}
 
+    // Вычисление ленивого выражения (matrix_expr.hpp) одним проходом
+    template<typename E>
+    Matrix(const matrix_expr::Expr<E>& e) : rows_(e.self().rows()), cols_(e.self().cols()), data_(rows_*cols_) {
+        matrix_expr::eval(data_.data(),e.self(),[](T& d,T v){ d=v; });
+    }
+
+    template<typename E>
+    Matrix& operator=(const matrix_expr::Expr<E>& e){
+        const E& x=e.self();
+        if(x.rows()!=rows_||x.cols()!=cols_) return *this=Matrix(e);
+        matrix_expr::eval(data_.data(),x,[](T& d,T v){ d=v; });
+        return *this;
+    }
+
+    template<typename E>
+    Matrix& operator+=(const matrix_expr::Expr<E>& e){
+        check_shape(e.self());
+        matrix_expr::eval(data_.data(),e.self(),[](T& d,T v){ d+=v; });
+        return *this;
+    }
+
+    template<typename E>
+    Matrix& operator-=(const matrix_expr::Expr<E>& e){
+        check_shape(e.self());
+        matrix_expr::eval(data_.data(),e.self(),[](T& d,T v){ d-=v; });
+        return *this;
+    }
+
+    // Поэлементное умножение
+    template<typename E>
+    Matrix& operator*=(const matrix_expr::Expr<E>& e){
+        check_shape(e.self());
+        matrix_expr::eval(data_.data(),e.self(),[](T& d,T v){ d*=v; });
+        return *this;
+    }
+
+    Matrix& operator+=(const Matrix& m){ return *this+=matrix_expr::Ref<T>(m); }
+    Matrix& operator-=(const Matrix& m){ return *this-=matrix_expr::Ref<T>(m); }
+    Matrix& operator*=(const Matrix& m){ return *this*=matrix_expr::Ref<T>(m); }
+    Matrix& operator+=(T s){ for(auto &v: data_) v+=s; return *this; }
+    Matrix& operator-=(T s){ for(auto &v: data_) v-=s; return *this; }
+    Matrix& operator*=(T s){ for(auto &v: data_) v*=s; return *this; }
+
     size_t rows() const { return rows_; }
     size_t cols() const { return cols_; }
+    size_t size() const { return data_.size(); }
+
+    // Непрерывное хранение по строкам, для векторизованных ядер
+    T* data() { return data_.data(); }
+    const T* data() const { return data_.data(); }
 
     T& operator()(size_t r, size_t c) {
         if(r>=rows_||c>=cols_) throw std::out_of_range("Matrix index out of range");
@@ -0,0 +1,252 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+template<typename T> class Matrix;
+
+/**
+ * Ленивые выражения над Matrix (expression templates).
+ * a+b*2, a-repeat_rows(bias,n), elementwise(x,f) и т.п. не создают промежуточных матриц: узлы дерева
+ * хранят ссылки на данные, а всё выражение вычисляется одним циклом по строкам при присваивании
+ * в Matrix (конструктор, =, +=, -=, *=) или в свёртке (sum, col_sum, row_sum).
+ * Внутренний цикл идёт по непрерывной строке, поэтому компилятор векторизует его целиком.
+ *
+ * Выражение ссылается на матрицы-операнды и должно вычисляться, пока они живы (не хранить в auto
+ * дольше одного оператора). Присваивание в матрицу, которая сама участвует в выражении, допустимо,
+ * если она читается только поэлементно (w-=lr*g, w+=w*x); с repeat_rows/repeat_cols от неё - нет.
+ */
+namespace matrix_expr {
+
+template<typename E>
+struct Expr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+// Лист: данные матрицы
+template<typename T>
+class Ref : public Expr<Ref<T>> {
+private:
+    const T* data_;
+    size_t rows_;
+    size_t cols_;
+public:
+    using value_type=T;
+    explicit Ref(const Matrix<T>& m) : data_(m.data()), rows_(m.rows()), cols_(m.cols()) {}
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    T operator()(size_t r,size_t c) const { return data_[r*cols_+c]; }
+};
+
+// Лист: скаляр, размножённый до формы второго операнда
+template<typename T>
+class Scalar : public Expr<Scalar<T>> {
+private:
+    T value_;
+    size_t rows_;
+    size_t cols_;
+public:
+    using value_type=T;
+    Scalar(T value,size_t rows,size_t cols) : value_(value), rows_(rows), cols_(cols) {}
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    T operator()(size_t,size_t) const { return value_; }
+};
+
+// Строка 1 x cols, повторённая rows раз (смещения FC-слоя на весь батч)
+template<typename E>
+class RepeatRows : public Expr<RepeatRows<E>> {
+private:
+    E e_;
+    size_t rows_;
+public:
+    using value_type=typename E::value_type;
+    RepeatRows(const E& e,size_t rows) : e_(e), rows_(rows) {
+        if(e.rows()!=1) throw std::runtime_error("repeat_rows: ожидается строка 1 x n");
+    }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return e_.cols(); }
+    value_type operator()(size_t,size_t c) const { return e_(0,c); }
+};
+
+// Столбец rows x 1, повторённый cols раз
+template<typename E>
+class RepeatCols : public Expr<RepeatCols<E>> {
+private:
+    E e_;
+    size_t cols_;
+public:
+    using value_type=typename E::value_type;
+    RepeatCols(const E& e,size_t cols) : e_(e), cols_(cols) {
+        if(e.cols()!=1) throw std::runtime_error("repeat_cols: ожидается столбец n x 1");
+    }
+    size_t rows() const { return e_.rows(); }
+    size_t cols() const { return cols_; }
+    value_type operator()(size_t r,size_t) const { return e_(r,0); }
+};
+
+template<typename L,typename R,typename Op>
+class Binary : public Expr<Binary<L,R,Op>> {
+private:
+    L l_;
+    R r_;
+public:
+    using value_type=typename L::value_type;
+    Binary(const L& l,const R& r) : l_(l), r_(r) {
+        if(l.rows()!=r.rows()||l.cols()!=r.cols()) throw std::runtime_error("Matrix expression: dim mismatch");
+    }
+    size_t rows() const { return l_.rows(); }
+    size_t cols() const { return l_.cols(); }
+    value_type operator()(size_t r,size_t c) const { return Op::apply(l_(r,c),r_(r,c)); }
+};
+
+template<typename E,typename F>
+class Unary : public Expr<Unary<E,F>> {
+private:
+    E e_;
+    F f_;
+public:
+    using value_type=typename E::value_type;
+    Unary(const E& e,F f) : e_(e), f_(f) {}
+    size_t rows() const { return e_.rows(); }
+    size_t cols() const { return e_.cols(); }
+    value_type operator()(size_t r,size_t c) const { return f_(e_(r,c)); }
+};
+
+struct Add { template<typename T> static T apply(T a,T b){ return a+b; } };
+struct Sub { template<typename T> static T apply(T a,T b){ return a-b; } };
+struct Mul { template<typename T> static T apply(T a,T b){ return a*b; } };
+struct Div { template<typename T> static T apply(T a,T b){ return a/b; } };
+struct Neg { template<typename T> T operator()(T a) const { return -a; } };
+
+// Операнд выражения: Matrix<T> (оборачивается в Ref) или узел Expr
+template<typename X>
+struct Operand {
+    static const bool value=std::is_base_of<Expr<X>,X>::value;
+    using type=X;
+    static const X& wrap(const X& x){ return x; }
+};
+
+template<typename T>
+struct Operand<Matrix<T>> {
+    static const bool value=true;
+    using type=Ref<T>;
+    static Ref<T> wrap(const Matrix<T>& m){ return Ref<T>(m); }
+};
+
+template<typename X>
+using operand_t=typename Operand<X>::type;
+
+template<typename X,typename R=void>
+using if_operand=typename std::enable_if<Operand<X>::value,R>::type;
+
+template<typename A,typename B,typename R>
+using if_operands=typename std::enable_if<Operand<A>::value&&Operand<B>::value,R>::type;
+
+// Один проход по выражению: op(dst[r][c],e(r,c)) построчно
+template<typename T,typename E,typename Op>
+void eval(T* dst,const E& e,Op op){
+    size_t rows=e.rows(),cols=e.cols();
+    for(size_t r=0;r<rows;++r){
+        T* d=dst+r*cols;
+        for(size_t c=0;c<cols;++c) op(d[c],e(r,c));
+    }
+}
+
+} // namespace matrix_expr
+
+#define MATRIX_EXPR_BINARY(OP,NAME) \
+template<typename A,typename B> \
+matrix_expr::if_operands<A,B,matrix_expr::Binary<matrix_expr::operand_t<A>,matrix_expr::operand_t<B>,matrix_expr::NAME>> \
+operator OP(const A& a,const B& b){ \
+    return {matrix_expr::Operand<A>::wrap(a),matrix_expr::Operand<B>::wrap(b)}; \
+} \
+template<typename A> \
+matrix_expr::if_operand<A,matrix_expr::Binary<matrix_expr::operand_t<A>,matrix_expr::Scalar<typename matrix_expr::operand_t<A>::value_type>,matrix_expr::NAME>> \
+operator OP(const A& a,typename matrix_expr::operand_t<A>::value_type s){ \
+    auto x=matrix_expr::Operand<A>::wrap(a); \
+    return {x,{s,x.rows(),x.cols()}}; \
+} \
+template<typename A> \
+matrix_expr::if_operand<A,matrix_expr::Binary<matrix_expr::Scalar<typename matrix_expr::operand_t<A>::value_type>,matrix_expr::operand_t<A>,matrix_expr::NAME>> \
+operator OP(typename matrix_expr::operand_t<A>::value_type s,const A& a){ \
+    auto x=matrix_expr::Operand<A>::wrap(a); \
+    return {{s,x.rows(),x.cols()},x}; \
+}
+
+// Поэлементные операции; * и / тоже поэлементные (не матричное произведение)
+MATRIX_EXPR_BINARY(+,Add)
+MATRIX_EXPR_BINARY(-,Sub)
+MATRIX_EXPR_BINARY(*,Mul)
+MATRIX_EXPR_BINARY(/,Div)
+
+#undef MATRIX_EXPR_BINARY
+
+template<typename A>
+matrix_expr::if_operand<A,matrix_expr::Unary<matrix_expr::operand_t<A>,matrix_expr::Neg>> operator-(const A& a){
+    return {matrix_expr::Operand<A>::wrap(a),matrix_expr::Neg()};
+}
+
+// Произвольная поэлементная функция: elementwise(x,[](T v){ return v>0?v:0; })
+template<typename A,typename F>
+matrix_expr::if_operand<A,matrix_expr::Unary<matrix_expr::operand_t<A>,F>> elementwise(const A& a,F f){
+    return {matrix_expr::Operand<A>::wrap(a),f};
+}
+
+template<typename A>
+matrix_expr::if_operand<A,matrix_expr::RepeatRows<matrix_expr::operand_t<A>>> repeat_rows(const A& row,size_t rows){
+    return {matrix_expr::Operand<A>::wrap(row),rows};
+}
+
+template<typename A>
+matrix_expr::if_operand<A,matrix_expr::RepeatCols<matrix_expr::operand_t<A>>> repeat_cols(const A& col,size_t cols){
+    return {matrix_expr::Operand<A>::wrap(col),cols};
+}
+
+// Сумма всех элементов выражения
+template<typename A>
+matrix_expr::if_operand<A,typename matrix_expr::operand_t<A>::value_type> sum(const A& a){
+    auto x=matrix_expr::Operand<A>::wrap(a);
+    typename matrix_expr::operand_t<A>::value_type s=0;
+    for(size_t r=0;r<x.rows();++r){
+        for(size_t c=0;c<x.cols();++c) s+=x(r,c);
+    }
+    return s;
+}
+
+template<typename A,typename B>
+matrix_expr::if_operands<A,B,typename matrix_expr::operand_t<A>::value_type> dot(const A& a,const B& b){
+    return sum(a*b);
+}
+
+// Суммы по столбцам (1 x cols) - градиент смещений по батчу
+template<typename A>
+matrix_expr::if_operand<A,Matrix<typename matrix_expr::operand_t<A>::value_type>> col_sum(const A& a){
+    auto x=matrix_expr::Operand<A>::wrap(a);
+    Matrix<typename matrix_expr::operand_t<A>::value_type> out(1,x.cols(),0);
+    auto* o=out.data();
+    for(size_t r=0;r<x.rows();++r){
+        for(size_t c=0;c<x.cols();++c) o[c]+=x(r,c);
+    }
+    return out;
+}
+
+// Суммы по строкам (rows x 1)
+template<typename A>
+matrix_expr::if_operand<A,Matrix<typename matrix_expr::operand_t<A>::value_type>> row_sum(const A& a){
+    auto x=matrix_expr::Operand<A>::wrap(a);
+    Matrix<typename matrix_expr::operand_t<A>::value_type> out(x.rows(),1,0);
+    auto* o=out.data();
+    for(size_t r=0;r<x.rows();++r){
+        typename matrix_expr::operand_t<A>::value_type s=0;
+        for(size_t c=0;c<x.cols();++c) s+=x(r,c);
+        o[r]=s;
+    }
+    return out;
+}
+
+// y+=alpha*x за один проход
+template<typename T,typename A>
+matrix_expr::if_operand<A> axpy(Matrix<T>& y,T alpha,const A& x){
+    y+=alpha*x;
+}
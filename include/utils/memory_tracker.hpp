@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+enum class MemoryPhase {
+    Forward,
+    Backward,
+    Recompute, // повторный forward сегмента при activation checkpointing
+    Eval,      // forward в режиме inference (set_training(false))
+    Other
+};
+
+/**
+ * MemoryTracker: учёт памяти Matrix<T> по слоям и фазам.
+ * Хранилище Matrix выделяется через TrackingAllocator, который относит байты к текущему
+ * MemoryScope потока (слой + фаза). Освобождение списывается с той записи, где блок был
+ * выделен (например, кэш forward, отпущенный в backward), поэтому live_bytes записи - это
+ * то, что слой реально держит. log_epoch() дописывает по строке на запись в CSV
+ * (рядом с training_metrics.csv) и начинает новый отсчёт пиков.
+ */
+class MemoryTracker {
+public:
+    struct Entry {
+        std::string layer;
+        MemoryPhase phase;
+        std::atomic<long long> live_bytes{0};
+        std::atomic<long long> peak_bytes{0};
+        std::atomic<size_t> allocations{0};
+    };
+
+private:
+    static std::ofstream file_;
+    static std::mutex mtx_;
+    // Записи не удаляются: на них ссылаются заголовки ещё живых блоков
+    static std::map<std::string,Entry*> entries_;
+    static std::atomic<long long> total_live_;
+    static std::atomic<long long> total_peak_;
+    static thread_local Entry* current_;
+
+    // Заголовок перед каждым блоком: куда списать освобождение
+    struct alignas(alignof(std::max_align_t)) Header {
+        Entry* entry;
+        size_t bytes;
+    };
+
+    static Entry* unscoped();
+    static void update_peak(std::atomic<long long>& peak,long long value){
+        long long prev=peak.load(std::memory_order_relaxed);
+        while(value>prev&&!peak.compare_exchange_weak(prev,value,std::memory_order_relaxed)){}
+    }
+
+public:
+    static void init(const std::string& filename);
+    static void close();
+
+    static Entry* entry(const std::string& layer,MemoryPhase phase);
+    static Entry* current_scope(){ return current_; }
+    static void set_current_scope(Entry* e){ current_=e; }
+
+    static void* allocate(size_t bytes){
+        Entry* e=current_?current_:unscoped();
+        Header* h=static_cast<Header*>(::operator new(sizeof(Header)+bytes));
+        h->entry=e;
+        h->bytes=bytes;
+        long long b=(long long)bytes;
+        update_peak(e->peak_bytes,e->live_bytes.fetch_add(b,std::memory_order_relaxed)+b);
+        e->allocations.fetch_add(1,std::memory_order_relaxed);
+        update_peak(total_peak_,total_live_.fetch_add(b,std::memory_order_relaxed)+b);
+        return h+1;
+    }
+
+    static void deallocate(void* p){
+        if(!p) return;
+        Header* h=static_cast<Header*>(p)-1;
+        long long b=(long long)h->bytes;
+        h->entry->live_bytes.fetch_sub(b,std::memory_order_relaxed);
+        total_live_.fetch_sub(b,std::memory_order_relaxed);
+        ::operator delete(h);
+    }
+
+    static size_t live_bytes(){ return (size_t)std::max(0LL,total_live_.load()); }
+    static size_t peak_bytes(){ return (size_t)std::max(0LL,total_peak_.load()); }
+
+    // Строки эпохи в CSV; пики и счётчики выделений после записи начинаются заново
+    static void log_epoch(size_t epoch);
+    static const char* phase_name(MemoryPhase phase);
+};
+
+// RAII: все выделения Matrix в потоке до конца области относятся к (layer, phase)
+class MemoryScope {
+private:
+    MemoryTracker::Entry* prev_;
+public:
+    MemoryScope(const std::string& layer,MemoryPhase phase) : prev_(MemoryTracker::current_scope()) {
+        MemoryTracker::set_current_scope(MemoryTracker::entry(layer,phase));
+    }
+    // Для переноса области в другой поток (задачи ThreadPool)
+    explicit MemoryScope(MemoryTracker::Entry* e) : prev_(MemoryTracker::current_scope()) {
+        MemoryTracker::set_current_scope(e);
+    }
+    ~MemoryScope(){ MemoryTracker::set_current_scope(prev_); }
+
+    MemoryScope(const MemoryScope&)=delete;
+    MemoryScope& operator=(const MemoryScope&)=delete;
+};
+
+template<typename T>
+struct TrackingAllocator {
+    using value_type=T;
+
+    TrackingAllocator()=default;
+    template<typename U>
+    TrackingAllocator(const TrackingAllocator<U>&){}
+
+    T* allocate(size_t n){ return static_cast<T*>(MemoryTracker::allocate(n*sizeof(T))); }
+    void deallocate(T* p,size_t){ MemoryTracker::deallocate(p); }
+};
+
+template<typename T,typename U>
+bool operator==(const TrackingAllocator<T>&,const TrackingAllocator<U>&){ return true; }
+template<typename T,typename U>
+bool operator!=(const TrackingAllocator<T>&,const TrackingAllocator<U>&){ return false; }
@@ -0,0 +1,226 @@
+#pragma once
+#include "../network.hpp"
+#include "spsc_queue.hpp"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <mutex>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Делит слои на num_stages подряд идущих стадий с минимальным временем самой медленной
+ * стадии (по forward_ms из Network::profile_layers). Возвращает индексы начал стадий.
+ */
+inline std::vector<size_t> balance_pipeline_stages(const std::vector<LayerProfile>& profile,size_t num_stages){
+    size_t n=profile.size();
+    if(n==0) return {};
+    num_stages=std::max<size_t>(1,std::min(num_stages,n));
+    std::vector<double> prefix(n+1,0);
+    for(size_t i=0;i<n;++i) prefix[i+1]=prefix[i]+profile[i].forward_ms;
+
+    // best[s][i] - минимум максимальной стадии для первых i слоёв в s стадиях
+    const double inf=std::numeric_limits<double>::max();
+    std::vector<std::vector<double>> best(num_stages+1,std::vector<double>(n+1,inf));
+    std::vector<std::vector<size_t>> split(num_stages+1,std::vector<size_t>(n+1,0));
+    best[0][0]=0;
+    for(size_t s=1;s<=num_stages;++s){
+        for(size_t i=s;i<=n;++i){
+            for(size_t j=s-1;j<i;++j){
+                if(best[s-1][j]==inf) continue;
+                double cost=std::max(best[s-1][j],prefix[i]-prefix[j]);
+                if(cost<best[s][i]){
+                    best[s][i]=cost;
+                    split[s][i]=j;
+                }
+            }
+        }
+    }
+    std::vector<size_t> starts(num_stages);
+    size_t i=n;
+    for(size_t s=num_stages;s>0;--s){
+        starts[s-1]=split[s][i];
+        i=split[s][i];
+    }
+    return starts;
+}
+
+/**
+ * PipelineExecutor: шаг обучения с конвейером по слоям.
+ * Батч режется по строкам на micro_batches микробатчей, группы слоёв (стадии) работают
+ * в своих потоках и передают активации вперёд и градиенты назад через SpscQueue
+ * по расписанию 1F1B: после разогрева каждая стадия чередует forward следующего
+ * микробатча с backward самого старого. Градиенты копятся в слоях и применяются
+ * каждой стадией один раз в конце шага.
+ *
+ * Кэши слоёв рассчитаны на один вход, поэтому стадия хранит только входы своих
+ * микробатчей и перед backward пересчитывает свой forward (как activation checkpointing);
+ * последняя стадия делает backward сразу и пересчёта не требует.
+ */
+template<typename T>
+class PipelineExecutor {
+public:
+    // Градиент лосса для строк [row_begin,row_end) батча по предсказаниям этих строк
+    using GradFn=std::function<Matrix<T>(const Matrix<T>& predictions,size_t row_begin,size_t row_end)>;
+
+private:
+    struct Stage {
+        size_t begin;
+        size_t end;
+    };
+
+    Network<T>& net_;
+    std::vector<Stage> stages_;
+    size_t micro_batches_;
+
+public:
+    PipelineExecutor(Network<T>& net,std::vector<size_t> stage_starts,size_t micro_batches)
+        : net_(net), micro_batches_(std::max<size_t>(1,micro_batches)) {
+        if(!net.activation_checkpoints().empty())
+            throw std::runtime_error("PipelineExecutor: несовместим с activation checkpointing");
+        if(stage_starts.empty()||stage_starts[0]!=0) stage_starts.insert(stage_starts.begin(),0);
+        for(size_t s=0;s<stage_starts.size();++s){
+            size_t end=s+1<stage_starts.size()?stage_starts[s+1]:net.size();
+            if(stage_starts[s]>=end) throw std::runtime_error("PipelineExecutor: некорректные границы стадий");
+            stages_.push_back({stage_starts[s],end});
+        }
+    }
+
+    size_t num_stages() const { return stages_.size(); }
+    size_t micro_batches() const { return micro_batches_; }
+
+    std::vector<size_t> stage_starts() const {
+        std::vector<size_t> starts;
+        for(auto &s: stages_) starts.push_back(s.begin);
+        return starts;
+    }
+
+    // Forward + backward + шаг по батчу X; возвращает предсказания для всего батча
+    Matrix<T> train_step(const Matrix<T>& X,const GradFn& grad_fn,T learning_rate,T lambda=0.0){
+        size_t rows=X.rows();
+        size_t micro=std::min(micro_batches_,rows);
+        if(micro==0) throw std::runtime_error("PipelineExecutor: пустой батч");
+        size_t num=stages_.size();
+
+        std::vector<size_t> bounds(micro+1);
+        for(size_t m=0;m<=micro;++m) bounds[m]=rows*m/micro;
+
+        // forward_q[s]: стадия s -> s+1, backward_q[s]: стадия s+1 -> s
+        std::vector<std::unique_ptr<SpscQueue<std::vector<Matrix<T>>>>> forward_q,backward_q;
+        for(size_t s=0;s+1<num;++s){
+            forward_q.emplace_back(new SpscQueue<std::vector<Matrix<T>>>(micro));
+            backward_q.emplace_back(new SpscQueue<std::vector<Matrix<T>>>(micro));
+        }
+        std::vector<Matrix<T>> outputs(micro);
+        std::exception_ptr error;
+        std::mutex error_mtx;
+
+        auto abort=[&](){
+            for(auto &q: forward_q) q->close();
+            for(auto &q: backward_q) q->close();
+        };
+
+        auto run_stage=[&](size_t s){
+            try{
+                run_schedule(s,X,bounds,grad_fn,outputs,forward_q,backward_q);
+                for(size_t i=stages_[s].begin;i<stages_[s].end;++i){
+                    net_.layer(i).set_accumulate_gradients(false);
+                    net_.layer(i).apply_gradients(learning_rate,lambda);
+                }
+            }catch(...){
+                {
+                    std::lock_guard<std::mutex> lock(error_mtx);
+                    if(!error) error=std::current_exception();
+                }
+                abort();
+            }
+        };
+
+        for(size_t i=0;i<net_.size();++i) net_.layer(i).set_accumulate_gradients(true);
+        std::vector<std::thread> threads;
+        for(size_t s=1;s<num;++s) threads.emplace_back(run_stage,s);
+        run_stage(0);
+        for(auto &t: threads) t.join();
+        if(error){
+            for(size_t i=0;i<net_.size();++i){
+                net_.layer(i).set_accumulate_gradients(false);
+                net_.layer(i).release_cache();
+            }
+            std::rethrow_exception(error);
+        }
+
+        size_t cols=outputs[0].cols();
+        Matrix<T> predictions(rows,cols,0);
+        for(size_t m=0;m<micro;++m){
+            std::copy(outputs[m].data(),outputs[m].data()+outputs[m].size(),predictions.data()+bounds[m]*cols);
+        }
+        return predictions;
+    }
+
+private:
+    void run_schedule(size_t s,const Matrix<T>& X,const std::vector<size_t>& bounds,const GradFn& grad_fn,
+                      std::vector<Matrix<T>>& outputs,
+                      std::vector<std::unique_ptr<SpscQueue<std::vector<Matrix<T>>>>>& forward_q,
+                      std::vector<std::unique_ptr<SpscQueue<std::vector<Matrix<T>>>>>& backward_q){
+        size_t num=stages_.size();
+        size_t micro=bounds.size()-1;
+        bool last=s+1==num;
+        const Stage& stage=stages_[s];
+        std::deque<std::vector<Matrix<T>>> inputs; // входы микробатчей, ждущих backward
+        std::deque<Matrix<T>> loss_grads;          // только у последней стадии
+        size_t forwarded=0,backwarded=0;
+
+        auto forward_one=[&](){
+            std::vector<Matrix<T>> in;
+            if(s==0){
+                size_t lo=bounds[forwarded],hi=bounds[forwarded+1];
+                Matrix<T> slice(hi-lo,X.cols(),0);
+                std::copy(X.data()+lo*X.cols(),X.data()+hi*X.cols(),slice.data());
+                in.push_back(std::move(slice));
+            } else if(!forward_q[s-1]->pop(in)){
+                throw std::runtime_error("PipelineExecutor: стадия остановлена");
+            }
+            std::vector<Matrix<T>> out=net_.forward_range(stage.begin,stage.end,last?std::move(in):in);
+            if(last){
+                if(out.size()!=1) throw std::runtime_error("PipelineExecutor: выход сети должен быть одним каналом");
+                loss_grads.push_back(grad_fn(out[0],bounds[forwarded],bounds[forwarded+1]));
+                outputs[forwarded]=std::move(out[0]);
+            } else {
+                net_.release_caches(stage.begin,stage.end);
+                inputs.push_back(std::move(in));
+                if(!forward_q[s]->push(std::move(out))) throw std::runtime_error("PipelineExecutor: стадия остановлена");
+            }
+            ++forwarded;
+        };
+
+        auto backward_one=[&](){
+            std::vector<Matrix<T>> grad;
+            if(last){
+                grad.push_back(std::move(loss_grads.front()));
+                loss_grads.pop_front();
+            } else {
+                if(!backward_q[s]->pop(grad)) throw std::runtime_error("PipelineExecutor: стадия остановлена");
+                net_.forward_range(stage.begin,stage.end,std::move(inputs.front()),MemoryPhase::Recompute);
+                inputs.pop_front();
+            }
+            // learning_rate не используется: слои в режиме накопления
+            std::vector<Matrix<T>> dInput=net_.backward_range(stage.begin,stage.end,std::move(grad),(T)0,(T)0);
+            if(s>0&&!backward_q[s-1]->push(std::move(dInput)))
+                throw std::runtime_error("PipelineExecutor: стадия остановлена");
+            ++backwarded;
+        };
+
+        size_t warmup=std::min(num-1-s,micro);
+        for(size_t i=0;i<warmup;++i) forward_one();
+        while(forwarded<micro){
+            forward_one();
+            backward_one();
+        }
+        while(backwarded<micro) backward_one();
+    }
+};
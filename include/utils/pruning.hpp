@@ -0,0 +1,107 @@
+#pragma once
+#include "../network.hpp"
+#include "../layers/fully_connected_layer.hpp"
+#include "metrics.hpp"
+#include "logger.hpp"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+
+enum class PruningMode {
+    Unstructured, // отдельные веса по |w|
+    Structured    // целые выходные нейроны по L2-норме
+};
+
+/**
+ * MagnitudePruner: прунинг всех FullyConnectedLayer сети.
+ * apply_one_shot() сразу выставляет целевую разреженность, apply(net,epoch)
+ * наращивает её по кубическому расписанию между start_epoch и end_epoch
+ * (Trainer::set_pruning вызывает его в конце каждой эпохи).
+ */
+template<typename T>
+class MagnitudePruner {
+private:
+    T final_sparsity_;
+    size_t start_epoch_;
+    size_t end_epoch_;
+    PruningMode mode_;
+public:
+    MagnitudePruner(T final_sparsity,size_t start_epoch=0,size_t end_epoch=0,PruningMode mode=PruningMode::Unstructured)
+        : final_sparsity_(final_sparsity), start_epoch_(start_epoch), end_epoch_(end_epoch), mode_(mode) {}
+
+    // s_t = s_f * (1 - (1 - progress)^3)
+    T target_sparsity(size_t epoch) const {
+        if(epoch<start_epoch_) return 0;
+        if(epoch>=end_epoch_) return final_sparsity_;
+        T progress=(T)(epoch-start_epoch_)/(T)(end_epoch_-start_epoch_);
+        T remaining=1-progress;
+        return final_sparsity_*(1-remaining*remaining*remaining);
+    }
+
+    void apply(Network<T>& net,size_t epoch) const {
+        prune(net,target_sparsity(epoch));
+    }
+
+    void apply_one_shot(Network<T>& net) const {
+        prune(net,final_sparsity_);
+    }
+
+private:
+    void prune(Network<T>& net,T sparsity) const {
+        if(sparsity<=0) return;
+        for(size_t i=0;i<net.size();++i){
+            FullyConnectedLayer<T>* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net.layer(i));
+            if(!fc) continue;
+            if(mode_==PruningMode::Unstructured) fc->prune_magnitude(sparsity);
+            else fc->prune_neurons(sparsity);
+        }
+    }
+};
+
+struct PruningReportRow {
+    float sparsity;
+    float accuracy;
+    double forward_ms;
+    bool sparse_path;
+};
+
+/**
+ * Точность и время forward при разных уровнях разреженности одного FC-слоя.
+ * Замер - в режиме inference (без кэшей для backward, BatchNorm на running-статистиках);
+ * веса слоя восстанавливаются после каждого замера, режим сети и кэши - в конце.
+ */
+template<typename T>
+std::vector<PruningReportRow> pruning_report(Network<T>& net,FullyConnectedLayer<T>& layer,
+                                             const Matrix<T>& X,const Matrix<T>& Y,
+                                             const std::vector<T>& sparsities,
+                                             PruningMode mode=PruningMode::Unstructured){
+    Matrix<T> weights=layer.weights();
+    Matrix<T> biases=layer.biases();
+    std::vector<PruningReportRow> rows;
+    bool was_training=layer.is_training();
+    net.set_training(false);
+    Logger::info("Sparsity,Accuracy,Forward_ms,Sparse_path");
+    for(T s: sparsities){
+        layer.set_parameters(weights,biases);
+        if(mode==PruningMode::Unstructured) layer.prune_magnitude(s);
+        else layer.prune_neurons(s);
+
+        auto start=std::chrono::steady_clock::now();
+        auto preds=net.forward({X});
+        auto stop=std::chrono::steady_clock::now();
+
+        PruningReportRow row;
+        row.sparsity=(float)layer.sparsity();
+        row.accuracy=Metrics<T>::accuracy(preds[0],Y);
+        row.forward_ms=std::chrono::duration<double,std::milli>(stop-start).count();
+        row.sparse_path=layer.uses_sparse();
+        rows.push_back(row);
+        Logger::info(std::to_string(row.sparsity)+","+std::to_string(row.accuracy)+","+
+                     std::to_string(row.forward_ms)+","+(row.sparse_path?"1":"0"));
+    }
+    layer.set_parameters(weights,biases);
+    net.release_caches();
+    net.set_training(was_training);
+    return rows;
+}
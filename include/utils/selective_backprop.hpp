@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <random>
+#include <vector>
+
+/**
+ * Параметры selective backprop: backward только по примерам с большим лоссом.
+ * Вероятность backward - доля истории с лоссом не больше текущего (перцентиль), в степени beta:
+ * beta=0 - все примеры, чем больше beta, тем сильнее отбор. Снизу вероятность ограничена
+ * min_probability, чтобы лёгкие примеры изредка всё же учились, а веса 1/p оставались конечными.
+ */
+struct SelectiveBackpropConfig {
+    double beta=2.0;
+    size_t history=1024;          // последние лоссы, по которым считается перцентиль
+    double min_probability=0.05;
+    // Поправка смещения: градиент примера умножается на 1/p (с нормировкой на среднее по батчу)
+    bool bias_correction=true;
+    // Первые эпохи - обычный backward по всем примерам (история лоссов ещё не показательна)
+    size_t warmup_epochs=1;
+};
+
+/**
+ * Отбор примеров для backward по истории лоссов (кольцевой буфер последних config.history).
+ */
+class SelectiveBackpropSampler {
+private:
+    SelectiveBackpropConfig config_;
+    std::vector<double> history_;
+    size_t next_=0;
+    std::vector<double> sorted_;
+    size_t seen_=0;
+    size_t selected_=0;
+
+public:
+    explicit SelectiveBackpropSampler(const SelectiveBackpropConfig& config);
+
+    const SelectiveBackpropConfig& config() const { return config_; }
+
+    // Вероятности backward для лоссов батча; лоссы затем попадают в историю
+    std::vector<double> probabilities(const std::vector<double>& losses);
+
+    // Индексы выбранных примеров батча и их вероятности (probabilities + жребий)
+    void select(const std::vector<double>& losses,std::mt19937& rng,
+                std::vector<size_t>& chosen,std::vector<double>& chosen_prob);
+
+    // Счётчики с последнего reset_counters: просмотрено и отобрано для backward
+    size_t seen() const { return seen_; }
+    size_t selected() const { return selected_; }
+    void reset_counters(){ seen_=0; selected_=0; }
+
+    // История лоссов для снимков обучения: кольцевой буфер и позиция следующей записи
+    const std::vector<double>& history() const { return history_; }
+    size_t history_next() const { return next_; }
+    void restore_history(const std::vector<double>& history,size_t next);
+};
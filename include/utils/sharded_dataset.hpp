@@ -0,0 +1,218 @@
+#pragma once
+#include "matrix.hpp"
+#include "bounded_queue.hpp"
+#include "batch_loader.hpp"
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Набор данных на диске, разбитый на шарды: каталог с index.bin и файлами shard-NNNNN.bin.
+ * Запись - rows*cols байт пикселей и байт метки, размер записи фиксирован, поэтому
+ * индекс хранит только число записей в каждом шарде. Все целые - little-endian.
+ * index.bin:  "CNNIDX01", u32 rows, u32 cols, u32 num_classes, u32 num_shards, u64 count[num_shards]
+ * shard-*.bin: "CNNSHD01", u64 count, затем count записей
+ */
+struct ShardInfo {
+    std::string path;
+    size_t count;
+};
+
+class ShardedDatasetWriter {
+private:
+    std::string dir_;
+    size_t rows_;
+    size_t cols_;
+    size_t num_classes_;
+    size_t records_per_shard_;
+    std::vector<size_t> counts_;
+    std::ofstream shard_;
+    bool closed_=false;
+
+    void finish_shard();
+
+public:
+    ShardedDatasetWriter(const std::string& dir,size_t rows,size_t cols,size_t num_classes,size_t records_per_shard=10000);
+    ~ShardedDatasetWriter();
+
+    ShardedDatasetWriter(const ShardedDatasetWriter&)=delete;
+    ShardedDatasetWriter& operator=(const ShardedDatasetWriter&)=delete;
+
+    // pixels - rows*cols байт
+    void add(const unsigned char* pixels,int label);
+    // Дописывает последний шард и индекс; без close() набор не читается
+    void close();
+};
+
+// Перекладывает пару файлов IDX в шарды, не загружая их в память целиком; возвращает число записей
+size_t write_shards_from_idx(const std::string& images_path,const std::string& labels_path,
+                             const std::string& dir,size_t num_classes=10,size_t records_per_shard=10000);
+
+class ShardedDataset {
+private:
+    std::string dir_;
+    size_t rows_=0;
+    size_t cols_=0;
+    size_t num_classes_=0;
+    size_t num_records_=0;
+    std::vector<ShardInfo> shards_;
+
+public:
+    explicit ShardedDataset(const std::string& dir);
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t feature_dim() const { return rows_*cols_; }
+    size_t record_size() const { return rows_*cols_+1; }
+    size_t num_classes() const { return num_classes_; }
+    size_t num_records() const { return num_records_; }
+    const std::vector<ShardInfo>& shards() const { return shards_; }
+};
+
+/**
+ * ShardStream: одна эпоха по ShardedDataset за постоянную память.
+ * Фоновый поток читает шарды в случайном порядке кусками по read_ahead_bytes (read(2),
+ * posix_fadvise SEQUENTIAL на текущий шард, WILLNEED на начало следующего, DONTNEED на
+ * прочитанное - страничный кэш не разрастается на наборах больше памяти). Не больше
+ * max_chunks кусков ждут в очереди. Записи выдаются через буфер перемешивания на
+ * shuffle_buffer записей: случайная запись буфера уходит, её место занимает следующая из потока.
+ */
+class ShardStream {
+private:
+    struct Chunk {
+        std::vector<unsigned char> records;
+        size_t count=0;
+    };
+
+    const ShardedDataset& dataset_;
+    size_t record_size_;
+    size_t chunk_records_;
+    std::mt19937 rng_;
+    std::vector<size_t> order_;
+    BoundedQueue<Chunk> queue_;
+    std::thread reader_;
+    std::exception_ptr error_;
+    std::mutex error_mtx_;
+
+    Chunk chunk_;
+    size_t chunk_pos_=0;
+    bool exhausted_=false;
+    std::vector<unsigned char> buffer_;
+    size_t buffer_capacity_;
+    size_t buffered_=0;
+    size_t emitted_=0;
+
+    void read_shards();
+    // Следующая запись из потока в dst; false - поток кончился
+    bool pull(unsigned char* dst);
+
+public:
+    ShardStream(const ShardedDataset& dataset,unsigned seed,size_t shuffle_buffer=8192,
+                size_t read_ahead_bytes=4<<20,size_t max_chunks=2);
+    ~ShardStream();
+
+    ShardStream(const ShardStream&)=delete;
+    ShardStream& operator=(const ShardStream&)=delete;
+
+    size_t record_size() const { return record_size_; }
+    size_t emitted() const { return emitted_; }
+    // Порядок шардов этой эпохи
+    const std::vector<size_t>& shard_order() const { return order_; }
+
+    // До max_records записей подряд в out (record_size() байт каждая); 0 - эпоха кончилась
+    size_t next(size_t max_records,std::vector<unsigned char>& out);
+};
+
+/**
+ * StreamingBatchLoader: батчи эпохи из ShardStream с тем же интерфейсом, что у BatchLoader.
+ * Пиксели делятся на 255, метка - one-hot; неполный последний батч отбрасывается.
+ * При prefetch>0 батчи собираются в фоновом потоке (не больше prefetch готовых),
+ * и сборка идёт параллельно с обучением; при prefetch==0 - прямо в next().
+ */
+template<typename T>
+class StreamingBatchLoader {
+private:
+    ShardStream stream_;
+    size_t feature_dim_;
+    size_t num_classes_;
+    size_t batch_size_;
+    size_t num_batches_;
+    size_t next_=0;
+    std::vector<unsigned char> records_;
+    std::unique_ptr<BoundedQueue<Batch<T>>> queue_;
+    std::thread assembler_;
+    std::exception_ptr error_;
+    std::mutex error_mtx_;
+
+    void assemble(Batch<T>& batch){
+        if(stream_.next(batch_size_,records_)!=batch_size_)
+            throw std::runtime_error("StreamingBatchLoader: шарды короче, чем указано в индексе");
+        if(batch.X.rows()!=batch_size_||batch.X.cols()!=feature_dim_) batch.X=Matrix<T>(batch_size_,feature_dim_,0);
+        if(batch.Y.rows()!=batch_size_||batch.Y.cols()!=num_classes_) batch.Y=Matrix<T>(batch_size_,num_classes_,0);
+        size_t record_size=stream_.record_size();
+        T* x=batch.X.data();
+        T* y=batch.Y.data();
+        const T scale=(T)1/(T)255;
+        std::fill(y,y+batch_size_*num_classes_,(T)0);
+        for(size_t i=0;i<batch_size_;++i){
+            const unsigned char* r=records_.data()+i*record_size;
+            T* xi=x+i*feature_dim_;
+            for(size_t j=0;j<feature_dim_;++j) xi[j]=(T)r[j]*scale;
+            size_t label=r[feature_dim_];
+            if(label>=num_classes_) throw std::runtime_error("StreamingBatchLoader: метка "+std::to_string(label)+" вне числа классов");
+            y[i*num_classes_+label]=1;
+        }
+    }
+
+public:
+    StreamingBatchLoader(const ShardedDataset& dataset,size_t batch_size,unsigned seed,size_t shuffle_buffer=8192,
+                         size_t prefetch=2)
+        : stream_(dataset,seed,shuffle_buffer), feature_dim_(dataset.feature_dim()),
+          num_classes_(dataset.num_classes()), batch_size_(batch_size),
+          num_batches_(batch_size>0?dataset.num_records()/batch_size:0) {
+        if(prefetch==0) return;
+        queue_.reset(new BoundedQueue<Batch<T>>(prefetch));
+        assembler_=std::thread([this](){
+            try{
+                for(size_t b=0;b<num_batches_;++b){
+                    Batch<T> batch;
+                    assemble(batch);
+                    if(!queue_->push(std::move(batch))) return;
+                }
+            }catch(...){
+                std::lock_guard<std::mutex> lock(error_mtx_);
+                error_=std::current_exception();
+            }
+            queue_->close();
+        });
+    }
+
+    ~StreamingBatchLoader(){
+        if(queue_) queue_->close();
+        if(assembler_.joinable()) assembler_.join();
+    }
+
+    StreamingBatchLoader(const StreamingBatchLoader&)=delete;
+    StreamingBatchLoader& operator=(const StreamingBatchLoader&)=delete;
+
+    size_t num_batches() const { return num_batches_; }
+
+    bool next(Batch<T>& batch){
+        if(next_>=num_batches_) return false;
+        ++next_;
+        if(!queue_){
+            assemble(batch);
+            return true;
+        }
+        if(queue_->pop(batch)) return true;
+        std::lock_guard<std::mutex> lock(error_mtx_);
+        if(error_) std::rethrow_exception(error_);
+        throw std::runtime_error("StreamingBatchLoader: сборка батчей прервана");
+    }
+};
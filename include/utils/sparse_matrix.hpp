@@ -0,0 +1,63 @@
+#pragma once
+#include "matrix.hpp"
+#include <vector>
+#include <cstdint>
+
+/**
+ * CSRMatrix: разреженная матрица в формате CSR.
+ * Для FullyConnectedLayer хранится W^T (строка = выходной нейрон), чтобы умножение
+ * шло по батчу во внутреннем цикле: out^T = W^T * X^T.
+ */
+template<typename T>
+class CSRMatrix {
+private:
+    size_t rows_;
+    size_t cols_;
+    std::vector<size_t> row_ptr_;
+    std::vector<uint32_t> col_idx_;
+    std::vector<T> values_;
+public:
+    CSRMatrix() : rows_(0), cols_(0), row_ptr_(1,0) {}
+
+    // Строит CSR от транспонированной плотной матрицы, нули отбрасываются
+    static CSRMatrix from_dense_transposed(const Matrix<T>& dense){
+        CSRMatrix csr;
+        csr.rows_=dense.cols();
+        csr.cols_=dense.rows();
+        csr.row_ptr_.assign(csr.rows_+1,0);
+        const T* d=dense.data();
+        for(size_t r=0;r<csr.rows_;++r){
+            for(size_t c=0;c<csr.cols_;++c){
+                T v=d[c*dense.cols()+r];
+                if(v!=(T)0){
+                    csr.col_idx_.push_back((uint32_t)c);
+                    csr.values_.push_back(v);
+                }
+            }
+            csr.row_ptr_[r+1]=csr.values_.size();
+        }
+        return csr;
+    }
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t nnz() const { return values_.size(); }
+
+    /**
+     * out[r*batch+b] = sum_p values[p]*xt[col[p]*batch+b]
+     * xt - плотная [cols x batch], out - [rows x batch]; внутренний цикл по батчу векторизуется.
+     */
+    void multiply(const T* xt,size_t batch,T* out) const {
+        for(size_t r=0;r<rows_;++r){
+            T* acc=out+r*batch;
+            for(size_t b=0;b<batch;++b) acc[b]=0;
+            for(size_t p=row_ptr_[r];p<row_ptr_[r+1];++p){
+                T v=values_[p];
+                const T* x=xt+(size_t)col_idx_[p]*batch;
+                for(size_t b=0;b<batch;++b){
+                    acc[b]+=v*x[b];
+                }
+            }
+        }
+    }
+};
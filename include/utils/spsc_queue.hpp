@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * SpscQueue: lock-free кольцевой буфер на одного производителя и одного потребителя
+ * (стадии пайплайна передают друг другу активации и градиенты).
+ * Ожидание - активное с yield: очереди короткие, а стадия без данных всё равно простаивает.
+ * После close() push() и pop() на пустой очереди возвращают false.
+ */
+template<typename Item>
+class SpscQueue {
+private:
+    std::vector<Item> slots_;
+    std::atomic<size_t> head_{0}; // следующий для pop, пишет только потребитель
+    std::atomic<size_t> tail_{0}; // следующий для push, пишет только производитель
+    std::atomic<bool> closed_{false};
+
+    size_t next(size_t i) const { return i+1==slots_.size()?0:i+1; }
+public:
+    // Один слот всегда пустой, чтобы отличать полную очередь от пустой
+    explicit SpscQueue(size_t capacity):slots_((capacity>0?capacity:1)+1){}
+
+    SpscQueue(const SpscQueue&)=delete;
+    SpscQueue& operator=(const SpscQueue&)=delete;
+
+    bool push(Item item){
+        size_t tail=tail_.load(std::memory_order_relaxed);
+        size_t n=next(tail);
+        while(n==head_.load(std::memory_order_acquire)){
+            if(closed_.load(std::memory_order_acquire)) return false;
+            std::this_thread::yield();
+        }
+        if(closed_.load(std::memory_order_acquire)) return false;
+        slots_[tail]=std::move(item);
+        tail_.store(n,std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Item& item){
+        size_t head=head_.load(std::memory_order_relaxed);
+        while(head==tail_.load(std::memory_order_acquire)){
+            if(closed_.load(std::memory_order_acquire)) return false;
+            std::this_thread::yield();
+        }
+        item=std::move(slots_[head]);
+        head_.store(next(head),std::memory_order_release);
+        return true;
+    }
+
+    void close(){ closed_.store(true,std::memory_order_release); }
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "memory_tracker.hpp"
+
+/**
+ * ThreadPool: общий пул с work-stealing.
+ * У каждого воркера своя очередь: свои задачи берутся с конца, чужие крадутся с начала.
+ * Поток, ожидающий parallel_for, сам выполняет задачи из очередей, поэтому вложенные
+ * вызовы (и вызовы из нескольких потоков сразу) не приводят к взаимоблокировке.
+ */
+class ThreadPool {
+private:
+    struct WorkerQueue {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stop_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> next_queue_;
+    std::mutex wake_mtx_;
+    std::condition_variable wake_cv_;
+
+    // Минимальная работа (условные операции) на одну задачу, меньше - выгоднее считать последовательно
+    static const size_t min_work_per_task_=32768;
+
+public:
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)=delete;
+    ThreadPool& operator=(const ThreadPool&)=delete;
+
+    // Общий пул: CNN_NUM_THREADS или std::thread::hardware_concurrency()
+    static ThreadPool& instance();
+
+    // Число потоков, включая вызывающий
+    size_t size() const { return threads_.size()+1; }
+
+    void submit(std::function<void()> task);
+
+    // Сколько итераций класть в одну задачу при стоимости итерации cost
+    static size_t grain_size(size_t cost_per_iteration){
+        if(cost_per_iteration==0) cost_per_iteration=1;
+        return std::max<size_t>(1,min_work_per_task_/cost_per_iteration);
+    }
+
+    /**
+     * Делит [begin,end) на куски не меньше grain итераций и вызывает fn(lo,hi) для каждого.
+     * Если кусок один или пул однопоточный - выполняется прямо в вызывающем потоке.
+     * Первое исключение из задач пробрасывается вызывающему.
+     */
+    template<typename F>
+    void parallel_for(size_t begin,size_t end,size_t grain,F fn){
+        if(end<=begin) return;
+        size_t n=end-begin;
+        if(grain==0) grain=1;
+        size_t chunks=std::min((n+grain-1)/grain,size()*4);
+        if(chunks<=1||threads_.empty()){
+            fn(begin,end);
+            return;
+        }
+
+        struct Group {
+            std::atomic<size_t> remaining;
+            std::mutex error_mtx;
+            std::exception_ptr error;
+        };
+        std::shared_ptr<Group> group=std::make_shared<Group>();
+        group->remaining.store(chunks);
+
+        size_t chunk_size=(n+chunks-1)/chunks;
+        // Выделения в задачах учитываются на слой/фазу вызывающего потока
+        MemoryTracker::Entry* scope=MemoryTracker::current_scope();
+        for(size_t c=1;c<chunks;++c){
+            size_t lo=begin+c*chunk_size;
+            size_t hi=std::min(end,lo+chunk_size);
+            submit([group,fn,lo,hi,scope](){
+                MemoryScope memory_scope(scope);
+                run_chunk(*group,fn,lo,hi);
+            });
+        }
+        run_chunk(*group,fn,begin,std::min(end,begin+chunk_size));
+
+        while(group->remaining.load(std::memory_order_acquire)>0){
+            if(!run_pending_task()) std::this_thread::yield();
+        }
+        if(group->error) std::rethrow_exception(group->error);
+    }
+
+private:
+    template<typename G,typename F>
+    static void run_chunk(G& group,const F& fn,size_t lo,size_t hi){
+        if(lo<hi){
+            try{
+                fn(lo,hi);
+            }catch(...){
+                std::lock_guard<std::mutex> lock(group.error_mtx);
+                if(!group.error) group.error=std::current_exception();
+            }
+        }
+        group.remaining.fetch_sub(1,std::memory_order_acq_rel);
+    }
+
+    bool try_pop(size_t preferred,std::function<void()>& task);
+    bool run_pending_task();
+    void worker_loop(size_t index);
+};
+
+// Короткая запись для ядер слоёв: parallel_for(0,n,grain,[&](size_t lo,size_t hi){...});
+template<typename F>
+inline void parallel_for(size_t begin,size_t end,size_t grain,F fn){
+    ThreadPool::instance().parallel_for(begin,end,grain,fn);
+}
+
+// Две независимые части работы параллельно (в backward - градиент по весам и по входу)
+template<typename A,typename B>
+inline void parallel_invoke(A a,B b){
+    parallel_for(0,2,1,[&](size_t lo,size_t hi){
+        for(size_t i=lo;i<hi;++i){
+            if(i==0) a();
+            else b();
+        }
+    });
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "../trainer.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TimeToAccuracyResult {
+    std::string mode;
+    bool reached=false;
+    size_t epochs_to_target=0;    // эпоха (с 1), на которой точность впервые достигла цели
+    double seconds_to_target=0;   // время обучающих проходов до неё, без оценки
+    double train_seconds=0;       // за все эпохи
+    float final_accuracy=0;
+    double backward_fraction=1;   // доля примеров, прошедших backward, за все эпохи
+};
+
+/**
+ * Время до целевой точности на валидации: обычный цикл Trainer против selective backprop.
+ * Обе сети строит factory, обе обучаются max_epochs эпох с одинаковыми параметрами и seed;
+ * после каждой эпохи сеть оценивается на X_val. Учитывается только время обучения
+ * (Trainer::last_epoch_train_seconds), оценка в него не входит.
+ */
+template<typename T>
+std::vector<TimeToAccuracyResult> time_to_accuracy_report(std::function<std::unique_ptr<Network<T>>()> factory,
+                                                          const Matrix<T>& X_train,const Matrix<T>& Y_train,
+                                                          const Matrix<T>& X_val,const Matrix<T>& Y_val,
+                                                          float target,size_t max_epochs,T learning_rate,
+                                                          size_t batch_size,const SelectiveBackpropConfig& config,
+                                                          LossFunction loss_fn=LossFunction::CrossEntropy,
+                                                          unsigned seed=42){
+    auto run=[&](bool selective){
+        TimeToAccuracyResult result;
+        result.mode=selective?"selective":"standard";
+        std::unique_ptr<Network<T>> net=factory();
+        Trainer<T> trainer;
+        trainer.set_seed(seed);
+        trainer.set_epoch_logging(false);
+        if(selective) trainer.set_selective_backprop(config);
+        double backward_sum=0;
+        size_t epochs=0;
+        trainer.set_epoch_callback([&](size_t,Network<T>& n){
+            result.train_seconds+=trainer.last_epoch_train_seconds();
+            backward_sum+=trainer.last_backward_fraction();
+            ++epochs;
+            n.set_training(false);
+            std::vector<Matrix<T>> preds=n.forward({X_val});
+            n.release_caches();
+            result.final_accuracy=Metrics<T>::accuracy(preds[0],Y_val);
+            if(!result.reached&&result.final_accuracy>=target){
+                result.reached=true;
+                result.epochs_to_target=epochs;
+                result.seconds_to_target=result.train_seconds;
+            }
+        });
+        // patience=max_epochs и min_delta=0: обе сети проходят одинаковое число эпох
+        trainer.train(*net,{X_train},{Y_train},max_epochs,learning_rate,batch_size,(T)0,max_epochs,(T)0,loss_fn);
+        result.backward_fraction=epochs>0?backward_sum/(double)epochs:1.0;
+        Logger::info(result.mode+","+std::to_string(result.reached)+","+std::to_string(result.epochs_to_target)+","+
+                     std::to_string(result.seconds_to_target)+","+std::to_string(result.train_seconds)+","+
+                     std::to_string(result.final_accuracy)+","+std::to_string(result.backward_fraction));
+        return result;
+    };
+
+    Logger::info("Mode,Reached,Epochs_to_target,Seconds_to_target,Train_seconds,Accuracy,Backward_fraction");
+    std::vector<TimeToAccuracyResult> results;
+    results.push_back(run(false));
+    results.push_back(run(true));
+    return results;
+}
+
+inline void print_time_to_accuracy(const std::vector<TimeToAccuracyResult>& results,float target){
+    std::printf("target accuracy %.4f\n",target);
+    std::printf("%10s %9s %11s %9s %9s %9s\n","mode","epochs_to","seconds_to","train_s","accuracy","backward");
+    for(auto &r: results){
+        std::printf("%10s %9s %11s %9.3f %9.4f %9.3f\n",r.mode.c_str(),
+                    r.reached?std::to_string(r.epochs_to_target).c_str():"-",
+                    r.reached?std::to_string(r.seconds_to_target).c_str():"-",
+                    r.train_seconds,r.final_accuracy,r.backward_fraction);
+    }
+}
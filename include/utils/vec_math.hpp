@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cmath>
+
+/**
+ * Точность векторных exp/expm1/log.
+ * Precise - в пределах пары ULP от libm на всём диапазоне float,
+ * Fast - полиномы меньшей степени для exp/expm1 (относительная ошибка порядка 1e-4), для активаций;
+ * log всегда точный.
+ */
+enum class MathAccuracy {
+    Precise,
+    Fast
+};
+
+/**
+ * vec_math: поэлементные exp/expm1/log над массивами (y может совпадать с x).
+ * Для float ядро выбирается при первом вызове по CPU: AVX2+FMA или переносимый скалярный
+ * вариант того же алгоритма (CNN_SIMD=scalar принудительно включает скалярный).
+ * Для double - std:: поэлементно.
+ */
+namespace vec_math {
+
+void exp(const float* x,float* y,size_t n,MathAccuracy accuracy=MathAccuracy::Precise);
+void expm1(const float* x,float* y,size_t n,MathAccuracy accuracy=MathAccuracy::Precise);
+void log(const float* x,float* y,size_t n,MathAccuracy accuracy=MathAccuracy::Precise);
+
+// Имя выбранного набора инструкций ("avx2" или "scalar")
+const char* isa();
+
+inline void exp(const double* x,double* y,size_t n,MathAccuracy=MathAccuracy::Precise){
+    for(size_t i=0;i<n;++i) y[i]=std::exp(x[i]);
+}
+
+inline void expm1(const double* x,double* y,size_t n,MathAccuracy=MathAccuracy::Precise){
+    for(size_t i=0;i<n;++i) y[i]=std::expm1(x[i]);
+}
+
+inline void log(const double* x,double* y,size_t n,MathAccuracy=MathAccuracy::Precise){
+    for(size_t i=0;i<n;++i) y[i]=std::log(x[i]);
+}
+
+} // namespace vec_math
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Локальный запуск распределённого обучения: N процессов cnn_mnist в одном кольце.
+# Использование: ./run_distributed.sh N [путь к cnn_mnist] [адрес]
+# Адрес по умолчанию - Unix-сокеты; для TCP, например, 127.0.0.1:29500.
+# Логи процесса 0 - как у обычного запуска, остальных - training_metrics.rank<k>.csv.
+
+N=${1:-2}
+BIN=${2:-./cnn_mnist}
+ADDR=${3:-unix:/tmp/cnn_ring.$$}
+
+pids=""
+rank=0
+while [ "$rank" -lt "$N" ]; do
+    CNN_RANK=$rank CNN_WORLD_SIZE=$N CNN_MASTER_ADDR=$ADDR "$BIN" &
+    pids="$pids $!"
+    rank=$((rank+1))
+done
+
+status=0
+for pid in $pids; do
+    wait "$pid" || status=1
+done
+exit $status
@@ -0,0 +1,4 @@
+#include "../include/ensemble.hpp"
+
+template class EnsembleNetwork<float>;
+template class EnsembleNetwork<double>;
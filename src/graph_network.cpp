@@ -0,0 +1,4 @@
+#include "../include/graph_network.hpp"
+
+template class GraphNetwork<float>;
+template class GraphNetwork<double>;
\ No newline at end of file
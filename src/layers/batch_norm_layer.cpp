@@ -0,0 +1,5 @@
+// src/layers/batch_norm_layer.cpp
+#include "../../include/layers/batch_norm_layer.hpp"
+
+template class BatchNormLayer<float>;
+template class BatchNormLayer<double>;
@@ -0,0 +1,5 @@
+// src/layers/depthwise_separable_conv_layer.cpp
+#include "../../include/layers/depthwise_separable_conv_layer.hpp"
+
+template class DepthwiseSeparableConvLayer<float>;
+template class DepthwiseSeparableConvLayer<double>;
\ No newline at end of file
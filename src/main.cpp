@@ -1,23 +1,62 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include "../include/network.hpp"
-#include "../include/layers/convolutional_layer.hpp"
-#include "../include/layers/pooling_layer.hpp"
-#include "../include/layers/fully_connected_layer.hpp"
-#include "../include/layers/leaky_relu_layer.hpp"
-#include "../include/layers/elu_layer.hpp"
-#include "../include/layers/softmax_layer.hpp"
-#include "../include/layers/flatten_layer.hpp"
+#include "../include/models/mnist_cnn.hpp"
+#include "../include/models/model_io.hpp"
 #include "../include/utils/dataset.hpp"
 #include "../include/utils/logger.hpp"
+#include "../include/utils/memory_tracker.hpp"
+#include "../include/utils/autotuner.hpp"
 #include "../include/utils/metrics.hpp"
 #include "../include/utils/cross_validation.hpp"
+#include "../include/utils/distributed.hpp"
 #include "../include/trainer.hpp"
-
-int main() {
-    Logger::init("training_metrics.csv");
+#include "../include/utils/hyperparameter_search.hpp"
+#include "../include/utils/time_to_accuracy.hpp"
+#include "../include/utils/sharded_dataset.hpp"
+#include "../include/ensemble.hpp"
+#include <fstream>
+
+int main(int argc,char** argv) {
+    // Распределённый запуск: CNN_RANK/CNN_WORLD_SIZE/CNN_MASTER_ADDR (см. run_distributed.sh)
+    DistributedConfig dist=DistributedConfig::from_env();
+    // Логи процессов, кроме нулевого, - в отдельные файлы
+    std::string suffix=dist.rank==0?"":".rank"+std::to_string(dist.rank);
+    Logger::init("training_metrics"+suffix+".csv");
+    MemoryTracker::init("memory_metrics"+suffix+".csv");
+    Autotuner::init("autotune_cache.txt");
 
     try {
         using T=float;
+        std::unique_ptr<RingCommunicator> comm;
+        if(dist.world_size>1) comm.reset(new RingCommunicator(dist));
+
+        // --shards <dir>: обучение потоком из шардов (cnn_shard), валидация на тестовом наборе MNIST
+        if(argc>2&&std::strcmp(argv[1],"--shards")==0){
+            ShardedDataset shards(argv[2]);
+            size_t num_classes=shards.num_classes();
+            std::vector<MNISTImage> test=MNISTDataset::load_mnist("../data/mnist/t10k-images-idx3-ubyte",
+                                                                 "../data/mnist/t10k-labels-idx1-ubyte");
+            size_t num_features=shards.feature_dim();
+            Matrix<T> X_val_mat(test.size(),num_features,0);
+            Matrix<T> Y_val_mat(test.size(),num_classes,0);
+            for(size_t i=0;i<test.size();++i){
+                std::copy(test[i].pixels.data(),test[i].pixels.data()+num_features,X_val_mat.data()+i*num_features);
+                Y_val_mat(i,test[i].label)=1;
+            }
+            auto net=build_mnist_cnn<T>(num_classes);
+            Trainer<T> trainer;
+            auto result=trainer.train_streaming(*net,shards,X_val_mat,Y_val_mat,20,0.001f,64,0.0001f,5,1e-4f,
+                                                LossFunction::CrossEntropy);
+            save_model(*net,"mnist_cnn",num_classes,"model_shards.bin");
+            std::cout<<"Records: "<<shards.num_records()<<" in "<<shards.shards().size()<<" shards\n";
+            std::cout<<"Train Loss: "<<std::get<0>(result)<<"\n";
+            std::cout<<"Val Accuracy: "<<std::get<5>(result)<<"\n";
+            Logger::close();
+            MemoryTracker::close();
+            return 0;
+        }
 
         std::string images_path="../data/mnist/train-images-idx3-ubyte";
         std::string labels_path="../data/mnist/train-labels-idx1-ubyte";
@@ -25,6 +64,14 @@ int main() {
 
         size_t k=5;
         auto folds=CrossValidator::k_fold_split(dataset,k);
+        // --search: подбор гиперпараметров на первом фолде вместо полного прогона
+        bool search=argc>1&&std::strcmp(argv[1],"--search")==0;
+        // --time-to-accuracy <target>: на первом фолде время до точности target, обычный цикл против selective backprop
+        float target=argc>2&&std::strcmp(argv[1],"--time-to-accuracy")==0?std::strtof(argv[2],nullptr):0.0f;
+        // Оба режима - только первый фолд, без средних по фолдам и ансамбля
+        bool single_fold=search||target>0;
+        // --prune <sparsity>: постепенный прунинг FC-слоёв до sparsity к середине обучения (MagnitudePruner)
+        T prune=argc>2&&std::strcmp(argv[1],"--prune")==0?std::strtof(argv[2],nullptr):0.0f;
 
         float total_accuracy=0.0f,total_f1=0.0f,total_auc=0.0f;
         size_t fold_num=1;
@@ -56,19 +103,27 @@ int main() {
                 Y_val_mat(i,validation_data[i].label)=1;
             }
 
-            Network<T> net;
-            // CNN: 1->8 channels
-            net.add_layer(std::make_unique<ConvolutionalLayer<T>>(1,8,3,1,1));
-            net.add_layer(std::make_unique<PoolingLayer<T>>(2,2));
-            // 8->16 channels
-            net.add_layer(std::make_unique<ConvolutionalLayer<T>>(8,16,3,1,1));
-            net.add_layer(std::make_unique<PoolingLayer<T>>(2,2));
-            // Flatten -> FullyConnected -> ELU -> FullyConnected -> Softmax
-            net.add_layer(std::make_unique<FlattenLayer<T>>());
-            net.add_layer(std::make_unique<FullyConnectedLayer<T>>(7*7*16,128));
-            net.add_layer(std::make_unique<ELULayer<T>>());
-            net.add_layer(std::make_unique<FullyConnectedLayer<T>>(128,num_classes));
-            net.add_layer(std::make_unique<SoftmaxLayer<T>>());
+            if(target>0){
+                auto results=time_to_accuracy_report<T>([num_classes](){ return build_mnist_cnn<T>(num_classes); },
+                                                        X_train_mat,Y_train_mat,X_val_mat,Y_val_mat,target,20,0.001f,64,
+                                                        SelectiveBackpropConfig());
+                print_time_to_accuracy(results,target);
+                break;
+            }
+
+            if(search){
+                HyperparameterSearch<T> hs([num_classes](){ return build_mnist_cnn<T>(num_classes); },
+                                           X_train_mat,Y_train_mat,X_val_mat,Y_val_mat,"hyperparameter_search.csv");
+                TrialResult best=hs.hyperband(SearchSpace(),27);
+                std::cout<<"Best config: learning_rate="<<best.config.learning_rate
+                         <<" batch_size="<<best.config.batch_size
+                         <<" lambda="<<best.config.lambda
+                         <<" patience="<<best.config.patience
+                         <<" val_accuracy="<<best.val_accuracy<<"\n";
+                break;
+            }
+
+            auto net=build_mnist_cnn<T>(num_classes);
 
             size_t epochs=20;
             T learning_rate=0.001f;
@@ -79,9 +134,17 @@ int main() {
             LossFunction loss_fn=LossFunction::CrossEntropy;
 
             Trainer<T> trainer;
+            if(comm){
+                trainer.set_distributed(*comm);
+                trainer.set_epoch_logging(dist.rank==0);
+            }
+            if(prune>0) trainer.set_pruning(MagnitudePruner<T>(prune,0,epochs/2));
             auto [train_loss,train_acc,train_f1,train_auc,
                   val_loss,val_acc,val_f1,val_auc]=
-                  trainer.train(net,{X_train_mat},{Y_train_mat},epochs,learning_rate,batch_size,lambda,patience,min_delta,loss_fn);
+                  trainer.train(*net,{X_train_mat},{Y_train_mat},epochs,learning_rate,batch_size,lambda,patience,min_delta,loss_fn);
+
+            // Модель фолда для cnn_score (веса во всех процессах одинаковые, пишет нулевой)
+            if(dist.rank==0) save_model(*net,"mnist_cnn",num_classes,"model_fold"+std::to_string(fold_num)+".bin");
 
             std::cout<<"Fold "<<fold_num<<":\n";
             std::cout<<"Train Loss: "<<train_loss<<"\n";
@@ -92,6 +155,10 @@ int main() {
             std::cout<<"Val Accuracy: "<<val_acc<<"\n";
             std::cout<<"Val F1 Score: "<<val_f1<<"\n";
             std::cout<<"Val ROC AUC: "<<val_auc<<"\n";
+            for(size_t i=0;prune>0&&i<net->size();++i){
+                auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net->layer(i));
+                if(fc) std::cout<<"FC "<<i<<" Sparsity: "<<fc->sparsity()<<"\n";
+            }
 
             total_accuracy+=val_acc;
             total_f1+=val_f1;
@@ -100,13 +167,40 @@ int main() {
             fold_num++;
         }
 
-        std::cout<<"Средняя Accuracy: "<<total_accuracy/k<<"\n";
-        std::cout<<"Средний F1 Score: "<<total_f1/k<<"\n";
-        std::cout<<"Средний ROC AUC: "<<total_auc/k<<"\n";
+        if(!single_fold){
+            std::cout<<"Средняя Accuracy: "<<total_accuracy/k<<"\n";
+            std::cout<<"Средний F1 Score: "<<total_f1/k<<"\n";
+            std::cout<<"Средний ROC AUC: "<<total_auc/k<<"\n";
+        }
+
+        // Модели фолдов - один ансамбль (EnsembleNetwork); оценка батчами на тестовом наборе MNIST, если он есть
+        std::string test_images_path="../data/mnist/t10k-images-idx3-ubyte";
+        std::string test_labels_path="../data/mnist/t10k-labels-idx1-ubyte";
+        if(!single_fold&&dist.rank==0&&std::ifstream(test_images_path).good()){
+            std::vector<std::string> paths;
+            for(size_t f=1;f<=k;++f) paths.push_back("model_fold"+std::to_string(f)+".bin");
+            size_t num_classes=0;
+            auto ensemble=EnsembleNetwork<T>::load(paths,nullptr,&num_classes);
+            std::vector<MNISTImage> test=MNISTDataset::load_mnist(test_images_path,test_labels_path);
+            Matrix<T> preds(test.size(),num_classes,0),Y(test.size(),num_classes,0);
+            const size_t batch=256,num_features=28*28;
+            for(size_t lo=0;lo<test.size();lo+=batch){
+                size_t hi=std::min(test.size(),lo+batch);
+                Matrix<T> X(hi-lo,num_features,0);
+                for(size_t i=lo;i<hi;++i){
+                    std::copy(test[i].pixels.data(),test[i].pixels.data()+num_features,X.data()+(i-lo)*num_features);
+                    Y(i,test[i].label)=1;
+                }
+                std::vector<Matrix<T>> out=ensemble->forward({X});
+                std::copy(out[0].data(),out[0].data()+out[0].size(),preds.data()+lo*num_classes);
+            }
+            std::cout<<"Ensemble ("<<k<<" folds) Test Accuracy: "<<Metrics<T>::accuracy(preds,Y)<<"\n";
+        }
     } catch(const std::exception &ex){
         Logger::error(std::string("Исключение: ")+ex.what());
     }
 
     Logger::close();
+    MemoryTracker::close();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#include "../include/static_network.hpp"
+
+// Конфигурация модели из main.cpp, один образец 1x28x28
+template class StaticNetwork<StaticConvLayer<float,1,8,28,28,3,1,1>,
+                             StaticPoolingLayer<float,8,28,28>,
+                             StaticConvLayer<float,8,16,14,14,3,1,1>,
+                             StaticPoolingLayer<float,16,14,14>,
+                             StaticFullyConnectedLayer<float,7*7*16,128>,
+                             StaticELULayer<float,128>,
+                             StaticFullyConnectedLayer<float,128,10>,
+                             StaticSoftmaxLayer<float,10>>;
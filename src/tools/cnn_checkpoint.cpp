@@ -0,0 +1,175 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "../../include/models/mnist_cnn.hpp"
+#include "../../include/utils/activation_checkpointing.hpp"
+#include "../../include/utils/logger.hpp"
+#include "../../include/utils/memory_tracker.hpp"
+
+/**
+ * cnn_checkpoint: компромисс память/пересчёт activation checkpointing для MNIST CNN на батче [N x 784].
+ * Для каждого бюджета (--budgets, КБ; по умолчанию 1/8..1 от кэшей без checkpointing) печатает план
+ * checkpoint_tradeoff_report: начала сегментов, расчётный пик и время пересчёта. Затем план включается
+ * (enable_activation_checkpointing) и замеряется шаг forward+backward: пик памяти по MemoryTracker
+ * и лучшее время из --reps. Строка "off" - тот же шаг без checkpointing. Веса не меняются (lr=0).
+ * С --bn ещё сверяет running-статистики BatchNorm после нескольких шагов с сегментом на каждый слой
+ * и без checkpointing: пересчёт не должен их трогать, расхождение - код возврата 1.
+ */
+
+namespace {
+
+using T=float;
+
+void usage(){
+    std::cerr<<"Использование: cnn_checkpoint [--batch N] [--budgets 64,256,1024] [--reps R] [--bn]\n";
+}
+
+struct StepStats {
+    size_t peak_bytes;
+    double ms;
+};
+
+// Пик считается от памяти, живой перед шагом; log_epoch сбрасывает пик MemoryTracker
+StepStats measure_step(Network<T>& net,const Matrix<T>& X,const Matrix<T>& grad,int reps,size_t& round){
+    StepStats stats{0,1e30};
+    for(int r=0;r<reps;++r){
+        MemoryTracker::log_epoch(round++);
+        size_t base=MemoryTracker::live_bytes();
+        auto start=std::chrono::steady_clock::now();
+        net.forward({X});
+        net.backward({grad},0);
+        double ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+        stats.ms=std::min(stats.ms,ms);
+        stats.peak_bytes=std::max(stats.peak_bytes,MemoryTracker::peak_bytes()-std::min(base,MemoryTracker::peak_bytes()));
+    }
+    return stats;
+}
+
+// Максимальная разница running-статистик BatchNorm: checkpointing на каждом слое против обычного режима
+double running_stats_diff(const Matrix<T>& X,const Matrix<T>& grad,size_t steps){
+    auto plain=build_mnist_cnn<T>(10,true);
+    auto checkpointed=build_mnist_cnn<T>(10,true);
+    std::vector<ParameterView<T>> from=plain->parameters(),to=checkpointed->parameters();
+    for(size_t i=0;i<from.size();++i) std::copy(from[i].data,from[i].data+from[i].size,to[i].data);
+    std::vector<size_t> starts;
+    for(size_t i=0;i<checkpointed->size();++i) starts.push_back(i);
+    checkpointed->set_activation_checkpoints(starts);
+    for(size_t step=0;step<steps;++step){
+        for(Network<T>* net: {plain.get(),checkpointed.get()}){
+            net->forward({X});
+            net->backward({grad},(T)0.01);
+        }
+    }
+    double diff=0;
+    for(size_t i=0;i<plain->size();++i){
+        auto* a=dynamic_cast<BatchNormLayer<T>*>(&plain->layer(i));
+        auto* b=dynamic_cast<BatchNormLayer<T>*>(&checkpointed->layer(i));
+        if(!a||!b) continue;
+        for(size_t f=0;f<a->num_features();++f){
+            diff=std::max(diff,(double)std::abs(a->running_mean()[f]-b->running_mean()[f]));
+            diff=std::max(diff,(double)std::abs(a->running_var()[f]-b->running_var()[f]));
+        }
+    }
+    return diff;
+}
+
+std::string segments(const std::vector<size_t>& starts){
+    std::string s;
+    for(size_t i=0;i<starts.size();++i) s+=(i?",":"")+std::to_string(starts[i]);
+    return s;
+}
+
+} // namespace
+
+int main(int argc,char** argv){
+    size_t batch=64;
+    std::vector<size_t> budgets;
+    int reps=3;
+    bool batch_norm=false;
+    for(int i=1;i<argc;++i){
+        if(std::strcmp(argv[i],"--batch")==0&&i+1<argc){
+            batch=std::max<size_t>(1,std::strtoul(argv[++i],nullptr,10));
+        } else if(std::strcmp(argv[i],"--budgets")==0&&i+1<argc){
+            for(char* p=argv[++i];*p;){
+                char* end=nullptr;
+                budgets.push_back(std::strtoul(p,&end,10)*1024);
+                if(end==p){
+                    usage();
+                    return 1;
+                }
+                p=*end==','?end+1:end;
+            }
+        } else if(std::strcmp(argv[i],"--reps")==0&&i+1<argc){
+            reps=std::max(1,std::atoi(argv[++i]));
+        } else if(std::strcmp(argv[i],"--bn")==0){
+            batch_norm=true;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    Logger::init("checkpoint_metrics.csv");
+    MemoryTracker::init("checkpoint_memory.csv");
+    try {
+        auto net=build_mnist_cnn<T>(10,batch_norm);
+        net->set_training(true);
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<T> pixel(0,1);
+        std::normal_distribution<T> noise(0,1);
+        Matrix<T> X(batch,28*28,0),grad(batch,10,0);
+        for(size_t i=0;i<X.size();++i) X.data()[i]=pixel(gen);
+        for(size_t i=0;i<grad.size();++i) grad.data()[i]=noise(gen)/(T)batch;
+        // Прогрев: автотюнер и первые выделения не попадают в замер
+        net->forward({X});
+        net->backward({grad},0);
+
+        if(budgets.empty()){
+            size_t baseline=plan_activation_checkpoints(net->profile_layers({X}),X.size()*sizeof(T),0).baseline_peak_bytes;
+            for(size_t d=8;d>=1;d/=2) budgets.push_back(baseline/d);
+        }
+        std::vector<CheckpointPlan> plans=checkpoint_tradeoff_report(*net,{X},budgets);
+
+        size_t round=0;
+        StepStats off=measure_step(*net,X,grad,reps,round);
+        std::printf("batch %zu, layers %zu\n",batch,net->size());
+        std::printf("%10s %14s %10s %10s %13s %6s %12s %9s\n",
+                    "budget_KB","segments","plan_KB","fits","recompute_ms","+%","step_peak_KB","step_ms");
+        std::printf("%10s %14s %10.1f %10s %13.3f %6.1f %12.1f %9.3f\n","off","0",
+                    plans.empty()?0.0:plans[0].baseline_peak_bytes/1024.0,"-",0.0,0.0,off.peak_bytes/1024.0,off.ms);
+        for(size_t b=0;b<budgets.size();++b){
+            const CheckpointPlan& plan=plans[b];
+            enable_activation_checkpointing(*net,{X},budgets[b]);
+            StepStats step=measure_step(*net,X,grad,reps,round);
+            net->set_activation_checkpoints({});
+            std::printf("%10.1f %14s %10.1f %10s %13.3f %6.1f %12.1f %9.3f\n",budgets[b]/1024.0,
+                        segments(plan.segment_starts).c_str(),plan.peak_bytes/1024.0,plan.fits_budget?"yes":"no",
+                        plan.recompute_ms,plan.forward_ms>0?100.0*plan.recompute_ms/plan.forward_ms:0.0,
+                        step.peak_bytes/1024.0,step.ms);
+        }
+
+        if(batch_norm){
+            double diff=running_stats_diff(X,grad,3);
+            std::printf("\nBatchNorm running stats, checkpointed vs plain (3 steps): max diff %g\n",diff);
+            if(diff!=0){
+                std::cerr<<"cnn_checkpoint: пересчёт сегментов изменил running-статистики BatchNorm\n";
+                Logger::close();
+                MemoryTracker::close();
+                return 1;
+            }
+        }
+    } catch(const std::exception &ex){
+        Logger::error(std::string("Исключение: ")+ex.what());
+        std::cerr<<ex.what()<<"\n";
+        Logger::close();
+        MemoryTracker::close();
+        return 1;
+    }
+    Logger::close();
+    MemoryTracker::close();
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../../include/models/model_io.hpp"
+#include "../../include/utils/dataset.hpp"
+#include "../../include/utils/logger.hpp"
+#include "../../include/utils/low_rank.hpp"
+#include "../../include/utils/pruning.hpp"
+
+/**
+ * cnn_compress: низкоранговое сжатие самого большого FullyConnectedLayer обученной модели.
+ * Для каждого ранга (--ranks) и каждой доли энергии сингулярных чисел (--energy) слой
+ * заменяется парой factorize_fc. При --finetune N пара и слои после неё дообучаются N эпох SGD
+ * по одному образцу на первых 80% примеров; свёрточная часть заморожена, её выходы считаются
+ * один раз. Точность и время forward меряются на оставшихся 20%.
+ * Печатает таблицу ранг / энергия / точность / время / размер модели;
+ * --save R out.bin сохраняет модель с рангом R (архитектура mnist_cnn_lr<R>).
+ * --prune 0.5,0.9 дополнительно печатает pruning_report того же слоя: точность и время forward
+ * батча оценки при обрезке доли весов по |w| (модель в раскладке Batch, исходные веса не меняются).
+ */
+
+namespace {
+
+using T=float;
+
+void usage(){
+    std::cerr<<"Использование: cnn_compress <model.bin> <images-idx3-ubyte> <labels-idx1-ubyte>"
+               " [--ranks 8,16,32] [--energy 0.9,0.99] [--finetune N] [--lr X] [--save R out.bin]"
+               " [--prune 0.5,0.9]\n";
+}
+
+std::vector<double> parse_list(const char* s){
+    std::vector<double> values;
+    const char* p=s;
+    while(*p){
+        char* end=nullptr;
+        values.push_back(std::strtod(p,&end));
+        if(end==p) throw std::runtime_error(std::string("cnn_compress: не удалось разобрать список ")+s);
+        p=*end==','?end+1:end;
+    }
+    return values;
+}
+
+// Вход сети - одно изображение 1x28x28, метка - строка one-hot
+void to_samples(const std::vector<MNISTImage>& images,size_t first,size_t last,size_t num_classes,
+                std::vector<std::vector<Matrix<T>>>& inputs,Matrix<T>& Y){
+    inputs.clear();
+    Y=Matrix<T>(last-first,num_classes,0);
+    for(size_t i=first;i<last;++i){
+        Matrix<T> image(28,28,0);
+        for(size_t j=0;j<28*28;++j) image(j/28,j%28)=images[i].pixels(j/28,j%28);
+        inputs.push_back({image});
+        Y(i-first,images[i].label)=1;
+    }
+}
+
+} // namespace
+
+int main(int argc,char** argv){
+    if(argc<4){
+        usage();
+        return 1;
+    }
+    std::string model_path=argv[1],images_path=argv[2],labels_path=argv[3];
+    std::vector<size_t> ranks;
+    std::vector<double> energies;
+    std::vector<double> prune_levels;
+    size_t finetune_epochs=0;
+    T finetune_lr=1e-3f;
+    size_t save_rank=0;
+    std::string save_path;
+
+    try {
+        for(int i=4;i<argc;++i){
+            if(std::strcmp(argv[i],"--ranks")==0&&i+1<argc){
+                for(double r: parse_list(argv[++i])) ranks.push_back((size_t)r);
+            } else if(std::strcmp(argv[i],"--energy")==0&&i+1<argc){
+                energies=parse_list(argv[++i]);
+            } else if(std::strcmp(argv[i],"--finetune")==0&&i+1<argc){
+                finetune_epochs=std::strtoul(argv[++i],nullptr,10);
+            } else if(std::strcmp(argv[i],"--lr")==0&&i+1<argc){
+                finetune_lr=std::strtof(argv[++i],nullptr);
+            } else if(std::strcmp(argv[i],"--prune")==0&&i+1<argc){
+                prune_levels=parse_list(argv[++i]);
+            } else if(std::strcmp(argv[i],"--save")==0&&i+2<argc){
+                save_rank=std::strtoul(argv[++i],nullptr,10);
+                save_path=argv[++i];
+            } else {
+                usage();
+                return 1;
+            }
+        }
+
+        Logger::init("compression_metrics.csv");
+        std::string arch;
+        size_t num_classes=0;
+        auto net=load_model<T>(model_path,&arch,&num_classes,MnistInput::Sample);
+        if(arch!="mnist_cnn")
+            throw std::runtime_error("cnn_compress: поддерживается только архитектура mnist_cnn, в файле "+arch);
+
+        size_t index=net->size();
+        size_t largest=0;
+        for(size_t i=0;i<net->size();++i){
+            auto* fc=dynamic_cast<FullyConnectedLayer<T>*>(&net->layer(i));
+            if(fc&&fc->weights().size()>largest){
+                largest=fc->weights().size();
+                index=i;
+            }
+        }
+        if(index==net->size()) throw std::runtime_error("cnn_compress: в модели нет FullyConnected слоёв");
+        auto& fc=dynamic_cast<FullyConnectedLayer<T>&>(net->layer(index));
+        size_t in=fc.input_size(),out=fc.output_size();
+        std::vector<T> singular=fc_singular_values(fc);
+        for(double e: energies) ranks.push_back(rank_for_energy(singular,(T)e));
+        if(ranks.empty()){
+            for(size_t r=4;r<std::min(in,out);r*=2) ranks.push_back(r);
+        }
+        std::sort(ranks.begin(),ranks.end());
+        ranks.erase(std::unique(ranks.begin(),ranks.end()),ranks.end());
+
+        std::vector<MNISTImage> images=MNISTDataset::load_mnist(images_path,labels_path);
+        size_t split=images.size()*8/10;
+        std::vector<std::vector<Matrix<T>>> train_inputs,eval_inputs;
+        Matrix<T> Y_train,Y_eval;
+        to_samples(images,0,split,num_classes,train_inputs,Y_train);
+        to_samples(images,split,images.size(),num_classes,eval_inputs,Y_eval);
+
+        std::function<void(Network<T>&)> fine_tune;
+        std::vector<std::vector<Matrix<T>>> train_features;
+        if(finetune_epochs>0){
+            // Слои до index не меняются ни факторизацией, ни дообучением
+            net->set_training(false);
+            for(auto &in: train_inputs) train_features.push_back(net->forward_range(0,index,in));
+            fine_tune=[&](Network<T>& n){
+                for(size_t i=index;i<n.size();++i) n.layer(i).set_training(true);
+                Matrix<T> target(1,num_classes,0);
+                for(size_t epoch=0;epoch<finetune_epochs;++epoch){
+                    for(size_t i=0;i<train_features.size();++i){
+                        std::copy(Y_train.data()+i*num_classes,Y_train.data()+(i+1)*num_classes,target.data());
+                        std::vector<Matrix<T>> preds=n.forward_range(index,n.size(),train_features[i]);
+                        // SoftmaxLayer::backward пропускает градиент как есть: нужен градиент Softmax+CE по логитам
+                        n.backward_range(index,n.size(),{preds[0]-target},finetune_lr);
+                    }
+                }
+                n.set_training(false);
+            };
+        }
+
+        std::cout<<"Слой "<<index<<": "<<in<<" -> "<<out<<", ранг окупается до "<<max_profitable_rank(in,out)<<"\n";
+        std::vector<LowRankReportRow> rows=low_rank_report(*net,index,eval_inputs,Y_eval,ranks,fine_tune);
+        const LowRankReportRow& base=rows[0];
+        std::printf("%6s %8s %9s %11s %9s %10s %8s\n","rank","energy","accuracy","forward_ms","speedup","size_KB","size_x");
+        for(auto &row: rows){
+            std::printf("%6s %8.4f %9.4f %11.3f %9.2f %10.1f %8.2f\n",
+                        row.rank==0?"full":std::to_string(row.rank).c_str(),row.energy,row.accuracy,row.forward_ms,
+                        base.forward_ms/row.forward_ms,row.model_bytes/1024.0,(double)base.model_bytes/row.model_bytes);
+        }
+
+        if(!prune_levels.empty()){
+            // pruning_report гоняет весь набор оценки одним батчем [N x 784]
+            auto batch_net=load_model<T>(model_path,nullptr,nullptr,MnistInput::Batch);
+            auto& batch_fc=dynamic_cast<FullyConnectedLayer<T>&>(batch_net->layer(index));
+            Matrix<T> X_eval(eval_inputs.size(),28*28,0);
+            for(size_t i=0;i<eval_inputs.size();++i){
+                const Matrix<T>& image=eval_inputs[i][0];
+                std::copy(image.data(),image.data()+image.size(),X_eval.data()+i*X_eval.cols());
+            }
+            std::vector<T> sparsities(prune_levels.begin(),prune_levels.end());
+            sparsities.insert(sparsities.begin(),0);
+            std::vector<PruningReportRow> prune_rows=pruning_report(*batch_net,batch_fc,X_eval,Y_eval,sparsities);
+            std::printf("\n%8s %9s %11s %9s %7s\n","sparsity","accuracy","forward_ms","speedup","sparse");
+            for(auto &row: prune_rows){
+                std::printf("%8.3f %9.4f %11.3f %9.2f %7s\n",row.sparsity,row.accuracy,row.forward_ms,
+                            prune_rows[0].forward_ms/row.forward_ms,row.sparse_path?"yes":"no");
+            }
+        }
+
+        if(save_rank>0){
+            factorize_fc(*net,index,save_rank);
+            if(fine_tune) fine_tune(*net);
+            save_model(*net,"mnist_cnn_lr"+std::to_string(save_rank),num_classes,save_path);
+            std::cout<<"Сохранено: "<<save_path<<" (mnist_cnn_lr"<<save_rank<<")\n";
+        }
+    } catch(const std::exception &ex){
+        Logger::error(std::string("Исключение: ")+ex.what());
+        std::cerr<<ex.what()<<"\n";
+        Logger::close();
+        return 1;
+    }
+    Logger::close();
+    return 0;
+}
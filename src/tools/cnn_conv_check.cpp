@@ -0,0 +1,166 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "../../include/layers/convolutional_layer.hpp"
+#include "../../include/utils/autotuner.hpp"
+
+/**
+ * cnn_conv_check: проверка пути Winograd F(2x2,3x3) в ConvolutionalLayer против прямой свёртки.
+ * Точность (double): forward и градиент по входу Winograd против прямого пути и градиент по входу
+ * обоих путей против центральных разностей, padding 0..2, groups 1 и 2. Код возврата 1 -
+ * расхождение больше допуска. Скорость (float): forward и backward на входе --size x --size
+ * для C->2C каналов, C из --channels.
+ */
+
+namespace {
+
+void usage(){
+    std::cerr<<"Использование: cnn_conv_check [--size N] [--channels 8,16,32] [--reps R]\n";
+}
+
+template<typename T>
+void fill_random(std::vector<Matrix<T>>& channels,std::mt19937& gen){
+    std::normal_distribution<double> dist(0,1);
+    for(auto &m: channels) for(size_t i=0;i<m.size();++i) m.data()[i]=(T)dist(gen);
+}
+
+double max_abs_diff(const std::vector<Matrix<double>>& a,const std::vector<Matrix<double>>& b){
+    double err=0;
+    for(size_t c=0;c<a.size();++c)
+        for(size_t i=0;i<a[c].size();++i) err=std::max(err,std::abs(a[c].data()[i]-b[c].data()[i]));
+    return err;
+}
+
+// Выход и градиент по входу для loss = sum(out*R); learning_rate 0 - веса не меняются
+std::vector<Matrix<double>> input_gradient(ConvolutionalLayer<double>& conv,bool winograd,const std::vector<Matrix<double>>& x,
+                                           const std::vector<Matrix<double>>& R,std::vector<Matrix<double>>* out){
+    conv.set_winograd(winograd);
+    std::vector<Matrix<double>> y=conv.forward(x);
+    if(out) *out=y;
+    return conv.backward(R,0.0);
+}
+
+double loss(ConvolutionalLayer<double>& conv,const std::vector<Matrix<double>>& x,const std::vector<Matrix<double>>& R){
+    conv.set_training(false);
+    std::vector<Matrix<double>> y=conv.forward(x);
+    conv.set_training(true);
+    double s=0;
+    for(size_t c=0;c<y.size();++c)
+        for(size_t i=0;i<y[c].size();++i) s+=y[c].data()[i]*R[c].data()[i];
+    return s;
+}
+
+bool check_accuracy(){
+    const double path_tol=1e-9,numeric_tol=1e-6,h=1e-5;
+    std::mt19937 gen(1);
+    bool ok=true;
+    std::printf("%-16s %12s %12s %12s %12s\n","shape","fwd W-D","grad W-D","grad W-num","grad D-num");
+    struct Shape { int in,out,groups; };
+    for(const Shape& s: {Shape{3,4,1},Shape{4,6,2}}){
+        for(int padding=0;padding<=2;++padding){
+            ConvolutionalLayer<double> conv(s.in,s.out,3,1,padding,s.groups);
+            std::vector<Matrix<double>> x(s.in,Matrix<double>(7,9,0));
+            fill_random(x,gen);
+            int out_h=7-3+2*padding+1,out_w=9-3+2*padding+1;
+            std::vector<Matrix<double>> R(s.out,Matrix<double>(out_h,out_w,0));
+            fill_random(R,gen);
+
+            std::vector<Matrix<double>> yw,yd;
+            std::vector<Matrix<double>> gw=input_gradient(conv,true,x,R,&yw);
+            std::vector<Matrix<double>> gd=input_gradient(conv,false,x,R,&yd);
+            double numeric_w=0,numeric_d=0;
+            for(size_t c=0;c<x.size();++c){
+                for(size_t i=0;i<x[c].size();++i){
+                    std::vector<Matrix<double>> xp=x,xm=x;
+                    xp[c].data()[i]+=h;
+                    xm[c].data()[i]-=h;
+                    double numeric=(loss(conv,xp,R)-loss(conv,xm,R))/(2*h);
+                    numeric_w=std::max(numeric_w,std::abs(numeric-gw[c].data()[i]));
+                    numeric_d=std::max(numeric_d,std::abs(numeric-gd[c].data()[i]));
+                }
+            }
+            double fwd=max_abs_diff(yw,yd),grad=max_abs_diff(gw,gd);
+            char name[64];
+            std::snprintf(name,sizeof(name),"%d>%d g%d p%d",s.in,s.out,s.groups,padding);
+            std::printf("%-16s %12.2e %12.2e %12.2e %12.2e\n",name,fwd,grad,numeric_w,numeric_d);
+            if(fwd>path_tol||grad>path_tol||numeric_w>numeric_tol||numeric_d>numeric_tol) ok=false;
+        }
+    }
+    return ok;
+}
+
+template<typename Run>
+double best_ms(int reps,Run run){
+    run(); // прогрев
+    double best=1e30;
+    for(int r=0;r<reps;++r){
+        auto start=std::chrono::steady_clock::now();
+        run();
+        best=std::min(best,std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+    }
+    return best;
+}
+
+void benchmark(int size,const std::vector<int>& channels,int reps){
+    std::mt19937 gen(2);
+    std::printf("\n%6s %12s %12s %8s %12s %12s %8s\n","C","fwd direct","fwd wino","x","bwd direct","bwd wino","x");
+    for(int c: channels){
+        ConvolutionalLayer<float> conv(c,2*c,3,1,1);
+        std::vector<Matrix<float>> x(c,Matrix<float>(size,size,0)),R(2*c,Matrix<float>(size,size,0));
+        fill_random(x,gen);
+        fill_random(R,gen);
+        double ms[2][2];
+        for(int winograd=0;winograd<2;++winograd){
+            conv.set_winograd(winograd==1);
+            conv.set_training(false);
+            ms[winograd][0]=best_ms(reps,[&](){ conv.forward(x); });
+            conv.set_training(true);
+            ms[winograd][1]=best_ms(reps,[&](){
+                conv.forward(x);
+                conv.backward(R,0.0f);
+            })-ms[winograd][0];
+        }
+        std::printf("%6d %12.2f %12.2f %8.2f %12.2f %12.2f %8.2f\n",c,ms[0][0],ms[1][0],ms[0][0]/ms[1][0],
+                    ms[0][1],ms[1][1],ms[0][1]/ms[1][1]);
+    }
+}
+
+} // namespace
+
+int main(int argc,char** argv){
+    int size=64,reps=5;
+    std::vector<int> channels{8,16,32};
+    for(int i=1;i<argc;++i){
+        if(std::strcmp(argv[i],"--size")==0&&i+1<argc){
+            size=std::atoi(argv[++i]);
+        } else if(std::strcmp(argv[i],"--reps")==0&&i+1<argc){
+            reps=std::atoi(argv[++i]);
+        } else if(std::strcmp(argv[i],"--channels")==0&&i+1<argc){
+            channels.clear();
+            for(const char* p=argv[++i];*p;){
+                char* end=nullptr;
+                channels.push_back((int)std::strtol(p,&end,10));
+                if(end==p) break;
+                p=*end==','?end+1:end;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    // Алгоритм задаёт set_winograd; подбор числа задач не должен попадать в замеры таблицы
+    Autotuner::set_enabled(false);
+
+    bool ok=check_accuracy();
+    benchmark(size,channels,reps);
+    if(!ok){
+        std::cerr<<"cnn_conv_check: Winograd расходится с прямой свёрткой\n";
+        return 1;
+    }
+    return 0;
+}
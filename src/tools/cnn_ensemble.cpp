@@ -0,0 +1,123 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../../include/ensemble.hpp"
+#include "../../include/utils/dataset.hpp"
+#include "../../include/utils/logger.hpp"
+#include "../../include/utils/metrics.hpp"
+
+/**
+ * cnn_ensemble: точность и время inference моделей (например, model_fold*.bin) по отдельности
+ * и как EnsembleNetwork. Каждая модель и ансамбль прогоняются по первым --limit изображениям
+ * (по умолчанию все) батчами [--batch x 28*28] (по умолчанию 256); ускорение ансамбля считается
+ * против суммы N отдельных батчевых прогонов.
+ */
+
+namespace {
+
+using T=float;
+
+void usage(){
+    std::cerr<<"Использование: cnn_ensemble <images-idx3-ubyte> <labels-idx1-ubyte> <model.bin>... [--limit N] [--batch B]\n";
+}
+
+struct Row {
+    std::string name;
+    float accuracy;
+    double ms;
+};
+
+// Изображения батчами [B x 28*28], строка - образец
+std::vector<Matrix<T>> make_batches(const std::vector<MNISTImage>& images,size_t batch){
+    std::vector<Matrix<T>> batches;
+    for(size_t lo=0;lo<images.size();lo+=batch){
+        size_t hi=std::min(images.size(),lo+batch);
+        Matrix<T> X(hi-lo,28*28,0);
+        for(size_t i=lo;i<hi;++i) std::copy(images[i].pixels.data(),images[i].pixels.data()+28*28,X.data()+(i-lo)*28*28);
+        batches.push_back(std::move(X));
+    }
+    return batches;
+}
+
+template<typename Forward>
+Row evaluate(const std::string& name,const std::vector<MNISTImage>& images,const std::vector<Matrix<T>>& batches,
+             size_t num_classes,Forward forward){
+    Matrix<T> preds(images.size(),num_classes,0),Y(images.size(),num_classes,0);
+    // Первый прогон подбирает ядра (Autotuner) - в замер не входит
+    if(!batches.empty()) forward(std::vector<Matrix<T>>{batches[0]});
+    auto start=std::chrono::steady_clock::now();
+    size_t row=0;
+    for(auto &X: batches){
+        std::vector<Matrix<T>> out=forward(std::vector<Matrix<T>>{X});
+        std::copy(out[0].data(),out[0].data()+out[0].size(),preds.data()+row*num_classes);
+        row+=X.rows();
+    }
+    double ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    for(size_t i=0;i<images.size();++i) Y(i,images[i].label)=1;
+    return {name,Metrics<T>::accuracy(preds,Y),ms};
+}
+
+} // namespace
+
+int main(int argc,char** argv){
+    if(argc<4){
+        usage();
+        return 1;
+    }
+    std::string images_path=argv[1],labels_path=argv[2];
+    std::vector<std::string> model_paths;
+    size_t limit=0;
+    size_t batch=256;
+    for(int i=3;i<argc;++i){
+        if(std::strcmp(argv[i],"--limit")==0&&i+1<argc){
+            limit=std::strtoul(argv[++i],nullptr,10);
+        } else if(std::strcmp(argv[i],"--batch")==0&&i+1<argc){
+            batch=std::max<size_t>(1,std::strtoul(argv[++i],nullptr,10));
+        } else if(argv[i][0]=='-'){
+            usage();
+            return 1;
+        } else {
+            model_paths.push_back(argv[i]);
+        }
+    }
+    if(model_paths.empty()){
+        usage();
+        return 1;
+    }
+
+    Logger::init("ensemble_metrics.csv");
+    try {
+        std::vector<MNISTImage> images=MNISTDataset::load_mnist(images_path,labels_path);
+        if(limit>0&&limit<images.size()) images.resize(limit);
+        std::vector<Matrix<T>> batches=make_batches(images,batch);
+
+        std::vector<Row> rows;
+        size_t num_classes=0;
+        double separate_ms=0;
+        for(auto &path: model_paths){
+            auto net=load_model<T>(path,nullptr,&num_classes,MnistInput::Batch);
+            fold_batch_norm(*net);
+            rows.push_back(evaluate(path,images,batches,num_classes,[&](const std::vector<Matrix<T>>& x){ return net->forward(x); }));
+            separate_ms+=rows.back().ms;
+        }
+        auto ensemble=EnsembleNetwork<T>::load(model_paths,nullptr,&num_classes);
+        rows.push_back(evaluate("ensemble",images,batches,num_classes,[&](const std::vector<Matrix<T>>& x){ return ensemble->forward(x); }));
+
+        std::printf("%-32s %9s %11s\n","model","accuracy","ms");
+        for(auto &r: rows) std::printf("%-32s %9.4f %11.1f\n",r.name.c_str(),r.accuracy,r.ms);
+        std::printf("ensemble of %zu, batch %zu: %.2fx time of one model, %.2fx faster than %zu separate batched passes\n",
+                    model_paths.size(),batch,rows.back().ms/(separate_ms/model_paths.size()),separate_ms/rows.back().ms,
+                    model_paths.size());
+        Logger::info("Ensemble: "+std::to_string(model_paths.size())+" models, accuracy "+std::to_string(rows.back().accuracy)+
+                     ", "+std::to_string(rows.back().ms)+" ms vs "+std::to_string(separate_ms)+" ms separate");
+    } catch(const std::exception &ex){
+        Logger::error(std::string("Исключение: ")+ex.what());
+        std::cerr<<ex.what()<<"\n";
+        Logger::close();
+        return 1;
+    }
+    Logger::close();
+    return 0;
+}
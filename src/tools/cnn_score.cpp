@@ -0,0 +1,255 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "../../include/models/mnist_cnn.hpp"
+#include "../../include/models/model_io.hpp"
+#include "../../include/utils/batch_norm_folding.hpp"
+#include "../../include/utils/bounded_queue.hpp"
+#include "../../include/utils/dataset.hpp"
+#include "../../include/utils/logger.hpp"
+#include "../../include/utils/thread_pool.hpp"
+
+/**
+ * cnn_score: пакетный скоринг файла изображений IDX обученной моделью (save_model).
+ * Четыре стадии в своих потоках, связанные BoundedQueue: чтение файла кусками,
+ * нормализация пикселей, inference и запись результата. Inference идёт через StaticMnistCnn
+ * без кэшей backward: изображения батча раздаются по ThreadPool, у каждой задачи своя копия
+ * статической сети (её промежуточные буферы не разделяются между потоками).
+ *
+ * Формат csv: index,prediction,p0..pN-1.
+ * Формат bin: "CNNSCOR1", u64 число изображений, u64 число классов, затем на изображение
+ * u32 предсказанный класс и N float вероятностей (little-endian, как на x86).
+ */
+
+namespace {
+
+using T=float;
+const int num_classes=10;
+using ScoringNet=StaticMnistCnn<T,num_classes>;
+
+struct RawChunk {
+    size_t first=0;
+    size_t count=0;
+    std::vector<unsigned char> pixels;
+};
+
+struct InputChunk {
+    size_t first=0;
+    size_t count=0;
+    std::vector<T> pixels;
+};
+
+struct ScoredChunk {
+    size_t first=0;
+    size_t count=0;
+    std::vector<uint32_t> predictions;
+    std::vector<T> probabilities;
+};
+
+// Копии статической сети для задач ThreadPool; копия берётся на время задачи и возвращается
+class NetPool {
+private:
+    const Network<T>& source_;
+    std::vector<std::unique_ptr<ScoringNet>> free_;
+    std::mutex mtx_;
+public:
+    explicit NetPool(const Network<T>& source) : source_(source) {}
+
+    std::unique_ptr<ScoringNet> acquire(){
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(!free_.empty()){
+                std::unique_ptr<ScoringNet> net=std::move(free_.back());
+                free_.pop_back();
+                return net;
+            }
+        }
+        std::unique_ptr<ScoringNet> net(new ScoringNet());
+        net->load_from(source_);
+        return net;
+    }
+
+    void release(std::unique_ptr<ScoringNet> net){
+        std::lock_guard<std::mutex> lock(mtx_);
+        free_.push_back(std::move(net));
+    }
+};
+
+void write_or_throw(std::FILE* f,const void* data,size_t bytes){
+    if(bytes>0&&std::fwrite(data,1,bytes,f)!=bytes) throw std::runtime_error("cnn_score: ошибка записи результата");
+}
+
+void usage(){
+    std::cerr<<"Использование: cnn_score <model.bin> <images-idx3-ubyte> <output> [--format csv|bin] [--batch N]\n";
+}
+
+} // namespace
+
+int main(int argc,char** argv){
+    if(argc<4){
+        usage();
+        return 1;
+    }
+    std::string model_path=argv[1],images_path=argv[2],output_path=argv[3];
+    bool binary=false;
+    size_t batch_size=4096;
+    for(int i=4;i<argc;++i){
+        if(std::strcmp(argv[i],"--format")==0&&i+1<argc){
+            std::string format=argv[++i];
+            if(format!="csv"&&format!="bin"){
+                usage();
+                return 1;
+            }
+            binary=format=="bin";
+        } else if(std::strcmp(argv[i],"--batch")==0&&i+1<argc){
+            batch_size=std::max<long>(1,std::atol(argv[++i]));
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    try {
+        size_t classes=0;
+        std::string arch;
+        auto net=load_model<T>(model_path,&arch,&classes);
+        if(classes!=(size_t)num_classes)
+            throw std::runtime_error("cnn_score: модель на "+std::to_string(classes)+" классов, поддерживается "+std::to_string(num_classes));
+        // Ранг сжатой модели известен только во время выполнения, статическая сеть его не повторит
+        if(arch.compare(0,12,"mnist_cnn_lr")==0)
+            throw std::runtime_error("cnn_score: архитектура "+arch+" не поддерживается статическим inference");
+        fold_batch_norm(*net);
+        NetPool pool(*net);
+
+        IdxImageStream stream(images_path);
+        if(stream.rows()!=28||stream.cols()!=28)
+            throw std::runtime_error("cnn_score: модель ожидает изображения 28x28");
+        size_t total=stream.num_images();
+        size_t image_size=stream.image_size();
+
+        std::FILE* out=std::fopen(output_path.c_str(),"wb");
+        if(!out) throw std::runtime_error("cnn_score: не удалось открыть "+output_path);
+        std::vector<char> out_buffer(1<<20);
+        std::setvbuf(out,out_buffer.data(),_IOFBF,out_buffer.size());
+
+        BoundedQueue<RawChunk> raw_q(2);
+        BoundedQueue<InputChunk> input_q(2);
+        BoundedQueue<ScoredChunk> scored_q(2);
+        std::exception_ptr error;
+        std::mutex error_mtx;
+        auto fail=[&](){
+            {
+                std::lock_guard<std::mutex> lock(error_mtx);
+                if(!error) error=std::current_exception();
+            }
+            raw_q.close();
+            input_q.close();
+            scored_q.close();
+        };
+
+        auto start=std::chrono::steady_clock::now();
+
+        std::thread reader([&](){
+            try{
+                size_t first=0;
+                while(true){
+                    RawChunk chunk;
+                    chunk.first=first;
+                    chunk.count=stream.read(batch_size,chunk.pixels);
+                    if(chunk.count==0) break;
+                    first+=chunk.count;
+                    if(!raw_q.push(std::move(chunk))) return;
+                }
+                raw_q.close();
+            }catch(...){ fail(); }
+        });
+
+        std::thread preprocessor([&](){
+            try{
+                RawChunk raw;
+                while(raw_q.pop(raw)){
+                    InputChunk chunk;
+                    chunk.first=raw.first;
+                    chunk.count=raw.count;
+                    chunk.pixels.resize(raw.pixels.size());
+                    for(size_t i=0;i<raw.pixels.size();++i) chunk.pixels[i]=raw.pixels[i]/255.0f;
+                    if(!input_q.push(std::move(chunk))) return;
+                }
+                input_q.close();
+            }catch(...){ fail(); }
+        });
+
+        std::thread writer([&](){
+            try{
+                if(binary){
+                    uint64_t header[2]={(uint64_t)total,(uint64_t)num_classes};
+                    write_or_throw(out,"CNNSCOR1",8);
+                    write_or_throw(out,header,sizeof(header));
+                } else {
+                    std::fprintf(out,"index,prediction");
+                    for(int c=0;c<num_classes;++c) std::fprintf(out,",p%d",c);
+                    std::fprintf(out,"\n");
+                }
+                ScoredChunk chunk;
+                while(scored_q.pop(chunk)){
+                    for(size_t i=0;i<chunk.count;++i){
+                        const T* p=&chunk.probabilities[i*num_classes];
+                        if(binary){
+                            write_or_throw(out,&chunk.predictions[i],sizeof(uint32_t));
+                            write_or_throw(out,p,num_classes*sizeof(T));
+                        } else {
+                            std::fprintf(out,"%zu,%u",chunk.first+i,chunk.predictions[i]);
+                            for(int c=0;c<num_classes;++c) std::fprintf(out,",%.6g",p[c]);
+                            std::fprintf(out,"\n");
+                        }
+                    }
+                }
+            }catch(...){ fail(); }
+        });
+
+        // Inference в основном потоке: он же участвует в parallel_for
+        try{
+            InputChunk chunk;
+            while(input_q.pop(chunk)){
+                ScoredChunk scored;
+                scored.first=chunk.first;
+                scored.count=chunk.count;
+                scored.predictions.resize(chunk.count);
+                scored.probabilities.resize(chunk.count*num_classes);
+                parallel_for(0,chunk.count,64,[&](size_t lo,size_t hi){
+                    std::unique_ptr<ScoringNet> snet=pool.acquire();
+                    ScoringNet::input_type input;
+                    for(size_t i=lo;i<hi;++i){
+                        const T* x=&chunk.pixels[i*image_size];
+                        std::copy(x,x+image_size,input.begin());
+                        const ScoringNet::output_type& probs=snet->forward(input);
+                        std::copy(probs.begin(),probs.end(),&scored.probabilities[i*num_classes]);
+                        scored.predictions[i]=(uint32_t)(std::max_element(probs.begin(),probs.end())-probs.begin());
+                    }
+                    pool.release(std::move(snet));
+                });
+                if(!scored_q.push(std::move(scored))) break;
+            }
+            scored_q.close();
+        }catch(...){ fail(); }
+
+        reader.join();
+        preprocessor.join();
+        writer.join();
+        bool closed_ok=std::fclose(out)==0;
+        if(error) std::rethrow_exception(error);
+        if(!closed_ok) throw std::runtime_error("cnn_score: ошибка записи "+output_path);
+
+        double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        Logger::info("cnn_score: "+arch+", изображений "+std::to_string(total)+
+                     ", "+std::to_string(seconds)+" с, "+std::to_string(seconds>0?total/seconds:0.0)+" изображений/с");
+    } catch(const std::exception &ex){
+        Logger::error(std::string("Исключение: ")+ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../../include/utils/dataset.hpp"
+#include "../../include/utils/sharded_dataset.hpp"
+#include "../../include/utils/batch_loader.hpp"
+#include "../../include/utils/logger.hpp"
+
+/**
+ * cnn_shard: перекладывает пару файлов IDX в шарды ShardedDataset (каталог out_dir).
+ * --shard-size N - записей в шарде; --bench B - после записи сравнивает одну эпоху батчей
+ * размера B из шардов (StreamingBatchLoader) с BatchLoader по тем же данным в памяти.
+ */
+
+namespace {
+
+using T=float;
+
+void usage(){
+    std::cerr<<"Использование: cnn_shard <images-idx3-ubyte> <labels-idx1-ubyte> <out_dir>"
+               " [--shard-size N] [--classes C] [--bench B]\n";
+}
+
+template<typename Loader>
+double samples_per_second(Loader& loader,size_t batch_size,T& checksum){
+    auto start=std::chrono::steady_clock::now();
+    Batch<T> batch;
+    size_t batches=0;
+    while(loader.next(batch)){
+        checksum+=batch.X.data()[0];
+        ++batches;
+    }
+    double s=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    return s>0?batches*batch_size/s:0.0;
+}
+
+} // namespace
+
+int main(int argc,char** argv){
+    if(argc<4){
+        usage();
+        return 1;
+    }
+    std::string images_path=argv[1],labels_path=argv[2],out_dir=argv[3];
+    size_t shard_size=10000,num_classes=10,bench_batch=0;
+    for(int i=4;i<argc;++i){
+        if(std::strcmp(argv[i],"--shard-size")==0&&i+1<argc){
+            shard_size=std::strtoul(argv[++i],nullptr,10);
+        } else if(std::strcmp(argv[i],"--classes")==0&&i+1<argc){
+            num_classes=std::strtoul(argv[++i],nullptr,10);
+        } else if(std::strcmp(argv[i],"--bench")==0&&i+1<argc){
+            bench_batch=std::strtoul(argv[++i],nullptr,10);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    Logger::init("shard_metrics.csv");
+    try {
+        size_t total=write_shards_from_idx(images_path,labels_path,out_dir,num_classes,shard_size);
+        ShardedDataset dataset(out_dir);
+        std::cout<<"Записано "<<total<<" записей в "<<dataset.shards().size()<<" шардов: "<<out_dir<<"\n";
+
+        if(bench_batch>0){
+            std::vector<MNISTImage> images=MNISTDataset::load_mnist(images_path,labels_path);
+            size_t dim=dataset.feature_dim();
+            Matrix<T> X(images.size(),dim,0),Y(images.size(),num_classes,0);
+            for(size_t i=0;i<images.size();++i){
+                std::copy(images[i].pixels.data(),images[i].pixels.data()+dim,X.data()+i*dim);
+                Y(i,images[i].label)=1;
+            }
+            std::vector<size_t> indices(images.size());
+            for(size_t i=0;i<indices.size();++i) indices[i]=i;
+            std::mt19937 rng(42);
+            std::shuffle(indices.begin(),indices.end(),rng);
+
+            T checksum=0;
+            BatchLoader<T> memory(X,Y,indices,bench_batch);
+            double memory_rate=samples_per_second(memory,bench_batch,checksum);
+            StreamingBatchLoader<T> streaming(dataset,bench_batch,42);
+            double streaming_rate=samples_per_second(streaming,bench_batch,checksum);
+            std::printf("%10s %14s\n","loader","samples/s");
+            std::printf("%10s %14.0f\n","memory",memory_rate);
+            std::printf("%10s %14.0f\n","streaming",streaming_rate);
+            Logger::info("Loader bench: batch "+std::to_string(bench_batch)+", memory "+std::to_string(memory_rate)+
+                         " samples/s, streaming "+std::to_string(streaming_rate)+" samples/s (checksum "+std::to_string(checksum)+")");
+        }
+    } catch(const std::exception &ex){
+        Logger::error(std::string("Исключение: ")+ex.what());
+        std::cerr<<ex.what()<<"\n";
+        Logger::close();
+        return 1;
+    }
+    Logger::close();
+    return 0;
+}
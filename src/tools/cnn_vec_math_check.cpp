@@ -0,0 +1,174 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include "../../include/utils/vec_math.hpp"
+
+/**
+ * cnn_vec_math_check: точность и скорость vec_math::exp/expm1/log (float) против libm.
+ * Точность: перебор битовых шаблонов float с шагом --stride (1 - все 2^32 значения),
+ * эталон - функция double, округлённая до float. Precise - максимум ошибки в ULP,
+ * Fast - максимум относительной ошибки там, где эталон нормальный. Код возврата 1 - ошибка
+ * больше допуска. Скорость: нс на элемент на массиве из --size значений рабочего диапазона.
+ * Ядро выбирается по CPU; CNN_SIMD=scalar проверяет переносимый вариант.
+ */
+
+namespace {
+
+const int64_t precise_ulp_tol=2;
+const double fast_rel_tol=1e-3;
+
+void usage(){
+    std::cerr<<"Использование: cnn_vec_math_check [--stride S] [--size N] [--reps R]\n";
+}
+
+typedef void (*VecFn)(const float*,float*,size_t,MathAccuracy);
+
+struct Function {
+    const char* name;
+    VecFn vec;
+    double (*ref)(double); // эталон точности
+    float (*libm)(float);  // эталон скорости
+    float lo,hi; // диапазон для замера скорости
+    bool has_fast;
+};
+
+float from_bits(uint32_t b){
+    float f;
+    std::memcpy(&f,&b,4);
+    return f;
+}
+
+// Монотонная нумерация float: соседние значения отличаются на 1
+int64_t ordinal(float f){
+    uint32_t b;
+    std::memcpy(&b,&f,4);
+    return (b&0x80000000u)?-(int64_t)(b&0x7fffffffu):(int64_t)b;
+}
+
+int64_t ulp_distance(float a,float b){
+    if(std::isnan(a)||std::isnan(b)) return std::isnan(a)&&std::isnan(b)?0:std::numeric_limits<int64_t>::max();
+    if(a==b) return 0; // в том числе +0/-0
+    int64_t d=ordinal(a)-ordinal(b);
+    return d<0?-d:d;
+}
+
+struct Accuracy {
+    int64_t max_ulp=0;
+    float worst_x=0;
+    double max_rel=0;
+    float worst_rel_x=0;
+};
+
+Accuracy check(const Function& fn,MathAccuracy accuracy,uint64_t stride){
+    const size_t chunk=4096;
+    std::vector<float> x(chunk),y(chunk);
+    Accuracy acc;
+    uint64_t bits=0;
+    while(bits<=0xffffffffull){
+        size_t n=0;
+        for(;n<chunk&&bits<=0xffffffffull;++n,bits+=stride) x[n]=from_bits((uint32_t)bits);
+        fn.vec(x.data(),y.data(),n,accuracy);
+        for(size_t i=0;i<n;++i){
+            float ref=(float)fn.ref((double)x[i]);
+            if(accuracy==MathAccuracy::Precise){
+                int64_t ulp=ulp_distance(y[i],ref);
+                if(ulp>acc.max_ulp){
+                    acc.max_ulp=ulp;
+                    acc.worst_x=x[i];
+                }
+            } else if(std::isfinite(ref)&&std::abs(ref)>=FLT_MIN){
+                double rel=std::abs((double)y[i]-(double)ref)/std::abs((double)ref);
+                if(!(rel<=acc.max_rel)){
+                    acc.max_rel=rel;
+                    acc.worst_rel_x=x[i];
+                }
+            }
+        }
+    }
+    return acc;
+}
+
+template<typename Run>
+double best_ns(int reps,size_t n,Run run){
+    run(); // прогрев
+    double best=1e30;
+    for(int r=0;r<reps;++r){
+        auto start=std::chrono::steady_clock::now();
+        run();
+        best=std::min(best,std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count());
+    }
+    return best/(double)n;
+}
+
+} // namespace
+
+int main(int argc,char** argv){
+    uint64_t stride=257;
+    size_t size=1<<16;
+    int reps=20;
+    for(int i=1;i<argc;++i){
+        if(std::strcmp(argv[i],"--stride")==0&&i+1<argc){
+            stride=std::max<uint64_t>(1,std::strtoull(argv[++i],nullptr,10));
+        } else if(std::strcmp(argv[i],"--size")==0&&i+1<argc){
+            size=std::max<size_t>(1,std::strtoul(argv[++i],nullptr,10));
+        } else if(std::strcmp(argv[i],"--reps")==0&&i+1<argc){
+            reps=std::max(1,std::atoi(argv[++i]));
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    const Function functions[]={
+        {"exp",vec_math::exp,[](double v){ return std::exp(v); },[](float v){ return std::exp(v); },-20.0f,20.0f,true},
+        {"expm1",vec_math::expm1,[](double v){ return std::expm1(v); },[](float v){ return std::expm1(v); },-20.0f,20.0f,true},
+        {"log",vec_math::log,[](double v){ return std::log(v); },[](float v){ return std::log(v); },1e-6f,1e6f,false},
+    };
+
+    std::printf("isa: %s, stride %llu\n",vec_math::isa(),(unsigned long long)stride);
+    std::printf("%-6s %12s %14s %12s %14s\n","fn","precise ulp","at x","fast rel","at x");
+    bool ok=true;
+    for(const Function& fn: functions){
+        Accuracy precise=check(fn,MathAccuracy::Precise,stride);
+        ok=ok&&precise.max_ulp<=precise_ulp_tol;
+        if(fn.has_fast){
+            Accuracy fast=check(fn,MathAccuracy::Fast,stride);
+            ok=ok&&fast.max_rel<=fast_rel_tol;
+            std::printf("%-6s %12lld %14.7g %12.3e %14.7g\n",fn.name,(long long)precise.max_ulp,precise.worst_x,
+                        fast.max_rel,fast.worst_rel_x);
+        } else {
+            std::printf("%-6s %12lld %14.7g %12s %14s\n",fn.name,(long long)precise.max_ulp,precise.worst_x,"-","-");
+        }
+    }
+
+    std::mt19937 gen(3);
+    std::vector<float> x(size),y(size);
+    std::printf("\n%-6s %12s %12s %8s %12s %8s\n","fn","libm ns","precise ns","x","fast ns","x");
+    for(const Function& fn: functions){
+        std::uniform_real_distribution<float> dist(fn.lo,fn.hi);
+        for(auto &v: x) v=dist(gen);
+        double libm=best_ns(reps,size,[&](){ for(size_t i=0;i<size;++i) y[i]=fn.libm(x[i]); });
+        double precise=best_ns(reps,size,[&](){ fn.vec(x.data(),y.data(),size,MathAccuracy::Precise); });
+        if(fn.has_fast){
+            double fast=best_ns(reps,size,[&](){ fn.vec(x.data(),y.data(),size,MathAccuracy::Fast); });
+            std::printf("%-6s %12.3f %12.3f %8.2f %12.3f %8.2f\n",fn.name,libm,precise,libm/precise,fast,libm/fast);
+        } else {
+            std::printf("%-6s %12.3f %12.3f %8.2f %12s %8s\n",fn.name,libm,precise,libm/precise,"-","-");
+        }
+    }
+
+    if(!ok){
+        std::cerr<<"cnn_vec_math_check: ошибка больше допуска ("<<precise_ulp_tol<<" ULP / "<<fast_rel_tol<<")\n";
+        return 1;
+    }
+    return 0;
+}
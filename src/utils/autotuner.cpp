@@ -0,0 +1,93 @@
+#include "../../include/utils/autotuner.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+std::string Autotuner::path_;
+std::string Autotuner::cpu_;
+std::map<std::string,KernelConfig> Autotuner::cache_;
+std::set<std::string> Autotuner::pending_;
+std::mutex Autotuner::mtx_;
+std::atomic<bool> Autotuner::enabled_([](){
+    const char* env=std::getenv("CNN_AUTOTUNE");
+    return !(env&&std::strcmp(env,"0")==0);
+}());
+thread_local bool Autotuner::measuring_=false;
+
+const std::string& Autotuner::cpu_model() {
+    static const std::string model=[](){
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while(std::getline(cpuinfo,line)){
+            if(line.compare(0,10,"model name")!=0) continue;
+            size_t colon=line.find(':');
+            if(colon==std::string::npos) break;
+            size_t start=line.find_first_not_of(' ',colon+1);
+            return start==std::string::npos?std::string("unknown"):line.substr(start);
+        }
+        return std::string("unknown");
+    }();
+    return model;
+}
+
+void Autotuner::init(const std::string& cache_path) {
+    const std::string& cpu=cpu_model();
+    std::lock_guard<std::mutex> lock(mtx_);
+    path_=cache_path;
+    cpu_=cpu;
+    std::ifstream in(cache_path);
+    std::string line;
+    size_t loaded=0;
+    while(std::getline(in,line)){
+        size_t tab1=line.find('\t');
+        size_t tab2=tab1==std::string::npos?tab1:line.find('\t',tab1+1);
+        if(tab2==std::string::npos||line.compare(0,tab1,cpu_)!=0) continue;
+        std::istringstream values(line.substr(tab2+1));
+        KernelConfig c;
+        if(!(values>>c.loop_order>>c.block>>c.threads)) continue;
+        // Более поздняя строка для того же ключа перекрывает раннюю
+        cache_[line.substr(tab1+1,tab2-tab1-1)]=c;
+        ++loaded;
+    }
+    if(loaded>0) Logger::info("Autotuner: загружено настроек "+std::to_string(loaded)+" для "+cpu_);
+}
+
+bool Autotuner::begin(const std::string& key,KernelConfig& config,bool& settled) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it=cache_.find(key);
+    if(it!=cache_.end()){
+        config=it->second;
+        settled=true;
+        return false;
+    }
+    // Вложенный вызов (замер занимает пул) или чужой замер того же ключа - не ждём,
+    // ожидание внутри задачи ThreadPool может заблокировать владельца замера
+    if(measuring_||pending_.count(key)){
+        settled=false;
+        return false;
+    }
+    pending_.insert(key);
+    return true;
+}
+
+void Autotuner::abandon(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_.erase(key);
+}
+
+void Autotuner::store(const std::string& key,const KernelConfig& config) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_.erase(key);
+    auto it=cache_.find(key);
+    bool known=it!=cache_.end()&&it->second.loop_order==config.loop_order&&
+               it->second.block==config.block&&it->second.threads==config.threads;
+    cache_[key]=config;
+    // Та же строка уже есть в файле (или дописана другим потоком)
+    if(path_.empty()||known) return;
+    std::ofstream out(path_,std::ios::app);
+    if(!out.is_open()){
+        Logger::error("Autotuner: не удалось дописать кэш "+path_);
+        return;
+    }
+    out<<cpu_<<"\t"<<key<<"\t"<<config.loop_order<<" "<<config.block<<" "<<config.threads<<"\n";
+}
@@ -0,0 +1,275 @@
+#include "../../include/utils/distributed.hpp"
+#include "../../include/utils/logger.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Адрес одного процесса кольца
+struct Endpoint {
+    bool unix_socket=false;
+    std::string host;  // или путь Unix-сокета
+    int port=0;
+};
+
+std::runtime_error sys_error(const std::string& what){
+    return std::runtime_error("RingCommunicator: "+what+": "+std::strerror(errno));
+}
+
+Endpoint endpoint_for(const std::string& address,size_t rank,size_t world_size){
+    Endpoint e;
+    if(address.compare(0,5,"unix:")==0){
+        e.unix_socket=true;
+        e.host=address.substr(5)+"."+std::to_string(rank);
+        return e;
+    }
+    std::vector<std::string> parts;
+    size_t start=0;
+    while(true){
+        size_t comma=address.find(',',start);
+        parts.push_back(address.substr(start,comma==std::string::npos?std::string::npos:comma-start));
+        if(comma==std::string::npos) break;
+        start=comma+1;
+    }
+    if(parts.size()!=1&&parts.size()!=world_size)
+        throw std::runtime_error("RingCommunicator: адресов "+std::to_string(parts.size())+", процессов "+std::to_string(world_size));
+    const std::string& part=parts.size()==1?parts[0]:parts[rank];
+    size_t colon=part.rfind(':');
+    if(colon==std::string::npos) throw std::runtime_error("RingCommunicator: ожидается host:port, получено "+part);
+    e.host=part.substr(0,colon);
+    e.port=std::atoi(part.c_str()+colon+1)+(parts.size()==1?(int)rank:0);
+    return e;
+}
+
+int listen_on(const Endpoint& e){
+    int fd;
+    if(e.unix_socket){
+        fd=::socket(AF_UNIX,SOCK_STREAM,0);
+        if(fd<0) throw sys_error("socket");
+        sockaddr_un addr{};
+        addr.sun_family=AF_UNIX;
+        if(e.host.size()>=sizeof(addr.sun_path)) throw std::runtime_error("RingCommunicator: слишком длинный путь "+e.host);
+        std::strcpy(addr.sun_path,e.host.c_str());
+        ::unlink(e.host.c_str());
+        if(::bind(fd,(sockaddr*)&addr,sizeof(addr))<0){
+            ::close(fd);
+            throw sys_error("bind "+e.host);
+        }
+    } else {
+        fd=::socket(AF_INET,SOCK_STREAM,0);
+        if(fd<0) throw sys_error("socket");
+        int one=1;
+        ::setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family=AF_INET;
+        addr.sin_addr.s_addr=htonl(INADDR_ANY);
+        addr.sin_port=htons((uint16_t)e.port);
+        if(::bind(fd,(sockaddr*)&addr,sizeof(addr))<0){
+            ::close(fd);
+            throw sys_error("bind порт "+std::to_string(e.port));
+        }
+    }
+    if(::listen(fd,4)<0){
+        ::close(fd);
+        throw sys_error("listen");
+    }
+    return fd;
+}
+
+int try_connect(const Endpoint& e){
+    if(e.unix_socket){
+        int fd=::socket(AF_UNIX,SOCK_STREAM,0);
+        if(fd<0) throw sys_error("socket");
+        sockaddr_un addr{};
+        addr.sun_family=AF_UNIX;
+        std::strcpy(addr.sun_path,e.host.c_str());
+        if(::connect(fd,(sockaddr*)&addr,sizeof(addr))==0) return fd;
+        ::close(fd);
+        return -1;
+    }
+    addrinfo hints{};
+    hints.ai_family=AF_INET;
+    hints.ai_socktype=SOCK_STREAM;
+    addrinfo* result=nullptr;
+    if(::getaddrinfo(e.host.c_str(),std::to_string(e.port).c_str(),&hints,&result)!=0||!result)
+        throw std::runtime_error("RingCommunicator: не удалось разрешить "+e.host);
+    int fd=::socket(result->ai_family,result->ai_socktype,result->ai_protocol);
+    if(fd<0){
+        ::freeaddrinfo(result);
+        throw sys_error("socket");
+    }
+    int rc=::connect(fd,result->ai_addr,result->ai_addrlen);
+    ::freeaddrinfo(result);
+    if(rc==0){
+        int one=1;
+        ::setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+        return fd;
+    }
+    ::close(fd);
+    return -1;
+}
+
+void set_buffers(int fd){
+    int size=4<<20;
+    ::setsockopt(fd,SOL_SOCKET,SO_SNDBUF,&size,sizeof(size));
+    ::setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&size,sizeof(size));
+}
+
+} // namespace
+
+DistributedConfig DistributedConfig::from_env() {
+    DistributedConfig config;
+    if(const char* rank=std::getenv("CNN_RANK")) config.rank=std::strtoul(rank,nullptr,10);
+    if(const char* world=std::getenv("CNN_WORLD_SIZE")) config.world_size=std::max<size_t>(1,std::strtoul(world,nullptr,10));
+    if(const char* addr=std::getenv("CNN_MASTER_ADDR")) config.address=addr;
+    if(config.rank>=config.world_size) throw std::runtime_error("DistributedConfig: CNN_RANK должен быть меньше CNN_WORLD_SIZE");
+    return config;
+}
+
+RingCommunicator::RingCommunicator(const DistributedConfig& config)
+    : rank_(config.rank), world_size_(config.world_size) {
+    if(rank_>=world_size_) throw std::runtime_error("RingCommunicator: rank вне диапазона");
+    if(world_size_==1) return;
+
+    // Сначала слушаем: connect соседа проходит по backlog ещё до нашего accept
+    Endpoint self=endpoint_for(config.address,rank_,world_size_);
+    Endpoint next=endpoint_for(config.address,(rank_+1)%world_size_,world_size_);
+    int listen_fd=listen_on(self);
+    try{
+        auto deadline=std::chrono::steady_clock::now()+std::chrono::duration<double>(config.connect_timeout_s);
+        while((next_fd_=try_connect(next))<0){
+            if(std::chrono::steady_clock::now()>deadline)
+                throw std::runtime_error("RingCommunicator: нет соединения с процессом "+std::to_string((rank_+1)%world_size_));
+            ::usleep(50000);
+        }
+        set_buffers(next_fd_);
+        uint32_t my_rank=(uint32_t)rank_;
+        send_all(&my_rank,sizeof(my_rank));
+
+        prev_fd_=::accept(listen_fd,nullptr,nullptr);
+        if(prev_fd_<0) throw sys_error("accept");
+        set_buffers(prev_fd_);
+        if(!self.unix_socket){
+            int one=1;
+            ::setsockopt(prev_fd_,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+        }
+        uint32_t prev_rank=0;
+        recv_all(&prev_rank,sizeof(prev_rank));
+        if(prev_rank!=(rank_+world_size_-1)%world_size_)
+            throw std::runtime_error("RingCommunicator: подключился процесс "+std::to_string(prev_rank)+" вместо предыдущего");
+    }catch(...){
+        ::close(listen_fd);
+        if(self.unix_socket) ::unlink(self.host.c_str());
+        if(next_fd_>=0) ::close(next_fd_);
+        if(prev_fd_>=0) ::close(prev_fd_);
+        throw;
+    }
+    ::close(listen_fd);
+    if(self.unix_socket) ::unlink(self.host.c_str());
+    barrier();
+    Logger::info("RingCommunicator: процесс "+std::to_string(rank_)+" из "+std::to_string(world_size_)+" в кольце");
+}
+
+RingCommunicator::~RingCommunicator() {
+    if(next_fd_>=0) ::close(next_fd_);
+    if(prev_fd_>=0) ::close(prev_fd_);
+}
+
+void RingCommunicator::send_all(const void* data,size_t bytes) {
+    const char* p=(const char*)data;
+    while(bytes>0){
+        ssize_t n=::send(next_fd_,p,bytes,MSG_NOSIGNAL);
+        if(n<0){
+            if(errno==EINTR) continue;
+            throw sys_error("send");
+        }
+        p+=n;
+        bytes-=(size_t)n;
+    }
+}
+
+void RingCommunicator::recv_all(void* data,size_t bytes) {
+    char* p=(char*)data;
+    while(bytes>0){
+        ssize_t n=::recv(prev_fd_,p,bytes,0);
+        if(n==0) throw std::runtime_error("RingCommunicator: предыдущий процесс закрыл соединение");
+        if(n<0){
+            if(errno==EINTR) continue;
+            throw sys_error("recv");
+        }
+        p+=n;
+        bytes-=(size_t)n;
+    }
+}
+
+void RingCommunicator::exchange(const void* send,size_t send_bytes,void* recv,size_t recv_bytes) {
+    const char* out=(const char*)send;
+    char* in=(char*)recv;
+    while(send_bytes>0||recv_bytes>0){
+        pollfd fds[2];
+        nfds_t count=0;
+        int send_idx=-1,recv_idx=-1;
+        if(send_bytes>0){
+            fds[count]={next_fd_,POLLOUT,0};
+            send_idx=(int)count++;
+        }
+        if(recv_bytes>0){
+            fds[count]={prev_fd_,POLLIN,0};
+            recv_idx=(int)count++;
+        }
+        if(::poll(fds,count,-1)<0){
+            if(errno==EINTR) continue;
+            throw sys_error("poll");
+        }
+        if(send_idx>=0&&fds[send_idx].revents){
+            ssize_t n=::send(next_fd_,out,send_bytes,MSG_NOSIGNAL|MSG_DONTWAIT);
+            if(n<0&&errno!=EAGAIN&&errno!=EWOULDBLOCK&&errno!=EINTR) throw sys_error("send");
+            if(n>0){
+                out+=n;
+                send_bytes-=(size_t)n;
+            }
+        }
+        if(recv_idx>=0&&fds[recv_idx].revents){
+            ssize_t n=::recv(prev_fd_,in,recv_bytes,MSG_DONTWAIT);
+            if(n==0) throw std::runtime_error("RingCommunicator: предыдущий процесс закрыл соединение");
+            if(n<0&&errno!=EAGAIN&&errno!=EWOULDBLOCK&&errno!=EINTR) throw sys_error("recv");
+            if(n>0){
+                in+=n;
+                recv_bytes-=(size_t)n;
+            }
+        }
+    }
+}
+
+void RingCommunicator::broadcast(void* data,size_t bytes,size_t root) {
+    if(world_size_==1||bytes==0) return;
+    if(root>=world_size_) throw std::runtime_error("RingCommunicator: root вне диапазона");
+    size_t next=(rank_+1)%world_size_;
+    if(rank_!=root) recv_all(data,bytes);
+    if(next!=root) send_all(data,bytes);
+}
+
+void RingCommunicator::barrier() {
+    // Маркер проходит кольцо дважды: после первого круга все дошли до барьера, второй сообщает об этом
+    uint8_t token=0;
+    for(int round=0;round<2;++round){
+        if(rank_==0){
+            send_all(&token,1);
+            recv_all(&token,1);
+        } else {
+            recv_all(&token,1);
+            send_all(&token,1);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#include "../../include/utils/memory_tracker.hpp"
+#include <iostream>
+
+std::ofstream MemoryTracker::file_;
+std::mutex MemoryTracker::mtx_;
+std::map<std::string,MemoryTracker::Entry*> MemoryTracker::entries_;
+std::atomic<long long> MemoryTracker::total_live_(0);
+std::atomic<long long> MemoryTracker::total_peak_(0);
+thread_local MemoryTracker::Entry* MemoryTracker::current_=nullptr;
+
+void MemoryTracker::init(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    file_.open(filename, std::ios::out);
+    if(!file_.is_open()){
+        std::cerr<<"Не удалось открыть файл учёта памяти: "<<filename<<"\n";
+    } else {
+        file_<<"Epoch,Layer,Phase,Live_Bytes,Peak_Bytes,Allocations\n";
+    }
+}
+
+void MemoryTracker::close() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(file_.is_open()) file_.close();
+}
+
+const char* MemoryTracker::phase_name(MemoryPhase phase) {
+    switch(phase){
+        case MemoryPhase::Forward: return "forward";
+        case MemoryPhase::Backward: return "backward";
+        case MemoryPhase::Recompute: return "recompute";
+        case MemoryPhase::Eval: return "eval";
+        default: return "other";
+    }
+}
+
+MemoryTracker::Entry* MemoryTracker::entry(const std::string& layer,MemoryPhase phase) {
+    std::string key=layer+"/"+phase_name(phase);
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it=entries_.find(key);
+    if(it!=entries_.end()) return it->second;
+    Entry* e=new Entry();
+    e->layer=layer;
+    e->phase=phase;
+    entries_[key]=e;
+    return e;
+}
+
+MemoryTracker::Entry* MemoryTracker::unscoped() {
+    static Entry* e=entry("unscoped",MemoryPhase::Other);
+    return e;
+}
+
+void MemoryTracker::log_epoch(size_t epoch) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(!file_.is_open()) return;
+    for(auto &kv: entries_){
+        Entry& e=*kv.second;
+        size_t allocations=e.allocations.exchange(0);
+        long long live=e.live_bytes.load();
+        long long peak=e.peak_bytes.exchange(live);
+        if(allocations==0&&live==0&&peak==0) continue;
+        file_<<epoch<<","<<e.layer<<","<<phase_name(e.phase)<<","<<live<<","<<peak<<","<<allocations<<"\n";
+    }
+    long long live=total_live_.load();
+    file_<<epoch<<",total,all,"<<live<<","<<total_peak_.exchange(live)<<",\n";
+    file_.flush();
+}
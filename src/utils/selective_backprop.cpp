@@ -0,0 +1,58 @@
+#include "../../include/utils/selective_backprop.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+SelectiveBackpropSampler::SelectiveBackpropSampler(const SelectiveBackpropConfig& config)
+    : config_(config) {
+    if(config_.history==0) throw std::runtime_error("SelectiveBackprop: пустая история лоссов");
+    if(config_.beta<0) throw std::runtime_error("SelectiveBackprop: beta должна быть неотрицательной");
+    config_.min_probability=std::min(1.0,std::max(config_.min_probability,1e-6));
+    history_.reserve(config_.history);
+}
+
+std::vector<double> SelectiveBackpropSampler::probabilities(const std::vector<double>& losses) {
+    std::vector<double> probs(losses.size(),1.0);
+    // История сортируется один раз на батч, перцентиль - двоичным поиском
+    sorted_=history_;
+    std::sort(sorted_.begin(),sorted_.end());
+    if(!sorted_.empty()){
+        for(size_t i=0;i<losses.size();++i){
+            double rank=(double)(std::upper_bound(sorted_.begin(),sorted_.end(),losses[i])-sorted_.begin());
+            double p=std::pow(rank/(double)sorted_.size(),config_.beta);
+            probs[i]=std::max(config_.min_probability,p);
+        }
+    }
+    for(double loss: losses){
+        if(history_.size()<config_.history){
+            history_.push_back(loss);
+        } else {
+            history_[next_]=loss;
+            next_=(next_+1)%config_.history;
+        }
+    }
+    return probs;
+}
+
+void SelectiveBackpropSampler::restore_history(const std::vector<double>& history,size_t next) {
+    if(history.size()>config_.history||(next>0&&next>=history.size()))
+        throw std::runtime_error("SelectiveBackprop: история из снимка не совпадает с config.history");
+    history_=history;
+    next_=next;
+}
+
+void SelectiveBackpropSampler::select(const std::vector<double>& losses,std::mt19937& rng,
+                                      std::vector<size_t>& chosen,std::vector<double>& chosen_prob) {
+    std::vector<double> probs=probabilities(losses);
+    std::uniform_real_distribution<double> coin(0.0,1.0);
+    chosen.clear();
+    chosen_prob.clear();
+    for(size_t i=0;i<probs.size();++i){
+        if(coin(rng)<probs[i]){
+            chosen.push_back(i);
+            chosen_prob.push_back(probs[i]);
+        }
+    }
+    seen_+=losses.size();
+    selected_+=chosen.size();
+}
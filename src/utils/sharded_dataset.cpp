@@ -0,0 +1,273 @@
+#include "../../include/utils/sharded_dataset.hpp"
+#include "../../include/utils/dataset.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char index_magic[8]={'C','N','N','I','D','X','0','1'};
+const char shard_magic[8]={'C','N','N','S','H','D','0','1'};
+const size_t shard_header_size=16;
+
+std::runtime_error sys_error(const std::string& what){
+    return std::runtime_error("ShardedDataset: "+what+": "+std::strerror(errno));
+}
+
+std::string shard_path(const std::string& dir,size_t index){
+    char name[32];
+    std::snprintf(name,sizeof(name),"shard-%05zu.bin",index);
+    return dir+"/"+name;
+}
+
+void put_u32(std::ostream& out,uint32_t v){
+    unsigned char b[4];
+    for(int i=0;i<4;++i) b[i]=(unsigned char)(v>>(8*i));
+    out.write((const char*)b,4);
+}
+
+void put_u64(std::ostream& out,uint64_t v){
+    unsigned char b[8];
+    for(int i=0;i<8;++i) b[i]=(unsigned char)(v>>(8*i));
+    out.write((const char*)b,8);
+}
+
+uint64_t get_le(const unsigned char* b,int bytes){
+    uint64_t v=0;
+    for(int i=0;i<bytes;++i) v|=(uint64_t)b[i]<<(8*i);
+    return v;
+}
+
+uint64_t read_le(std::istream& in,int bytes,const std::string& path){
+    unsigned char b[8];
+    if(!in.read((char*)b,bytes)) throw std::runtime_error("ShardedDataset: обрезан файл "+path);
+    return get_le(b,bytes);
+}
+
+// read(2) до конца буфера (повтор после EINTR и коротких чтений)
+void read_all(int fd,unsigned char* dst,size_t bytes,const std::string& path){
+    while(bytes>0){
+        ssize_t n=::read(fd,dst,bytes);
+        if(n<0){
+            if(errno==EINTR) continue;
+            throw sys_error("чтение "+path);
+        }
+        if(n==0) throw std::runtime_error("ShardedDataset: обрезан шард "+path);
+        dst+=n;
+        bytes-=(size_t)n;
+    }
+}
+
+} // namespace
+
+ShardedDatasetWriter::ShardedDatasetWriter(const std::string& dir,size_t rows,size_t cols,size_t num_classes,
+                                           size_t records_per_shard)
+    : dir_(dir), rows_(rows), cols_(cols), num_classes_(num_classes), records_per_shard_(records_per_shard) {
+    if(rows==0||cols==0||num_classes==0||num_classes>256||records_per_shard==0)
+        throw std::runtime_error("ShardedDatasetWriter: неверные размеры набора");
+    if(::mkdir(dir.c_str(),0755)!=0&&errno!=EEXIST) throw sys_error("не удалось создать каталог "+dir);
+}
+
+ShardedDatasetWriter::~ShardedDatasetWriter(){
+    // Индекс пишет только close(): недописанный набор не должен читаться как целый
+    if(shard_.is_open()) shard_.close();
+}
+
+void ShardedDatasetWriter::add(const unsigned char* pixels,int label){
+    if(closed_) throw std::runtime_error("ShardedDatasetWriter: запись после close()");
+    if(label<0||(size_t)label>=num_classes_)
+        throw std::runtime_error("ShardedDatasetWriter: метка "+std::to_string(label)+" вне числа классов");
+    if(!shard_.is_open()){
+        std::string path=shard_path(dir_,counts_.size());
+        shard_.open(path,std::ios::binary|std::ios::trunc);
+        if(!shard_.is_open()) throw std::runtime_error("ShardedDatasetWriter: не удалось создать "+path);
+        shard_.write(shard_magic,8);
+        put_u64(shard_,0);
+        counts_.push_back(0);
+    }
+    unsigned char lbl=(unsigned char)label;
+    shard_.write((const char*)pixels,(std::streamsize)(rows_*cols_));
+    shard_.write((const char*)&lbl,1);
+    if(!shard_) throw std::runtime_error("ShardedDatasetWriter: ошибка записи шарда "+std::to_string(counts_.size()-1));
+    if(++counts_.back()==records_per_shard_) finish_shard();
+}
+
+void ShardedDatasetWriter::finish_shard(){
+    // Число записей известно только в конце шарда
+    shard_.seekp(8);
+    put_u64(shard_,counts_.back());
+    shard_.close();
+    if(shard_.fail()) throw std::runtime_error("ShardedDatasetWriter: ошибка записи шарда "+std::to_string(counts_.size()-1));
+}
+
+void ShardedDatasetWriter::close(){
+    if(closed_) return;
+    if(shard_.is_open()) finish_shard();
+    std::string path=dir_+"/index.bin";
+    std::ofstream index(path,std::ios::binary|std::ios::trunc);
+    if(!index.is_open()) throw std::runtime_error("ShardedDatasetWriter: не удалось создать "+path);
+    index.write(index_magic,8);
+    put_u32(index,(uint32_t)rows_);
+    put_u32(index,(uint32_t)cols_);
+    put_u32(index,(uint32_t)num_classes_);
+    put_u32(index,(uint32_t)counts_.size());
+    for(size_t c: counts_) put_u64(index,c);
+    index.close();
+    if(index.fail()) throw std::runtime_error("ShardedDatasetWriter: ошибка записи "+path);
+    closed_=true;
+}
+
+size_t write_shards_from_idx(const std::string& images_path,const std::string& labels_path,
+                             const std::string& dir,size_t num_classes,size_t records_per_shard){
+    IdxImageStream images(images_path);
+    std::ifstream labels(labels_path,std::ios::binary);
+    if(!labels.is_open()) throw std::runtime_error("Не удалось открыть файл меток: "+labels_path);
+    int32_t magic=0,count=0;
+    if(!read_idx_int(labels,magic)||magic!=2049) throw std::runtime_error("Неверный магический номер для меток: "+labels_path);
+    if(!read_idx_int(labels,count)||(size_t)count!=images.num_images())
+        throw std::runtime_error("Количество изображений и меток не совпадает");
+
+    ShardedDatasetWriter writer(dir,images.rows(),images.cols(),num_classes,records_per_shard);
+    std::vector<unsigned char> pixels,lbl;
+    size_t total=0;
+    while(size_t n=images.read(1024,pixels)){
+        lbl.resize(n);
+        if(!labels.read((char*)lbl.data(),(std::streamsize)n)) throw std::runtime_error("Файл меток обрезан: "+labels_path);
+        for(size_t i=0;i<n;++i) writer.add(pixels.data()+i*images.image_size(),lbl[i]);
+        total+=n;
+    }
+    writer.close();
+    return total;
+}
+
+ShardedDataset::ShardedDataset(const std::string& dir) : dir_(dir) {
+    std::string path=dir+"/index.bin";
+    std::ifstream index(path,std::ios::binary);
+    if(!index.is_open()) throw std::runtime_error("ShardedDataset: не удалось открыть "+path);
+    char magic[8];
+    if(!index.read(magic,8)||std::memcmp(magic,index_magic,8)!=0)
+        throw std::runtime_error("ShardedDataset: "+path+" - не индекс шардов");
+    rows_=(size_t)read_le(index,4,path);
+    cols_=(size_t)read_le(index,4,path);
+    num_classes_=(size_t)read_le(index,4,path);
+    size_t num_shards=(size_t)read_le(index,4,path);
+    if(rows_==0||cols_==0||num_classes_==0) throw std::runtime_error("ShardedDataset: повреждён индекс "+path);
+    for(size_t i=0;i<num_shards;++i){
+        size_t count=(size_t)read_le(index,8,path);
+        shards_.push_back({shard_path(dir,i),count});
+        num_records_+=count;
+    }
+}
+
+ShardStream::ShardStream(const ShardedDataset& dataset,unsigned seed,size_t shuffle_buffer,
+                         size_t read_ahead_bytes,size_t max_chunks)
+    : dataset_(dataset), record_size_(dataset.record_size()),
+      chunk_records_(std::max<size_t>(1,read_ahead_bytes/dataset.record_size())),
+      rng_(seed), queue_(max_chunks), buffer_capacity_(std::max<size_t>(1,shuffle_buffer)) {
+    order_.resize(dataset.shards().size());
+    for(size_t i=0;i<order_.size();++i) order_[i]=i;
+    std::shuffle(order_.begin(),order_.end(),rng_);
+    buffer_.resize(buffer_capacity_*record_size_);
+    reader_=std::thread([this](){ read_shards(); });
+}
+
+ShardStream::~ShardStream(){
+    queue_.close();
+    reader_.join();
+}
+
+void ShardStream::read_shards(){
+    const std::vector<ShardInfo>& shards=dataset_.shards();
+    int fd=-1,next_fd=-1;
+    auto open_shard=[&](size_t k){
+        const std::string& path=shards[order_[k]].path;
+        int f=::open(path.c_str(),O_RDONLY);
+        if(f<0) throw sys_error("не удалось открыть "+path);
+        return f;
+    };
+    try{
+        for(size_t k=0;k<order_.size();++k){
+            const ShardInfo& shard=shards[order_[k]];
+            fd=next_fd>=0?next_fd:open_shard(k);
+            next_fd=-1;
+            posix_fadvise(fd,0,0,POSIX_FADV_SEQUENTIAL);
+            // Начало следующего шарда подгружается, пока читается текущий
+            if(k+1<order_.size()){
+                next_fd=open_shard(k+1);
+                posix_fadvise(next_fd,0,(off_t)(shard_header_size+chunk_records_*record_size_),POSIX_FADV_WILLNEED);
+            }
+
+            unsigned char header[shard_header_size];
+            read_all(fd,header,shard_header_size,shard.path);
+            if(std::memcmp(header,shard_magic,8)!=0||get_le(header+8,8)!=shard.count)
+                throw std::runtime_error("ShardedDataset: шард "+shard.path+" не совпадает с индексом");
+
+            off_t offset=(off_t)shard_header_size;
+            size_t remaining=shard.count;
+            while(remaining>0){
+                Chunk chunk;
+                chunk.count=std::min(chunk_records_,remaining);
+                chunk.records.resize(chunk.count*record_size_);
+                read_all(fd,chunk.records.data(),chunk.records.size(),shard.path);
+                // Прочитанное больше не нужно: не держим его в страничном кэше
+                posix_fadvise(fd,offset,(off_t)chunk.records.size(),POSIX_FADV_DONTNEED);
+                offset+=(off_t)chunk.records.size();
+                remaining-=chunk.count;
+                if(!queue_.push(std::move(chunk))){
+                    ::close(fd);
+                    if(next_fd>=0) ::close(next_fd);
+                    return;
+                }
+            }
+            ::close(fd);
+            fd=-1;
+        }
+    }catch(...){
+        if(fd>=0) ::close(fd);
+        if(next_fd>=0) ::close(next_fd);
+        std::lock_guard<std::mutex> lock(error_mtx_);
+        error_=std::current_exception();
+    }
+    queue_.close();
+}
+
+bool ShardStream::pull(unsigned char* dst){
+    while(chunk_pos_>=chunk_.count){
+        if(exhausted_) return false;
+        if(!queue_.pop(chunk_)){
+            exhausted_=true;
+            std::lock_guard<std::mutex> lock(error_mtx_);
+            if(error_) std::rethrow_exception(error_);
+            return false;
+        }
+        chunk_pos_=0;
+    }
+    std::memcpy(dst,chunk_.records.data()+chunk_pos_*record_size_,record_size_);
+    ++chunk_pos_;
+    return true;
+}
+
+size_t ShardStream::next(size_t max_records,std::vector<unsigned char>& out){
+    out.resize(max_records*record_size_);
+    // Первое заполнение буфера перемешивания
+    while(buffered_<buffer_capacity_&&!exhausted_&&pull(buffer_.data()+buffered_*record_size_)) ++buffered_;
+    size_t n=0;
+    for(;n<max_records&&buffered_>0;++n){
+        size_t j=std::uniform_int_distribution<size_t>(0,buffered_-1)(rng_);
+        unsigned char* slot=buffer_.data()+j*record_size_;
+        std::memcpy(out.data()+n*record_size_,slot,record_size_);
+        if(!pull(slot)){
+            // Поток кончился: буфер сжимается, последняя запись занимает место выданной
+            --buffered_;
+            if(j!=buffered_) std::memcpy(slot,buffer_.data()+buffered_*record_size_,record_size_);
+        }
+    }
+    out.resize(n*record_size_);
+    emitted_+=n;
+    return n;
+}
@@ -0,0 +1,94 @@
+#include "../../include/utils/thread_pool.hpp"
+#include <cstdlib>
+
+namespace {
+// Индекс воркера текущего потока, для внешних потоков - size_t(-1)
+thread_local size_t current_worker=(size_t)-1;
+}
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : stop_(false), pending_(0), next_queue_(0) {
+    size_t workers=num_threads>1?num_threads-1:0;
+    for(size_t i=0;i<std::max<size_t>(workers,1);++i){
+        queues_.emplace_back(new WorkerQueue());
+    }
+    for(size_t i=0;i<workers;++i){
+        threads_.emplace_back(&ThreadPool::worker_loop,this,i);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(wake_mtx_);
+        stop_=true;
+    }
+    wake_cv_.notify_all();
+    for(auto &t: threads_) t.join();
+}
+
+ThreadPool& ThreadPool::instance(){
+    static ThreadPool pool([](){
+        const char* env=std::getenv("CNN_NUM_THREADS");
+        if(env&&std::atoi(env)>0) return (size_t)std::atoi(env);
+        size_t hw=std::thread::hardware_concurrency();
+        return hw>0?hw:(size_t)1;
+    }());
+    return pool;
+}
+
+void ThreadPool::submit(std::function<void()> task){
+    size_t q=current_worker<queues_.size()?current_worker:next_queue_.fetch_add(1)%queues_.size();
+    // Счётчик растёт до того, как задача станет видна: иначе воркер может забрать её
+    // и уменьшить pending_ раньше, чем он увеличен, и size_t уйдёт через ноль
+    {
+        std::lock_guard<std::mutex> lock(wake_mtx_);
+        pending_.fetch_add(1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[q]->mtx);
+        queues_[q]->tasks.push_back(std::move(task));
+    }
+    wake_cv_.notify_one();
+}
+
+bool ThreadPool::try_pop(size_t preferred,std::function<void()>& task){
+    size_t count=queues_.size();
+    if(preferred<count){
+        WorkerQueue& own=*queues_[preferred];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if(!own.tasks.empty()){
+            task=std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    size_t start=preferred<count?preferred+1:0;
+    for(size_t k=0;k<count;++k){
+        WorkerQueue& victim=*queues_[(start+k)%count];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if(!victim.tasks.empty()){
+            task=std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::run_pending_task(){
+    std::function<void()> task;
+    if(!try_pop(current_worker,task)) return false;
+    pending_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop(size_t index){
+    current_worker=index;
+    while(true){
+        if(run_pending_task()) continue;
+        std::unique_lock<std::mutex> lock(wake_mtx_);
+        wake_cv_.wait(lock,[this](){ return stop_||pending_.load()>0; });
+        if(stop_&&pending_.load()==0) return;
+    }
+}
@@ -0,0 +1,308 @@
+#include "../../include/utils/vec_math.hpp"
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VEC_MATH_X86 1
+#define VEC_MATH_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+/**
+ * exp: x = n*ln2 + r, |r| <= ln2/2 (ln2 разбит на hi+lo, n*hi точно), e^r - полином,
+ * 2^n собирается из битов экспоненты в два множителя, чтобы дойти до субнормальных.
+ * expm1: 2^n*expm1(r) + (2^n-1), без потери точности около нуля.
+ * log: x = m*2^e, m в [sqrt(1/2), sqrt(2)), log(m) - полином по f=m-1.
+ * Коэффициенты Precise - из Cephes (expf/logf), Fast - ряд Тейлора меньшей степени.
+ * У log вариант один: укороченный полином требует деления и на AVX2 не быстрее точного.
+ */
+
+namespace {
+
+const float log2e=1.44269504088896341f;
+const float ln2_hi=0.693359375f;
+const float ln2_lo=-2.12194440e-4f;
+const float exp_hi=88.7228393f;    // выше - переполнение
+const float exp_lo=-103.972076f;   // ниже - ноль
+const float expm1_lo=-17.3286795f; // ниже expm1 округляется до -1
+const float expm1_big=20.0f;       // выше expm1(x) == exp(x) в float
+const float sqrt_half=0.707106781186547524f;
+
+inline float from_bits(uint32_t b){
+    float f;
+    std::memcpy(&f,&b,4);
+    return f;
+}
+
+inline uint32_t to_bits(float f){
+    uint32_t b;
+    std::memcpy(&b,&f,4);
+    return b;
+}
+
+// p*2^n для n в [-150,128]
+inline float scale_pow2(float p,int n){
+    int e1=n>>1;
+    int e2=n-e1;
+    return p*from_bits((uint32_t)(e1+127)<<23)*from_bits((uint32_t)(e2+127)<<23);
+}
+
+inline float exp_poly(float r,bool fast){
+    if(fast) return 1.0f+r*(1.0f+r*(0.5f+r*(1.6666667e-1f+r*4.1666668e-2f)));
+    float p=1.9875691500E-4f;
+    p=p*r+1.3981999507E-3f;
+    p=p*r+8.3334519073E-3f;
+    p=p*r+4.1665795894E-2f;
+    p=p*r+1.6666665459E-1f;
+    p=p*r+5.0000001201E-1f;
+    return p*r*r+r+1.0f;
+}
+
+inline float expm1_poly(float r,bool fast){
+    if(fast) return r+r*r*(0.5f+r*(1.6666667e-1f+r*4.1666668e-2f));
+    float p=1.9841270e-4f;
+    p=p*r+1.3888889e-3f;
+    p=p*r+8.3333338e-3f;
+    p=p*r+4.1666668e-2f;
+    p=p*r+1.6666667e-1f;
+    p=p*r+0.5f;
+    return p*r*r+r;
+}
+
+inline float log_poly(float f,float e){
+    float z=f*f;
+    float y=7.0376836292E-2f;
+    y=y*f-1.1514610310E-1f;
+    y=y*f+1.1676998740E-1f;
+    y=y*f-1.2420140846E-1f;
+    y=y*f+1.4249322787E-1f;
+    y=y*f-1.6668057665E-1f;
+    y=y*f+2.0000714765E-1f;
+    y=y*f-2.4999993993E-1f;
+    y=y*f+3.3333331174E-1f;
+    y=y*f*z;
+    y+=e*ln2_lo;
+    y-=0.5f*z;
+    return f+y+e*ln2_hi;
+}
+
+float exp_scalar(float x,bool fast){
+    if(x!=x) return x;
+    if(x>exp_hi) return std::numeric_limits<float>::infinity();
+    if(x<exp_lo) return 0.0f;
+    float n=std::nearbyint(x*log2e);
+    float r=x-n*ln2_hi;
+    r=r-n*ln2_lo;
+    return scale_pow2(exp_poly(r,fast),(int)n);
+}
+
+float expm1_scalar(float x,bool fast){
+    if(x!=x) return x;
+    if(x>expm1_big) return exp_scalar(x,fast)-1.0f;
+    if(x<expm1_lo) return -1.0f;
+    float n=std::nearbyint(x*log2e);
+    float r=x-n*ln2_hi;
+    r=r-n*ln2_lo;
+    float s=from_bits((uint32_t)((int)n+127)<<23);
+    return s*expm1_poly(r,fast)+(s-1.0f);
+}
+
+float log_scalar(float x){
+    if(x!=x||x<0) return std::numeric_limits<float>::quiet_NaN();
+    if(x==0) return -std::numeric_limits<float>::infinity();
+    if(x==std::numeric_limits<float>::infinity()) return x;
+    int adjust=0;
+    if(x<FLT_MIN){
+        x*=8388608.0f; // 2^23
+        adjust=-23;
+    }
+    uint32_t b=to_bits(x);
+    int e=(int)((b>>23)&0xff)-126+adjust;
+    float m=from_bits((b&0x007fffffu)|0x3f000000u); // [0.5, 1)
+    float f;
+    if(m<sqrt_half){
+        e-=1;
+        f=m+m-1.0f;
+    } else {
+        f=m-1.0f;
+    }
+    return log_poly(f,(float)e);
+}
+
+void exp_array_scalar(const float* x,float* y,size_t n,bool fast){
+    for(size_t i=0;i<n;++i) y[i]=exp_scalar(x[i],fast);
+}
+
+void expm1_array_scalar(const float* x,float* y,size_t n,bool fast){
+    for(size_t i=0;i<n;++i) y[i]=expm1_scalar(x[i],fast);
+}
+
+void log_array_scalar(const float* x,float* y,size_t n,bool){
+    for(size_t i=0;i<n;++i) y[i]=log_scalar(x[i]);
+}
+
+#ifdef VEC_MATH_X86
+
+VEC_MATH_AVX2 inline __m256 exp_poly8(__m256 r,bool fast){
+    if(fast){
+        __m256 p=_mm256_fmadd_ps(r,_mm256_set1_ps(4.1666668e-2f),_mm256_set1_ps(1.6666667e-1f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(0.5f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f));
+        return _mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f));
+    }
+    __m256 p=_mm256_set1_ps(1.9875691500E-4f);
+    p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.3981999507E-3f));
+    p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(8.3334519073E-3f));
+    p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(4.1665795894E-2f));
+    p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.6666665459E-1f));
+    p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(5.0000001201E-1f));
+    return _mm256_add_ps(_mm256_fmadd_ps(p,_mm256_mul_ps(r,r),r),_mm256_set1_ps(1.0f));
+}
+
+VEC_MATH_AVX2 inline __m256 expm1_poly8(__m256 r,bool fast){
+    __m256 p;
+    if(fast){
+        p=_mm256_fmadd_ps(r,_mm256_set1_ps(4.1666668e-2f),_mm256_set1_ps(1.6666667e-1f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(0.5f));
+    } else {
+        p=_mm256_set1_ps(1.9841270e-4f);
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.3888889e-3f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(8.3333338e-3f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(4.1666668e-2f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.6666667e-1f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(0.5f));
+    }
+    return _mm256_fmadd_ps(p,_mm256_mul_ps(r,r),r);
+}
+
+// 2^n для целых n в [-126,127]
+VEC_MATH_AVX2 inline __m256 pow2_8(__m256i n){
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n,_mm256_set1_epi32(127)),23));
+}
+
+VEC_MATH_AVX2 inline __m256 exp8(__m256 x,bool fast){
+    __m256 xc=_mm256_min_ps(_mm256_max_ps(x,_mm256_set1_ps(exp_lo)),_mm256_set1_ps(exp_hi));
+    __m256 n=_mm256_round_ps(_mm256_mul_ps(xc,_mm256_set1_ps(log2e)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+    __m256 r=_mm256_fnmadd_ps(n,_mm256_set1_ps(ln2_hi),xc);
+    r=_mm256_fnmadd_ps(n,_mm256_set1_ps(ln2_lo),r);
+    __m256 p=exp_poly8(r,fast);
+    __m256i ni=_mm256_cvtps_epi32(n);
+    __m256i e1=_mm256_srai_epi32(ni,1);
+    __m256i e2=_mm256_sub_epi32(ni,e1);
+    __m256 y=_mm256_mul_ps(_mm256_mul_ps(p,pow2_8(e1)),pow2_8(e2));
+    y=_mm256_blendv_ps(y,_mm256_set1_ps(std::numeric_limits<float>::infinity()),_mm256_cmp_ps(x,_mm256_set1_ps(exp_hi),_CMP_GT_OQ));
+    y=_mm256_blendv_ps(y,_mm256_setzero_ps(),_mm256_cmp_ps(x,_mm256_set1_ps(exp_lo),_CMP_LT_OQ));
+    return _mm256_blendv_ps(y,x,_mm256_cmp_ps(x,x,_CMP_UNORD_Q));
+}
+
+VEC_MATH_AVX2 inline __m256 expm1_8(__m256 x,bool fast){
+    __m256 xc=_mm256_min_ps(_mm256_max_ps(x,_mm256_set1_ps(expm1_lo)),_mm256_set1_ps(expm1_big));
+    __m256 n=_mm256_round_ps(_mm256_mul_ps(xc,_mm256_set1_ps(log2e)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+    __m256 r=_mm256_fnmadd_ps(n,_mm256_set1_ps(ln2_hi),xc);
+    r=_mm256_fnmadd_ps(n,_mm256_set1_ps(ln2_lo),r);
+    __m256 s=pow2_8(_mm256_cvtps_epi32(n));
+    __m256 y=_mm256_fmadd_ps(s,expm1_poly8(r,fast),_mm256_sub_ps(s,_mm256_set1_ps(1.0f)));
+    __m256 big=_mm256_cmp_ps(x,_mm256_set1_ps(expm1_big),_CMP_GT_OQ);
+    if(_mm256_movemask_ps(big)) y=_mm256_blendv_ps(y,_mm256_sub_ps(exp8(x,fast),_mm256_set1_ps(1.0f)),big);
+    y=_mm256_blendv_ps(y,_mm256_set1_ps(-1.0f),_mm256_cmp_ps(x,_mm256_set1_ps(expm1_lo),_CMP_LT_OQ));
+    return _mm256_blendv_ps(y,x,_mm256_cmp_ps(x,x,_CMP_UNORD_Q));
+}
+
+VEC_MATH_AVX2 inline __m256 log8(__m256 x){
+    __m256 tiny=_mm256_cmp_ps(x,_mm256_set1_ps(FLT_MIN),_CMP_LT_OQ);
+    __m256 xs=_mm256_blendv_ps(x,_mm256_mul_ps(x,_mm256_set1_ps(8388608.0f)),tiny);
+    __m256i b=_mm256_castps_si256(xs);
+    __m256i e=_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(b,23),_mm256_set1_epi32(0xff)),_mm256_set1_epi32(126));
+    e=_mm256_sub_epi32(e,_mm256_and_si256(_mm256_castps_si256(tiny),_mm256_set1_epi32(23)));
+    __m256 m=_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(b,_mm256_set1_epi32(0x007fffff)),_mm256_set1_epi32(0x3f000000)));
+    __m256 low=_mm256_cmp_ps(m,_mm256_set1_ps(sqrt_half),_CMP_LT_OQ);
+    e=_mm256_add_epi32(e,_mm256_castps_si256(low)); // маска = -1
+    __m256 f=_mm256_sub_ps(_mm256_add_ps(m,_mm256_and_ps(low,m)),_mm256_set1_ps(1.0f));
+    __m256 fe=_mm256_cvtepi32_ps(e);
+    __m256 z=_mm256_mul_ps(f,f);
+    __m256 p=_mm256_set1_ps(7.0376836292E-2f);
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(-1.1514610310E-1f));
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(1.1676998740E-1f));
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(-1.2420140846E-1f));
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(1.4249322787E-1f));
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(-1.6668057665E-1f));
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(2.0000714765E-1f));
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(-2.4999993993E-1f));
+    p=_mm256_fmadd_ps(p,f,_mm256_set1_ps(3.3333331174E-1f));
+    __m256 t=_mm256_mul_ps(_mm256_mul_ps(p,f),z);
+    t=_mm256_fmadd_ps(fe,_mm256_set1_ps(ln2_lo),t);
+    t=_mm256_fnmadd_ps(_mm256_set1_ps(0.5f),z,t);
+    __m256 y=_mm256_fmadd_ps(fe,_mm256_set1_ps(ln2_hi),_mm256_add_ps(f,t));
+    const float inf=std::numeric_limits<float>::infinity();
+    y=_mm256_blendv_ps(y,_mm256_set1_ps(inf),_mm256_cmp_ps(x,_mm256_set1_ps(inf),_CMP_EQ_OQ));
+    y=_mm256_blendv_ps(y,_mm256_set1_ps(-inf),_mm256_cmp_ps(x,_mm256_setzero_ps(),_CMP_EQ_OQ));
+    // x<0 и NaN
+    return _mm256_blendv_ps(y,_mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()),
+                            _mm256_cmp_ps(x,_mm256_setzero_ps(),_CMP_NGE_UQ));
+}
+
+VEC_MATH_AVX2 void exp_array_avx2(const float* x,float* y,size_t n,bool fast){
+    size_t i=0;
+    for(;i+8<=n;i+=8) _mm256_storeu_ps(y+i,exp8(_mm256_loadu_ps(x+i),fast));
+    for(;i<n;++i) y[i]=exp_scalar(x[i],fast);
+}
+
+VEC_MATH_AVX2 void expm1_array_avx2(const float* x,float* y,size_t n,bool fast){
+    size_t i=0;
+    for(;i+8<=n;i+=8) _mm256_storeu_ps(y+i,expm1_8(_mm256_loadu_ps(x+i),fast));
+    for(;i<n;++i) y[i]=expm1_scalar(x[i],fast);
+}
+
+VEC_MATH_AVX2 void log_array_avx2(const float* x,float* y,size_t n,bool){
+    size_t i=0;
+    for(;i+8<=n;i+=8) _mm256_storeu_ps(y+i,log8(_mm256_loadu_ps(x+i)));
+    for(;i<n;++i) y[i]=log_scalar(x[i]);
+}
+
+#endif
+
+using ArrayFn=void(*)(const float*,float*,size_t,bool);
+
+struct Kernels {
+    ArrayFn exp;
+    ArrayFn expm1;
+    ArrayFn log;
+    const char* isa;
+};
+
+const Kernels& kernels(){
+    static const Kernels k=[](){
+        const char* env=std::getenv("CNN_SIMD");
+        bool force_scalar=env&&std::strcmp(env,"scalar")==0;
+#ifdef VEC_MATH_X86
+        __builtin_cpu_init();
+        if(!force_scalar&&__builtin_cpu_supports("avx2")&&__builtin_cpu_supports("fma"))
+            return Kernels{exp_array_avx2,expm1_array_avx2,log_array_avx2,"avx2"};
+#endif
+        (void)force_scalar;
+        return Kernels{exp_array_scalar,expm1_array_scalar,log_array_scalar,"scalar"};
+    }();
+    return k;
+}
+
+} // namespace
+
+namespace vec_math {
+
+void exp(const float* x,float* y,size_t n,MathAccuracy accuracy){
+    kernels().exp(x,y,n,accuracy==MathAccuracy::Fast);
+}
+
+void expm1(const float* x,float* y,size_t n,MathAccuracy accuracy){
+    kernels().expm1(x,y,n,accuracy==MathAccuracy::Fast);
+}
+
+void log(const float* x,float* y,size_t n,MathAccuracy accuracy){
+    kernels().log(x,y,n,accuracy==MathAccuracy::Fast);
+}
+
+const char* isa(){ return kernels().isa; }
+
+} // namespace vec_math